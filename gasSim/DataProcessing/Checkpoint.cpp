@@ -0,0 +1,196 @@
+#include "Checkpoint.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PhysicsEngine/GSVector.hpp"
+
+namespace GS {
+
+static_assert(std::is_trivially_copyable_v<Particle> &&
+              sizeof(Particle) == 6 * sizeof(double));
+static_assert(std::is_trivially_copyable_v<GSVectorD> &&
+              sizeof(GSVectorD) == 3 * sizeof(double));
+
+// file layout: header, particles, last stat collision positions
+struct CheckpointHeader {
+  char magic[8];
+  uint64_t nParticles;
+  uint64_t nCollPositions;  // zero without a last stat
+  uint64_t events;
+  uint64_t flags;
+  double radius;
+  double mass;
+  double boxSide;
+  double time;
+  double statT;
+  double statTime;
+  double statBoxSide;
+  double gTime;
+  double fTime;
+};
+
+constexpr char checkpointMagic[8]{'G', 'S', 'C', 'K', 'P', 'T', '0', '1'};
+constexpr uint64_t hasGTime{1};
+constexpr uint64_t hasFTime{2};
+
+// flushes the file or directory at path to the disk, some file systems not
+// supporting it on directories (EINVAL)
+void syncPath(std::string const& path, int flags) {
+  int fd{open(path.c_str(), flags)};
+  if (fd < 0) {
+    throw std::runtime_error("writeCheckpoint error: couldn't open " + path);
+  }
+  bool const synced{fsync(fd) == 0 || errno == EINVAL};
+  close(fd);
+  if (!synced) {
+    throw std::runtime_error("writeCheckpoint error: couldn't sync " + path);
+  }
+}
+
+void writeCheckpoint(Checkpoint const& c, std::string const& path) {
+  CheckpointHeader header{};
+  std::memcpy(header.magic, checkpointMagic, sizeof(checkpointMagic));
+  header.nParticles = c.particles.size();
+  header.nCollPositions =
+      c.lastStat.has_value() ? c.lastStat->lastCollPositions.size() : 0;
+  header.events = c.events;
+  header.flags = (c.gTime.has_value() ? hasGTime : 0) |
+                 (c.fTime.has_value() ? hasFTime : 0);
+  header.radius = c.radius;
+  header.mass = c.mass;
+  header.boxSide = c.boxSide;
+  header.time = c.time;
+  if (c.lastStat.has_value()) {
+    header.statT = c.lastStat->T;
+    header.statTime = c.lastStat->time;
+    header.statBoxSide = c.lastStat->boxSide;
+  }
+  header.gTime = c.gTime.value_or(0.);
+  header.fTime = c.fTime.value_or(0.);
+
+  std::string tempPath{path + ".tmp"};
+  {
+    std::ofstream file{tempPath, std::ios::binary | std::ios::trunc};
+    if (!file) {
+      throw std::runtime_error("writeCheckpoint error: couldn't open " +
+                               tempPath);
+    }
+    file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    file.write(reinterpret_cast<char const*>(c.particles.data()),
+               static_cast<std::streamsize>(c.particles.size() *
+                                            sizeof(Particle)));
+    if (c.lastStat.has_value()) {
+      file.write(reinterpret_cast<char const*>(
+                     c.lastStat->lastCollPositions.data()),
+                 static_cast<std::streamsize>(header.nCollPositions *
+                                              sizeof(GSVectorD)));
+    }
+    if (!file) {
+      throw std::runtime_error("writeCheckpoint error: couldn't write " +
+                               tempPath);
+    }
+  }
+  // the data has to be on the disk before the rename can replace the old
+  // checkpoint, and the rename itself is only durable once the directory is
+  syncPath(tempPath, O_WRONLY);
+  std::filesystem::rename(tempPath, path);
+  std::filesystem::path dir{std::filesystem::path{path}.parent_path()};
+  syncPath(dir.empty() ? "." : dir.string(), O_RDONLY | O_DIRECTORY);
+}
+
+// unmaps the file when leaving readCheckpoint, exceptions included
+struct MappedFile {
+  void const* data{MAP_FAILED};
+  size_t size{0};
+  ~MappedFile() {
+    if (data != MAP_FAILED) {
+      munmap(const_cast<void*>(data), size);
+    }
+  }
+};
+
+Checkpoint readCheckpoint(std::string const& path) {
+  MappedFile map{};
+  {
+    int fd{open(path.c_str(), O_RDONLY)};
+    if (fd < 0) {
+      throw std::runtime_error("readCheckpoint error: couldn't open " + path);
+    }
+    struct stat info {};
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      map.size = static_cast<size_t>(info.st_size);
+      map.data = mmap(nullptr, map.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // the mapping stays valid after closing the descriptor
+    close(fd);
+  }
+  if (map.data == MAP_FAILED) {
+    throw std::runtime_error("readCheckpoint error: couldn't map " + path);
+  }
+  madvise(const_cast<void*>(map.data), map.size, MADV_SEQUENTIAL);
+
+  char const* bytes{static_cast<char const*>(map.data)};
+  CheckpointHeader header{};
+  if (map.size < sizeof(header)) {
+    throw std::runtime_error("readCheckpoint error: truncated file " + path);
+  }
+  std::memcpy(&header, bytes, sizeof(header));
+  if (std::memcmp(header.magic, checkpointMagic, sizeof(checkpointMagic))) {
+    throw std::runtime_error("readCheckpoint error: " + path +
+                             " is not a checkpoint");
+  }
+  // the counts are checked one at a time so that the sum can't overflow
+  size_t available{(map.size - sizeof(header))};
+  if (header.nParticles > available / sizeof(Particle) ||
+      header.nCollPositions >
+          (available - header.nParticles * sizeof(Particle)) /
+              sizeof(GSVectorD) ||
+      map.size != sizeof(header) + header.nParticles * sizeof(Particle) +
+                      header.nCollPositions * sizeof(GSVectorD)) {
+    throw std::runtime_error(
+        "readCheckpoint error: file size doesn't match the header of " + path);
+  }
+
+  Checkpoint c{};
+  c.radius = header.radius;
+  c.mass = header.mass;
+  c.boxSide = header.boxSide;
+  c.time = header.time;
+  c.events = header.events;
+  c.particles.resize(header.nParticles);
+  std::memcpy(c.particles.data(), bytes + sizeof(header),
+              header.nParticles * sizeof(Particle));
+  if (header.nCollPositions) {
+    TdStats::Memory memory{};
+    memory.lastCollPositions.resize(header.nCollPositions);
+    std::memcpy(memory.lastCollPositions.data(),
+                bytes + sizeof(header) + header.nParticles * sizeof(Particle),
+                header.nCollPositions * sizeof(GSVectorD));
+    memory.T = header.statT;
+    memory.time = header.statTime;
+    memory.boxSide = header.statBoxSide;
+    c.lastStat = std::move(memory);
+  }
+  if (header.flags & hasGTime) {
+    c.gTime = header.gTime;
+  }
+  if (header.flags & hasFTime) {
+    c.fTime = header.fTime;
+  }
+  return c;
+}
+
+}  // namespace GS
@@ -0,0 +1,38 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "DataProcessing/TdStats.hpp"
+#include "PhysicsEngine/Particle.hpp"
+
+namespace GS {
+
+// everything needed to continue a run: the gas at the end of the last
+// processed stat and the pipeline state at that point
+struct Checkpoint {
+  double radius{0.};
+  double mass{0.};
+  double boxSide{0.};
+  double time{0.};
+  size_t events{0};  // collisions simulated since the start of the run
+  std::vector<Particle> particles{};
+
+  std::optional<TdStats::Memory> lastStat{};
+  std::optional<double> gTime{};  // time of the last render
+  std::optional<double> fTime{};  // time of the last published frame
+};
+
+// compact binary format in native byte order, written to a temporary file
+// first and synced to the disk before replacing the old checkpoint, so that
+// neither a crash nor a power loss leave a truncated one
+void writeCheckpoint(Checkpoint const& checkpoint, std::string const& path);
+// maps the file in memory instead of streaming it
+Checkpoint readCheckpoint(std::string const& path);
+
+}  // namespace GS
+
+#endif
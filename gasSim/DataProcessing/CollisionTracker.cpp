@@ -0,0 +1,39 @@
+#include "CollisionTracker.hpp"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "DataProcessing/GasState.hpp"
+#include "PhysicsEngine/Particle.hpp"
+
+namespace GS {
+
+CollisionTracker::CollisionTracker(GasState const& state) { reset(state); }
+
+CollisionTracker::CollisionTracker(std::vector<GSVectorD> positions)
+    : lastCollPositions{std::move(positions)} {}
+
+void CollisionTracker::reset(GasState const& state) {
+  lastCollPositions.assign(state.getNParticles(), {0., 0., 0.});
+  setSpeeds(state);
+}
+
+void CollisionTracker::setSpeeds(GasState const& state) {
+  speeds.clear();
+  speeds.reserve(state.getNParticles());
+  for (Particle const& p : state.getParticles()) {
+    speeds.emplace_back(p.speed.norm());
+  }
+}
+
+double CollisionTracker::addCollision(size_t index,
+                                      GSVectorD const& position) {
+  GSVectorD& last{lastCollPositions[index]};
+  double freePath{last != GSVectorD{0., 0., 0.} ? (position - last).norm()
+                                                : -1.};
+  last = position;
+  return freePath;
+}
+
+}  // namespace GS
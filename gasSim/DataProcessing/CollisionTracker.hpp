@@ -0,0 +1,58 @@
+#ifndef COLLISIONTRACKER_HPP
+#define COLLISIONTRACKER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "PhysicsEngine/GSVector.hpp"
+
+namespace GS {
+
+class GasState;
+
+// per particle memory shared by a chain of TdStats: where each particle last
+// collided, {0., 0., 0.} if it didn't yet, and its current speed
+// not thread-safe
+class CollisionTracker {
+ public:
+  // empty until reset
+  CollisionTracker() = default;
+  // no collisions, speeds taken from the state
+  explicit CollisionTracker(GasState const& state);
+  // collision positions of a previous run, speeds still to be set
+  explicit CollisionTracker(std::vector<GSVectorD> lastCollPositions);
+
+  // forgets the collisions, speeds taken from the state
+  void reset(GasState const& state);
+  void setSpeeds(GasState const& state);
+  bool hasSpeeds() const { return speeds.size() == lastCollPositions.size(); }
+
+  // returns the free path since the particle last collision, negative if it
+  // is its first one
+  double addCollision(size_t index, GSVectorD const& position);
+  double getSpeed(size_t index) const { return speeds[index]; }
+  std::vector<double> const& getSpeeds() const { return speeds; }
+  void setSpeed(size_t index, double speed) { speeds[index] = speed; }
+
+  size_t getNParticles() const { return lastCollPositions.size(); }
+  size_t memoryUsage() const {
+    return sizeof(*this) + lastCollPositions.capacity() * sizeof(GSVectorD) +
+           speeds.capacity() * sizeof(double);
+  }
+  // of a tracker of particlesN particles with their speeds
+  static size_t memoryUsage(size_t particlesN) {
+    return sizeof(CollisionTracker) +
+           particlesN * (sizeof(GSVectorD) + sizeof(double));
+  }
+  std::vector<GSVectorD> const& getLastCollPositions() const {
+    return lastCollPositions;
+  }
+
+ private:
+  std::vector<GSVectorD> lastCollPositions{};
+  std::vector<double> speeds{};
+};
+
+}  // namespace GS
+
+#endif
@@ -0,0 +1,112 @@
+#include "EventRing.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "DataProcessing/GasData.hpp"
+
+namespace GS {
+
+EventRing::EventRing(size_t capacityV) {
+  if (!capacityV) {
+    throw std::invalid_argument(
+        "EventRing constructor error: provided null capacity");
+  }
+  size_t c{1};
+  while (c < capacityV) {
+    c <<= 1;
+  }
+  slots.resize(c);
+  mask = c - 1;
+}
+
+// head is read first, so that it can't pass the tail read after it
+size_t EventRing::size() const {
+  size_t h{head.load()};
+  size_t t{tail.load()};
+  return t - h < slots.size() ? t - h : slots.size();
+}
+
+// the index stores and the waiting flag loads of the two sides are
+// sequentially consistent, so a side either sees the index the other one just
+// published or the flag it set before sleeping
+size_t EventRing::push(std::vector<GasData>& data, size_t first) {
+  size_t t{tail.load(std::memory_order_relaxed)};
+  size_t n{data.size() - first};
+  if (t - headCache + n > slots.size()) {
+    headCache = head.load(std::memory_order_acquire);
+  }
+  size_t free{slots.size() - (t - headCache)};
+  n = n < free ? n : free;
+  for (size_t i{0}; i < n; ++i) {
+    slots[(t + i) & mask] = std::move(data[first + i]);
+  }
+  if (n) {
+    tail.store(t + n);
+    if (consumerWaiting.load()) {
+      std::lock_guard<std::mutex> waitGuard{waitMtx};
+      dataCv.notify_one();
+    }
+  }
+  return n;
+}
+
+size_t EventRing::pop(std::vector<GasData>& out, size_t n) {
+  size_t h{head.load(std::memory_order_relaxed)};
+  if (tailCache - h < n) {
+    tailCache = tail.load(std::memory_order_acquire);
+  }
+  n = tailCache - h < n ? tailCache - h : n;
+  for (size_t i{0}; i < n; ++i) {
+    // the moved-from record lets go of its keyframe particles
+    out.emplace_back(std::move(*slots[(h + i) & mask]));
+  }
+  if (n) {
+    head.store(h + n);
+    if (producerWaiting.load()) {
+      std::lock_guard<std::mutex> waitGuard{waitMtx};
+      spaceCv.notify_one();
+    }
+  }
+  return n;
+}
+
+void EventRing::waitForSpace(size_t n, std::chrono::milliseconds timeout,
+                             std::function<bool()> const& stop) {
+  if (slots.size() - size() >= n) {
+    return;
+  }
+  std::unique_lock<std::mutex> waitLock{waitMtx};
+  producerWaiting.store(true);
+  if (slots.size() - size() < n && !stop()) {
+    spaceCv.wait_for(waitLock, timeout);
+  }
+  producerWaiting.store(false);
+}
+
+void EventRing::waitForData(size_t n, std::chrono::milliseconds timeout,
+                            std::function<bool()> const& stop) {
+  if (size() >= n) {
+    return;
+  }
+  std::unique_lock<std::mutex> waitLock{waitMtx};
+  consumerWaiting.store(true);
+  if (size() < n && !stop()) {
+    dataCv.wait_for(waitLock, timeout);
+  }
+  consumerWaiting.store(false);
+}
+
+void EventRing::wake() {
+  std::lock_guard<std::mutex> waitGuard{waitMtx};
+  dataCv.notify_all();
+  spaceCv.notify_all();
+}
+
+}  // namespace GS
@@ -0,0 +1,76 @@
+#ifndef EVENTRING_HPP
+#define EVENTRING_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "DataProcessing/GasData.hpp"
+
+namespace GS {
+
+// bounded queue of records from one producer thread to one consumer thread
+// the slots are allocated once and reused, pushing and popping only move the
+// records and publish an index, the mutex is taken just to wake a side that
+// went to sleep
+class EventRing {
+ public:
+  // rounded up to a power of two
+  explicit EventRing(size_t capacity);
+
+  EventRing(EventRing const&) = delete;
+  EventRing& operator=(EventRing const&) = delete;
+
+  size_t capacity() const { return slots.size(); }
+  size_t size() const;
+  // bytes of the slots, the particles of queued keyframes excluded
+  size_t memoryUsage() const {
+    return slots.capacity() * sizeof(std::optional<GasData>);
+  }
+
+  // producer side
+  // moves the records of data from first on, as many as fit, returns how many
+  size_t push(std::vector<GasData>& data, size_t first = 0);
+  // returns once n slots are free, when woken with stop true or after timeout
+  void waitForSpace(
+      size_t n, std::chrono::milliseconds timeout,
+      std::function<bool()> const& stop = [] { return false; });
+
+  // consumer side
+  // appends up to n records to out, returns how many
+  size_t pop(std::vector<GasData>& out, size_t n);
+  // returns once n records are queued, when woken with stop true or after
+  // timeout
+  void waitForData(
+      size_t n, std::chrono::milliseconds timeout,
+      std::function<bool()> const& stop = [] { return false; });
+
+  // wakes both sides, to be called after changing what their stop checks
+  void wake();
+
+ private:
+  static constexpr size_t cacheLine{64};
+
+  std::vector<std::optional<GasData>> slots;
+  size_t mask;
+  // each index is written by one side only, and kept on its own cache line
+  // along with the last value of the other index its side read
+  alignas(cacheLine) std::atomic<size_t> head{0};  // next record to pop
+  size_t tailCache{0};
+  alignas(cacheLine) std::atomic<size_t> tail{0};  // next slot to fill
+  size_t headCache{0};
+  alignas(cacheLine) std::atomic<bool> consumerWaiting{false};
+  std::atomic<bool> producerWaiting{false};
+  std::mutex waitMtx;
+  std::condition_variable dataCv;
+  std::condition_variable spaceCv;
+};
+
+}  // namespace GS
+
+#endif
@@ -0,0 +1,115 @@
+#include "FixedHistogram.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include <TAxis.h>
+
+namespace GS {
+
+FixedHistogram::FixedHistogram(TH1D const& binning)
+    : nBins{binning.GetNbinsX()},
+      xMin{binning.GetXaxis()->GetXmin()},
+      xMax{binning.GetXaxis()->GetXmax()},
+      bins(static_cast<size_t>(nBins + 2)) {
+  if (binning.GetXaxis()->IsVariableBinSize()) {
+    throw std::invalid_argument(
+        "FixedHistogram constructor error: provided variable width binning");
+  }
+}
+
+// same as TAxis::FindFixBin
+size_t FixedHistogram::findBin(double x) const {
+  if (x < xMin) {
+    return 0;
+  } else if (!(x < xMax)) {
+    return static_cast<size_t>(nBins + 1);
+  } else {
+    return 1 + static_cast<size_t>(nBins * (x - xMin) / (xMax - xMin));
+  }
+}
+
+void FixedHistogram::setValues(std::vector<double> const& values) {
+  bins.assign(bins.size(), {});
+  for (double v : values) {
+    Bin& bin{bins[findBin(v)]};
+    ++bin.count;
+    bin.sum += v;
+    bin.sum2 += v * v;
+  }
+  nValues = values.size();
+  nFills = 0;
+  mergedEntries = 0.;
+}
+
+void FixedHistogram::catchUp(Bin& bin) {
+  double n{static_cast<double>(nFills - bin.since)};
+  bin.accCount += bin.count * n;
+  bin.accSum += bin.sum * n;
+  bin.accSum2 += bin.sum2 * n;
+  bin.since = nFills;
+}
+
+void FixedHistogram::moveValue(double from, double to) {
+  Bin& fromBin{bins[findBin(from)]};
+  catchUp(fromBin);
+  --fromBin.count;
+  fromBin.sum -= from;
+  fromBin.sum2 -= from * from;
+  Bin& toBin{bins[findBin(to)]};
+  catchUp(toBin);
+  ++toBin.count;
+  toBin.sum += to;
+  toBin.sum2 += to * to;
+}
+
+void FixedHistogram::clearFills() {
+  for (Bin& bin : bins) {
+    bin.accCount = bin.accSum = bin.accSum2 = 0.;
+    bin.since = 0;
+  }
+  nFills = 0;
+  mergedEntries = 0.;
+}
+
+void FixedHistogram::merge(FixedHistogram const& h) {
+  if (!sameBinning(h)) {
+    throw std::invalid_argument(
+        "FixedHistogram merge error: provided histogram with different "
+        "binning");
+  }
+  for (size_t i{0}; i < bins.size(); ++i) {
+    Bin const& other{h.bins[i]};
+    double n{static_cast<double>(h.nFills - other.since)};
+    bins[i].accCount += other.accCount + other.count * n;
+    bins[i].accSum += other.accSum + other.sum * n;
+    bins[i].accSum2 += other.accSum2 + other.sum2 * n;
+  }
+  mergedEntries += h.mergedEntries + static_cast<double>(h.nFills * h.nValues);
+}
+
+void FixedHistogram::writeTo(TH1D& h) const {
+  std::array<double, 4> hStats{};
+  for (size_t i{0}; i < bins.size(); ++i) {
+    Bin const& bin{bins[i]};
+    double n{static_cast<double>(nFills - bin.since)};
+    double count{bin.accCount + bin.count * n};
+    h.SetBinContent(static_cast<int>(i), count);
+    if (h.GetSumw2N()) {
+      h.SetBinError(static_cast<int>(i), std::sqrt(count));
+    }
+    if (i && i + 1 < bins.size()) {
+      hStats[0] += count;
+      hStats[1] += count;
+      hStats[2] += bin.accSum + bin.sum * n;
+      hStats[3] += bin.accSum2 + bin.sum2 * n;
+    }
+  }
+  h.SetEntries(mergedEntries + static_cast<double>(nFills * nValues));
+  h.PutStats(hStats.data());
+}
+
+}  // namespace GS
@@ -0,0 +1,67 @@
+#ifndef FIXEDHISTOGRAM_HPP
+#define FIXEDHISTOGRAM_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <TH1.h>
+
+namespace GS {
+
+// fixed width histogram of a set of values, every value being filled once at
+// each fill: only the bins a value moves between are brought up to date, the
+// others catch up on the fills they missed when read or changed
+// binning and bin lookup are the ones of a fixed width TH1D
+class FixedHistogram {
+ public:
+  FixedHistogram() = default;
+  // throws for variable width binnings
+  explicit FixedHistogram(TH1D const& binning);
+
+  bool sameBinning(FixedHistogram const& h) const {
+    return nBins == h.nBins && xMin == h.xMin && xMax == h.xMax;
+  }
+  size_t findBin(double x) const;
+
+  // the values filled at each fill, clearing the fills
+  void setValues(std::vector<double> const& values);
+  void moveValue(double from, double to);
+  void fill() { ++nFills; }
+  // keeps the values
+  void clearFills();
+  // adds the fills of another histogram with the same binning, the values
+  // stay the ones of this one
+  void merge(FixedHistogram const& h);
+
+  // writes contents, entries and stats into h, which must have the same
+  // binning, over and underflows are left out of the stats as TH1D::Fill does
+  void writeTo(TH1D& h) const;
+
+  size_t memoryUsage() const {
+    return sizeof(*this) + bins.size() * sizeof(Bin);
+  }
+
+ private:
+  struct Bin {
+    double count{0.};
+    double sum{0.};
+    double sum2{0.};
+    double accCount{0.};
+    double accSum{0.};
+    double accSum2{0.};
+    size_t since{0};  // fills already accumulated
+  };
+  void catchUp(Bin& bin);
+
+  int nBins{1};
+  double xMin{0.};
+  double xMax{1.};
+  std::vector<Bin> bins{};  // under and overflow included
+  size_t nValues{0};
+  size_t nFills{0};
+  double mergedEntries{0.};
+};
+
+}  // namespace GS
+
+#endif
@@ -2,65 +2,102 @@
 
 #include <cassert>
 #include <cstdint>
+#include <memory>
 #include <stdexcept>
+#include <type_traits>
+#include <vector>
 
 #include "PhysicsEngine/Gas.hpp"
 
 // auxiliary getPIndex function
-inline long getPIndex(GS::Particle const* p, GS::Gas const& gas) {
+template <typename FP>
+inline long getPIndex(GS::BasicParticle<FP> const* p,
+                      GS::BasicGas<FP> const& gas) {
   return static_cast<long>(p - gas.getParticles().data());
 }
 
-GS::GasData::GasData(Gas const& gas, Collision const* collision) {
+template <typename FP>
+std::vector<GS::Particle> toDouble(
+    std::vector<GS::BasicParticle<FP>> const& particles) {
+  if constexpr (std::is_same_v<FP, double>) {
+    return particles;
+  } else {
+    std::vector<GS::Particle> result{};
+    result.reserve(particles.size());
+    for (GS::BasicParticle<FP> const& p : particles) {
+      result.push_back({GS::GSVectorD{p.position}, GS::GSVectorD{p.speed}});
+    }
+    return result;
+  }
+}
+
+template <typename FP>
+GS::Particle toDouble(GS::BasicParticle<FP> const& p) {
+  return {GS::GSVectorD{p.position}, GS::GSVectorD{p.speed}};
+}
+
+template <typename FP>
+inline bool belongsTo(GS::BasicParticle<FP> const* p,
+                      GS::BasicGas<FP> const& gas) {
+  return gas.getParticles().data() <= p &&
+         p < gas.getParticles().data() + gas.getParticles().size();
+}
+
+template <typename FP>
+GS::GasData::GasData(BasicGas<FP> const& gas,
+                     BasicCollision<FP> const* collision, bool keyframe) {
   if (!collision->getP1()) {
     throw std::invalid_argument(
         "GasData constructor error: provided nullptr as first particle "
         "pointer.");
   }
-  if (!(gas.getParticles().data() <= collision->getP1() &&
-        collision->getP1() <=
-            gas.getParticles().data() + gas.getParticles().size()))
+  if (!belongsTo(collision->getP1(), gas)) {
     throw std::invalid_argument(
         "GasData constructor error: collision first particle does not belong "
         "to gas.");
-  else {
-    if (collision->getType() == 'p') {
-      PPCollision const* coll{static_cast<PPCollision const*>(collision)};
-      if (!coll->getP2()) {
-        throw std::invalid_argument(
-            "GasData constructor error: provided nullptr as second particle "
-            "pointer.");
-      }
-      if (!(gas.getParticles().data() <= coll->getP2() &&
-            coll->getP2() <=
-                gas.getParticles().data() + gas.getParticles().size())) {
-        throw std::invalid_argument(
-            "GasData constructor error: collision second particle does not "
-            "belong to gas.");
-      } else {
-        particles = gas.getParticles();
-        t0 = gas.getTime() - collision->getTime();
-        time = gas.getTime();
-        boxSide = gas.getBoxSide();
-        p1Index = static_cast<size_t>(getPIndex(coll->getP1(), gas));
-        p2Index = static_cast<size_t>(getPIndex(coll->getP2(), gas));
-        wall = Wall::VOID;
-      }
-    } else {
-      particles = gas.getParticles();
-      t0 = gas.getTime() - collision->getTime();
-      time = gas.getTime();
-      boxSide = gas.getBoxSide();
-      p1Index = static_cast<size_t>(getPIndex(collision->getP1(), gas));
-      p2Index = SIZE_MAX;
-      PWCollision const* coll{static_cast<PWCollision const*>(collision)};
-      wall = coll->getWall();
+  }
+  if (collision->getType() == 'p') {
+    BasicPPCollision<FP> const* coll{
+        static_cast<BasicPPCollision<FP> const*>(collision)};
+    if (!coll->getP2()) {
+      throw std::invalid_argument(
+          "GasData constructor error: provided nullptr as second particle "
+          "pointer.");
+    }
+    if (!belongsTo(coll->getP2(), gas)) {
+      throw std::invalid_argument(
+          "GasData constructor error: collision second particle does not "
+          "belong to gas.");
     }
+    p2 = toDouble(*coll->getP2());
+    p2Index = static_cast<size_t>(getPIndex(coll->getP2(), gas));
+    wall = Wall::VOID;
+  } else {
+    p2Index = SIZE_MAX;
+    wall = static_cast<BasicPWCollision<FP> const*>(collision)->getWall();
   }
+  if (keyframe) {
+    particles = std::make_shared<std::vector<Particle> const>(
+        toDouble(gas.getParticles()));
+  }
+  p1 = toDouble(*collision->getP1());
+  p1Index = static_cast<size_t>(getPIndex(collision->getP1(), gas));
+  nParticles = gas.getParticles().size();
+  t0 = gas.getTime() - collision->getTime();
+  time = gas.getTime();
+  boxSide = gas.getBoxSide();
+  radius = gas.getRadius();
+  mass = gas.getMass();
 }
 
+template GS::GasData::GasData(GasF const& gas,
+                              BasicCollision<float> const* collision,
+                              bool keyframe);
+template GS::GasData::GasData(Gas const& gas, Collision const* collision,
+                              bool keyframe);
+
 char GS::GasData::getCollType() const {
-  assert(p1Index <= static_cast<size_t>(particles.size()));
+  assert(p1Index < nParticles);
   if (wall == Wall::VOID) {
     return 'p';
   } else {
@@ -68,12 +105,21 @@ char GS::GasData::getCollType() const {
   }
 }
 
+std::vector<GS::Particle> const& GS::GasData::getParticles() const {
+  if (!particles) {
+    throw std::logic_error(
+        "GasData::getParticles error: asked for the particles of a record "
+        "that is not a keyframe");
+  }
+  return *particles;
+}
+
 GS::Particle const& GS::GasData::getP2() const {
   if (getCollType() == 'w')
     throw std::logic_error(
         "GasData::getP2 error: asked for p2 in wall collision");
   else
-    return particles[p2Index];
+    return p2;
 }
 
 size_t GS::GasData::getP2Index() const {
@@ -93,7 +139,11 @@ GS::Wall GS::GasData::getWall() const {
 }
 
 bool GS::GasData::operator==(GasData const& data) const {
-  return particles == data.particles && t0 == data.t0 && time == data.time &&
-         boxSide == data.boxSide && p1Index == data.p1Index &&
+  bool sameParticles{isKeyframe() == data.isKeyframe() &&
+                     (!isKeyframe() || *particles == *data.particles)};
+  return sameParticles && nParticles == data.nParticles && p1 == data.p1 &&
+         p2 == data.p2 && t0 == data.t0 && time == data.time &&
+         boxSide == data.boxSide && radius == data.radius &&
+         mass == data.mass && p1Index == data.p1Index &&
          p2Index == data.p2Index && wall == data.wall;
 }
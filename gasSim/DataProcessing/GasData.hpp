@@ -2,6 +2,7 @@
 #define GASDATA_HPP
 
 #include <cstddef>
+#include <memory>
 #include <vector>
 
 #include "PhysicsEngine/Collision.hpp"
@@ -9,32 +10,51 @@
 
 namespace GS {
 
-class Gas;
+template <typename FP>
+class BasicGas;
 
+// record of a solved collision, always stored in double precision
+// keyframes also hold every particle, shared between copies, while the other
+// records only hold the post-collision states of the colliding particles: a
+// GasState rebuilds the whole gas from a keyframe and the following records
 class GasData {
  public:
-  // expects a solved collision
-  GasData(Gas const& gas, Collision const* collision);
+  // expects a solved collision whose particles are at the gas time, and, for
+  // keyframes, every particle at the gas time
+  template <typename FP>
+  GasData(BasicGas<FP> const& gas, BasicCollision<FP> const* collision,
+          bool keyframe = true);
 
   char getCollType() const;
+  bool isKeyframe() const { return particles != nullptr; }
 
-  std::vector<Particle> const& getParticles() const { return particles; }
-  Particle const& getP1() const { return particles[p1Index]; }
+  // keyframes only
+  std::vector<Particle> const& getParticles() const;
+  size_t getNParticles() const { return nParticles; }
+  Particle const& getP1() const { return p1; }
   size_t getP1Index() const { return p1Index; }
   Particle const& getP2() const;
   size_t getP2Index() const;
   double getT0() const { return t0; }
   double getTime() const { return time; }
   double getBoxSide() const { return boxSide; }
+  // the gas ones, frozen at its construction
+  double getRadius() const { return radius; }
+  double getMass() const { return mass; }
   Wall getWall() const;
 
   bool operator==(GasData const& data) const;
 
  private:
-  std::vector<Particle> particles;
+  std::shared_ptr<std::vector<Particle> const> particles{};
+  Particle p1{};
+  Particle p2{};
+  size_t nParticles;
   double t0;
   double time;
   double boxSide;
+  double radius;
+  double mass;
   size_t p1Index;
   size_t p2Index;
   Wall wall{Wall::VOID};
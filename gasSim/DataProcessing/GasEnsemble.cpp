@@ -0,0 +1,123 @@
+#include "GasEnsemble.hpp"
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <TROOT.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include "DataProcessing/GasData.hpp"
+#include "DataProcessing/GasState.hpp"
+#include "PhysicsEngine/Particle.hpp"
+#include "PhysicsEngine/WorkerPool.hpp"
+
+namespace GS {
+
+GasEnsemble::GasEnsemble(size_t nReplicas, size_t particlesN,
+                         double temperature, double boxSide, unsigned seed)
+    : replicas(nReplicas),
+      lastStats(nReplicas),
+      radius{Particle::getRadius()},
+      mass{Particle::getMass()} {
+  if (!nReplicas) {
+    throw std::invalid_argument(
+        "GasEnsemble constructor error: provided zero replicas");
+  }
+  // replicas already run in parallel, their brute force searches must not
+  // spawn more threads
+  auto serialPool{std::make_shared<WorkerPool>(1)};
+  tbb::parallel_for(size_t{0}, nReplicas, [&](size_t i) {
+    std::seed_seq seq{seed, static_cast<unsigned>(i)};
+    std::array<unsigned, 1> replicaSeed{};
+    seq.generate(replicaSeed.begin(), replicaSeed.end());
+    replicas[i] = Gas{particlesN, temperature, boxSide, 0., replicaSeed[0]};
+    replicas[i].setWorkerPool(serialPool);
+  });
+}
+
+// welford accumulation, in replica order so that results don't depend on
+// scheduling
+void accumulate(EnsembleValue& v, double x) {
+  ++v.n;
+  double delta{x - v.mean};
+  v.mean += delta / static_cast<double>(v.n);
+  v.variance += delta * (x - v.mean);
+}
+
+void finalize(EnsembleValue& v) {
+  v.variance = v.n > 1 ? v.variance / static_cast<double>(v.n - 1) : 0.;
+}
+
+std::vector<EnsembleStats> GasEnsemble::run(
+    size_t nStats, size_t statSize, TH1D const& speedsHTemplate,
+    bool mfpMemory, std::function<void(size_t, TdStats const&)> onStat) {
+  if (Particle::getRadius() != radius || Particle::getMass() != mass) {
+    throw std::runtime_error(
+        "GasEnsemble run error: particle radius or mass changed since the "
+        "replicas were built");
+  }
+  if (!statSize) {
+    throw std::invalid_argument(
+        "GasEnsemble run error: provided zero statSize");
+  }
+  // histograms are copied from several threads
+  ROOT::EnableThreadSafety();
+
+  // {time, pressure, temperature, mean free path} of each replica stat
+  std::vector<std::vector<std::array<double, 4>>> results(
+      replicas.size(), std::vector<std::array<double, 4>>(nStats));
+
+  tbb::parallel_for(
+      tbb::blocked_range<size_t>(0, replicas.size(), 1),
+      [&](tbb::blocked_range<size_t> const& range) {
+        for (size_t r{range.begin()}; r < range.end(); ++r) {
+          for (size_t s{0}; s < nStats; ++s) {
+            std::vector<GasData> data{replicas[r].rawDataSimulate(statSize)};
+            GasState state{data[0]};
+            TdStats stat{mfpMemory && lastStats[r].has_value()
+                             ? TdStats{state, std::move(*lastStats[r])}
+                             : TdStats{state, speedsHTemplate}};
+            for (size_t j{1}; j < statSize; ++j) {
+              state.apply(data[j]);
+              stat.addData(state);
+            }
+            results[r][s] = {stat.getTime(), stat.getPressure(),
+                             stat.getTemp(), stat.getMeanFreePath()};
+            if (onStat) {
+              onStat(r, stat);
+            }
+            lastStats[r] = std::move(stat);
+          }
+        }
+      });
+
+  std::vector<EnsembleStats> ensembleStats(nStats);
+  for (size_t s{0}; s < nStats; ++s) {
+    EnsembleStats& e{ensembleStats[s]};
+    for (size_t r{0}; r < replicas.size(); ++r) {
+      accumulate(e.time, results[r][s][0]);
+      accumulate(e.pressure, results[r][s][1]);
+      accumulate(e.temperature, results[r][s][2]);
+      // -1 marks a stat with no free paths
+      if (results[r][s][3] >= 0.) {
+        accumulate(e.meanFreePath, results[r][s][3]);
+      }
+    }
+    for (EnsembleValue* v :
+         {&e.time, &e.pressure, &e.temperature, &e.meanFreePath}) {
+      finalize(*v);
+    }
+  }
+  return ensembleStats;
+}
+
+}  // namespace GS
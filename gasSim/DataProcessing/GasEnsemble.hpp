@@ -0,0 +1,61 @@
+#ifndef GASENSEMBLE_HPP
+#define GASENSEMBLE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include <TH1.h>
+
+#include "DataProcessing/TdStats.hpp"
+#include "PhysicsEngine/Gas.hpp"
+
+namespace GS {
+
+// mean and unbiased variance of an observable over the replicas
+struct EnsembleValue {
+  double mean{0.};
+  double variance{0.};
+  size_t n{0};  // number of replicas that contributed
+};
+
+// ensemble average of the stats with the same index in every replica
+struct EnsembleStats {
+  EnsembleValue time{};
+  EnsembleValue pressure{};
+  EnsembleValue temperature{};
+  EnsembleValue meanFreePath{};  // replicas with no free paths are skipped
+};
+
+// independent realisations of the same gas parameters, simulated in parallel
+// particle radius and mass are process-wide, so all the replicas share them:
+// radius changes are refused while gases exist, mass changes make run throw
+class GasEnsemble {
+ public:
+  // replica i is built with a seed derived from seed and i
+  GasEnsemble(size_t nReplicas, size_t particlesN, double temperature,
+              double boxSide, unsigned seed);
+
+  size_t getNReplicas() const { return replicas.size(); }
+  Gas const& getReplica(size_t i) const { return replicas.at(i); }
+
+  // simulates nStats * statSize collisions on each replica, returns the
+  // ensemble average of each stat
+  // onStat gets each replica stat as soon as it is completed, it may be
+  // called concurrently from different threads
+  std::vector<EnsembleStats> run(
+      size_t nStats, size_t statSize, TH1D const& speedsHTemplate,
+      bool mfpMemory = true,
+      std::function<void(size_t, TdStats const&)> onStat = {});
+
+ private:
+  std::vector<Gas> replicas{};
+  std::vector<std::optional<TdStats>> lastStats{};  // for mfp memory
+  double radius;
+  double mass;
+};
+
+}  // namespace GS
+
+#endif
@@ -0,0 +1,73 @@
+#include "GasState.hpp"
+
+#include <cstddef>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "DataProcessing/GasData.hpp"
+#include "PhysicsEngine/Particle.hpp"
+
+namespace GS {
+
+double squaredSpeedsSum(std::vector<Particle> const& particles) {
+  return std::accumulate(particles.begin(), particles.end(), 0.,
+                         [](double x, Particle const& p) {
+                           return x + p.speed * p.speed;
+                         });
+}
+
+GasState::GasState(GasData const& keyframe)
+    : data{keyframe},
+      particles{keyframe.getParticles()},
+      localTimes(keyframe.getNParticles(), keyframe.getTime()),
+      speed2Sum{squaredSpeedsSum(particles)} {}
+
+void GasState::apply(GasData const& newData) {
+  if (newData.getNParticles() != particles.size()) {
+    throw std::invalid_argument(
+        "GasState apply error: provided data with non-matching particle "
+        "number");
+  }
+  if (newData.getTime() < data.getTime()) {
+    throw std::invalid_argument(
+        "GasState apply error: provided data older than the current state");
+  }
+  if (newData.isKeyframe()) {
+    particles = newData.getParticles();
+    localTimes.assign(particles.size(), newData.getTime());
+    speed2Sum = squaredSpeedsSum(particles);
+  } else {
+    Particle& p1{particles[newData.getP1Index()]};
+    speed2Sum += newData.getP1().speed * newData.getP1().speed -
+                 p1.speed * p1.speed;
+    p1 = newData.getP1();
+    localTimes[newData.getP1Index()] = newData.getTime();
+    if (newData.getCollType() == 'p') {
+      Particle& p2{particles[newData.getP2Index()]};
+      speed2Sum += newData.getP2().speed * newData.getP2().speed -
+                   p2.speed * p2.speed;
+      p2 = newData.getP2();
+      localTimes[newData.getP2Index()] = newData.getTime();
+    }
+  }
+  data = newData;
+  synced = false;
+}
+
+// positions are always extrapolated from the stored states, so the result
+// doesn't depend on how often the particles are asked for
+std::vector<Particle> const& GasState::getParticles() const {
+  if (!synced) {
+    current.resize(particles.size());
+    for (size_t i{0}; i < particles.size(); ++i) {
+      current[i] = {particles[i].position +
+                        particles[i].speed * (data.getTime() - localTimes[i]),
+                    particles[i].speed};
+    }
+    synced = true;
+  }
+  return current;
+}
+
+}  // namespace GS
@@ -0,0 +1,57 @@
+#ifndef GASSTATE_HPP
+#define GASSTATE_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "DataProcessing/GasData.hpp"
+#include "PhysicsEngine/Collision.hpp"
+#include "PhysicsEngine/Particle.hpp"
+
+namespace GS {
+
+// whole gas rebuilt from a keyframe and the records following it
+// applying a record only stores the particles it changed, every particle is
+// brought to the record time when all of them are asked for
+// not thread-safe, not even for const access until getParticles was called
+// after the last apply
+class GasState {
+ public:
+  explicit GasState(GasData const& keyframe);
+
+  // data must follow the last applied record, keyframes reset the state
+  void apply(GasData const& data);
+
+  std::vector<Particle> const& getParticles() const;
+  size_t getNParticles() const { return particles.size(); }
+  // kept up to date from the speeds each record changes, recomputed on
+  // keyframes
+  double getEnergy(double mass) const { return mass * speed2Sum / 2.; }
+  // last applied record
+  GasData const& getData() const { return data; }
+
+  // same as the last applied record ones
+  char getCollType() const { return data.getCollType(); }
+  Particle const& getP1() const { return data.getP1(); }
+  size_t getP1Index() const { return data.getP1Index(); }
+  Particle const& getP2() const { return data.getP2(); }
+  size_t getP2Index() const { return data.getP2Index(); }
+  double getT0() const { return data.getT0(); }
+  double getTime() const { return data.getTime(); }
+  double getBoxSide() const { return data.getBoxSide(); }
+  double getRadius() const { return data.getRadius(); }
+  double getMass() const { return data.getMass(); }
+  Wall getWall() const { return data.getWall(); }
+
+ private:
+  GasData data;
+  std::vector<Particle> particles;  // each at its local time
+  std::vector<double> localTimes;
+  double speed2Sum;
+  mutable std::vector<Particle> current{};  // every particle at data time
+  mutable bool synced{false};
+};
+
+}  // namespace GS
+
+#endif
@@ -124,7 +124,7 @@ std::vector<sf::Texture> GS::SimDataPipeline::getVideo(
     throw std::runtime_error("getVideo error: called without setting font");
   }
 
-  std::deque<std::pair<sf::Texture, double>> rendersL{};
+  std::deque<std::pair<Render, double>> rendersL{};
   std::vector<TdStats> statsL{};
   std::optional<double> gTimeL;
   double gDeltaTL;
@@ -310,6 +310,8 @@ std::vector<sf::Texture> GS::SimDataPipeline::getVideo(
       throw std::invalid_argument("Invalid video option provided.");
   }
 
+  outputSpaceCv.notify_all();
+
   // recurrent variables setup
   // text
   std::ostringstream Temp{};
@@ -422,7 +424,7 @@ std::vector<sf::Texture> GS::SimDataPipeline::getVideo(
                     static_cast<float>(rendersL[rIndex].first.getSize().x),
                 static_cast<float>(windowSize.y) /
                     static_cast<float>(rendersL[rIndex].first.getSize().y));
-            box.setTexture(rendersL[rIndex++].first);
+            box.setTexture(rendersL[rIndex++].first.getTexture());
             frame.draw(box);
             frame.draw(timeText);
             frame.display();
@@ -659,7 +661,7 @@ std::vector<sf::Texture> GS::SimDataPipeline::getVideo(
                         static_cast<float>(rendersL[rIndex].first.getSize().x),
                     static_cast<float>(gasSize.y) /
                         static_cast<float>(rendersL[rIndex].first.getSize().y));
-                box.setTexture(rendersL[rIndex++].first);
+                box.setTexture(rendersL[rIndex++].first.getTexture());
                 frame.draw(box);
                 frame.draw(timeText);
                 frame.display();
@@ -753,7 +755,7 @@ std::vector<sf::Texture> GS::SimDataPipeline::getVideo(
                         static_cast<float>(rendersL[rIndex].first.getSize().x),
                     static_cast<float>(gasSize.y) /
                         static_cast<float>(rendersL[rIndex].first.getSize().y));
-                box.setTexture(rendersL[rIndex++].first);
+                box.setTexture(rendersL[rIndex++].first.getTexture());
                 frame.draw(box);
                 frame.draw(timeText);
                 frame.display();
@@ -823,7 +825,7 @@ std::vector<sf::Texture> GS::SimDataPipeline::getVideo(
                         static_cast<float>(rendersL[rIndex].first.getSize().x),
                     static_cast<float>(gasSize.y) /
                         static_cast<float>(rendersL[rIndex].first.getSize().y));
-                box.setTexture(rendersL[rIndex++].first);
+                box.setTexture(rendersL[rIndex++].first.getTexture());
                 frame.draw(box);
                 frame.draw(timeText);
                 frame.display();
@@ -910,7 +912,7 @@ std::vector<sf::Texture> GS::SimDataPipeline::getVideo(
                       static_cast<float>(rendersL[rIndex].first.getSize().x),
                   static_cast<float>(gasSize.y) /
                       static_cast<float>(rendersL[rIndex].first.getSize().y));
-              box.setTexture(rendersL[rIndex++].first);
+              box.setTexture(rendersL[rIndex++].first.getTexture());
               frame.draw(box);
               frame.draw(timeText);
               frame.display();
@@ -1005,7 +1007,7 @@ std::vector<sf::Texture> GS::SimDataPipeline::getVideo(
                       static_cast<float>(rendersL[rIndex].first.getSize().x),
                   static_cast<float>(gasSize.y) /
                       static_cast<float>(rendersL[rIndex].first.getSize().y));
-              box.setTexture(rendersL[(rIndex++)].first);
+              box.setTexture(rendersL[(rIndex++)].first.getTexture());
               frame.draw(box);
               frame.draw(timeText);
               frame.display();
@@ -1075,7 +1077,7 @@ std::vector<sf::Texture> GS::SimDataPipeline::getVideo(
                     static_cast<float>(rendersL[rIndex].first.getSize().x),
                 static_cast<float>(gasSize.y) /
                     static_cast<float>(rendersL[rIndex].first.getSize().y));
-            box.setTexture(rendersL[rIndex++].first);
+            box.setTexture(rendersL[rIndex++].first.getTexture());
             frame.draw(box);
             frame.draw(timeText);
             frame.display();
@@ -1100,6 +1102,10 @@ std::vector<sf::Texture> GS::SimDataPipeline::getVideo(
   }
 
   delete trnsfrImg;
+  {
+    std::lock_guard<std::mutex> fTimeGuard{fTimeMtx};
+    shownFTime = fTime;
+  }
   return frames;
 }
 
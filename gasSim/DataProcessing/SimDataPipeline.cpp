@@ -2,19 +2,39 @@
 
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <exception>
+#include <future>
 #include <iterator>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <stdexcept>
+#include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include <SFML/Graphics/RenderTexture.hpp>
 #include <SFML/Window/Context.hpp>
 
+#include <TROOT.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+#include "DataProcessing/Checkpoint.hpp"
+#include "DataProcessing/CollisionTracker.hpp"
+#include "DataProcessing/FixedHistogram.hpp"
+#include "DataProcessing/GasState.hpp"
 #include "DataProcessing/TdStats.hpp"
 #include "GasData.hpp"
 #include "Graphics/Camera.hpp"
+#include "Graphics/Render.hpp"
+#include "PhysicsEngine/GSVector.hpp"
+#include "PhysicsEngine/Particle.hpp"
 
 namespace GS {
 
@@ -25,6 +45,8 @@ SimDataPipeline::SimDataPipeline(size_t statSizeV, double framerate,
     throw std::invalid_argument(
         "SDP constructor error: provided null statSize");
   }
+  ring = std::make_unique<EventRing>(
+      statSizeV * 4 > 4096 ? statSizeV * 4 : size_t{4096});
   setFramerate(framerate);
   if (speedsHTemplate.IsZombie()) {
     throw std::invalid_argument(
@@ -34,21 +56,80 @@ SimDataPipeline::SimDataPipeline(size_t statSizeV, double framerate,
     throw std::invalid_argument(
         "SDP constructor error: provided non-empty histogram template");
   }
+  // the stats workers copy histograms from several threads, enabled once
+  // here since it's process-wide
+  ROOT::EnableThreadSafety();
 }
 
 bool isNegligible(double epsilon, double x);  // implemented in TdStats.cpp
 
+// the first record starts the state, which must then be a keyframe
+GasState const& advance(std::optional<GasState>& state, GasData const& data) {
+  if (state.has_value()) {
+    state->apply(data);
+  } else {
+    state.emplace(data);
+  }
+  return *state;
+}
+
+// estimated bytes held by the queue items
+size_t dataBytes(GasData const& data) {
+  return sizeof(GasData) +
+         (data.isKeyframe() ? data.getNParticles() * sizeof(Particle) : 0);
+}
+
+size_t statBytes(TdStats const& stat) { return stat.memoryUsage(); }
+
+size_t renderBytes(std::pair<Render, double> const& render) {
+  return sizeof(render) + size_t{render.first.getSize().x} *
+                              render.first.getSize().y * 4;
+}
+
+// gas states, their particles brought to the record time included, and the
+// collision tracker of the stats
+size_t statesBytes(size_t nParticles, bool withGraphics) {
+  size_t stateBytes{nParticles * (2 * sizeof(Particle) + sizeof(double))};
+  return (withGraphics ? 2 : 1) * stateBytes +
+         nParticles * (sizeof(GSVectorD) + sizeof(double));
+}
+
+// the oldest items are dropped down to the low watermark, the items of the
+// output queues all having the size of the newest one
+template <typename T, typename Bytes>
+size_t trimQueue(std::deque<T>& queue, QueueLimits const& limits,
+                 Bytes bytes) {
+  if (!limits.high || limits.policy != QueuePolicy::dropOldest ||
+      queue.empty()) {
+    return 0;
+  }
+  size_t itemSize{limits.inBytes ? bytes(queue.back()) : 1};
+  if (queue.size() * itemSize <= limits.high) {
+    return 0;
+  }
+  size_t keep{limits.low / itemSize};
+  size_t dropped{queue.size() - (keep < queue.size() ? keep : queue.size())};
+  queue.erase(queue.begin(), queue.begin() + static_cast<long>(dropped));
+  return dropped;
+}
+
 void SimDataPipeline::addData(std::vector<GasData>&& data) {
   if (data.size()) {
+    if (!keyframeAdded && !data.front().isKeyframe()) {
+      throw std::invalid_argument(
+          "SDP addData error: the first data added must start with a "
+          "keyframe");
+    }
     doneAddingData.store(false);
     double prevDTime;
     bool firstD{true};
     for (GasData const& d : data) {
       if (!nParticles.has_value()) {
-        nParticles = d.getParticles().size();
+        std::lock_guard<std::mutex> rawDataGuard{rawDataMtx};  // memoryUsage
+        nParticles = d.getNParticles();
         assert(nParticles.value());
       } else {
-        if (d.getParticles().size() != nParticles) {
+        if (d.getNParticles() != nParticles) {
           throw std::invalid_argument(
               "SDP addData error: non-matching particle numbers");
         }
@@ -64,181 +145,364 @@ void SimDataPipeline::addData(std::vector<GasData>&& data) {
       prevDTime = d.getTime();
       firstD = false;
     }
-    {
-      std::lock_guard<std::mutex> rawDataGuard{rawDataMtx};
-      if (rawDataBackTime.has_value()) {
-        if (!isNegligible(data.front().getT0() - rawDataBackTime.value(),
-                          data.front().getTime() - data.front().getT0())) {
-          throw std::invalid_argument(
-              "SDP addData error: data time is smaller than latest raw data "
-              "piece time");
+    if (rawDataBackTime.has_value()) {
+      if (!isNegligible(data.front().getT0() - rawDataBackTime.value(),
+                        data.front().getTime() - data.front().getT0())) {
+        throw std::invalid_argument(
+            "SDP addData error: data time is smaller than latest raw data "
+            "piece time");
+      }
+    }
+    size_t bytes{0};
+    size_t particlesBytes{0};
+    for (GasData const& d : data) {
+      bytes += dataBytes(d);
+      particlesBytes += dataBytes(d) - sizeof(GasData);
+    }
+    auto stopped{[this] { return stoppedProcessing.load(); }};
+    auto start{std::chrono::steady_clock::now()};
+    bool waited{false};
+    // waits for the consumer to bring the queue back to the low watermark,
+    // as long as it still has a stat to take from it
+    QueueLimits const& limits{queueLimits[0]};
+    auto fill{[&] {
+      return limits.inBytes ? rawDataBytes.load() : ring->size();
+    }};
+    if (limits.high && fill() > limits.high) {
+      waited = true;
+      while (fill() > limits.low && ring->size() >= statSize.load() &&
+             !stopped()) {
+        // until the consumer takes some records
+        ring->waitForSpace(ring->capacity() - ring->size() + 1,
+                           std::chrono::milliseconds(100), stopped);
+      }
+    }
+    rawDataBackTime = data.back().getTime();
+    // counted before the consumer can take them
+    rawDataBytes += bytes;
+    keyframeBytes += particlesBytes;
+    size_t pushed{0};
+    while (pushed < data.size()) {
+      pushed += ring->push(data, pushed);
+      if (pushed < data.size()) {
+        // nothing would free the ring anymore
+        if (stopped()) {
+          break;
         }
+        waited = true;
+        ring->waitForSpace(1, std::chrono::milliseconds(100), stopped);
       }
-      rawData.insert(rawData.end(), std::make_move_iterator(data.begin()),
-                     std::make_move_iterator(data.end()));
-      rawDataBackTime = rawData.back().getTime();
     }
-    rawDataCv.notify_all();
+    if (pushed < data.size()) {
+      for (size_t i{pushed}; i < data.size(); ++i) {
+        rawDataBytes -= dataBytes(data[i]);
+        keyframeBytes -= dataBytes(data[i]) - sizeof(GasData);
+      }
+      droppedItems[0] += data.size() - pushed;
+    }
+    if (waited) {
+      blockedNs[0] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    }
+    data.clear();
+    keyframeAdded = true;
   }
 }
 
-void SimDataPipeline::processData(bool mfpMemory,
-                                  std::function<bool()> stopLambda) {
-  processing.store(true);
-  std::vector<GasData> data{};
-  std::unique_lock<std::mutex> rawDataLock(rawDataMtx, std::defer_lock);
-  while (!stopLambda()) {
-    rawDataLock.lock();
-    rawDataCv.wait_for(rawDataLock, std::chrono::milliseconds(100), [this] {
-      return rawData.size() > statSize.load() || doneAddingData.load();
-    });
-    size_t statSizeL{statSize.load()};  // stat size for this iteration
-    if (doneAddingData.load() && rawData.size() < statSizeL) {
-      break;
-    }
-    size_t nStats{rawData.size() / statSizeL};
-    {  // chunkSize nspc
-      size_t chunkSize = statChunkSize.load();
-      if (chunkSize) {
-        nStats = nStats > chunkSize ? chunkSize : nStats;
-      }
-    }  // chunkSize nspc end
-
-    if (nStats) {
-      data.insert(data.end(), std::make_move_iterator(rawData.begin()),
-                  std::make_move_iterator(
-                      rawData.begin() + static_cast<long>(nStats * statSizeL)));
-      assert(data.size());
-      rawData.erase(rawData.begin(),
-                    rawData.begin() + static_cast<long>(nStats * statSizeL));
-      rawDataLock.unlock();
-      std::vector<TdStats> tempStats;
-
-      processStats(data, mfpMemory, statSizeL, tempStats);
-      {  // guard scope begin
-        std::lock_guard<std::mutex> outputGuard{outputMtx};
-        std::lock_guard<std::mutex> lastStatGuard{lastStatMtx};
-        std::lock_guard<std::mutex> statsGuard{statsMtx};
-        stats.insert(stats.end(), std::make_move_iterator(tempStats.begin()),
-                     std::make_move_iterator(tempStats.end()));
-        lastStat = stats.back();
-      }  // guards scope end
-      addedResults.store(true);
-      outputCv.notify_all();
-    } else {
-      rawDataLock.unlock();
+// waits for the records of at least a stat and takes those of up to a chunk
+// of stats, data being left empty on timeouts, returns false once no stat
+// will come anymore
+bool SimDataPipeline::takeData(std::vector<GasData>& data, size_t& statSizeL,
+                               std::function<bool()> const& stopper) {
+  statSizeL = statSize.load();  // stat size for this iteration
+  ring->waitForData(statSizeL, std::chrono::milliseconds(100),
+                    [&] { return doneAddingData.load() || stopper(); });
+  // read before the size, the producer setting it after its last push
+  bool done{doneAddingData.load()};
+  size_t available{ring->size()};
+  if (done && available < statSizeL) {
+    return false;
+  }
+  size_t nStats{available / statSizeL};
+  size_t chunkSize{statChunkSize.load()};
+  if (chunkSize) {
+    nStats = nStats > chunkSize ? chunkSize : nStats;
+  }
+  if (nStats) {
+    ring->pop(data, nStats * statSizeL);
+    assert(data.size() == nStats * statSizeL);
+    for (GasData const& d : data) {
+      rawDataBytes -= dataBytes(d);
+      keyframeBytes -= dataBytes(d) - sizeof(GasData);
     }
-    data.clear();
   }
-  processing.store(false);
+  return true;
+}
+
+void SimDataPipeline::processData(bool mfpMemory,
+                                  std::function<bool()> stopLambda) {
+  process(mfpMemory, stopLambda, nullptr, nullptr);
 }
 
 void SimDataPipeline::processData(Camera camera, RenderStyle style,
                                   bool mfpMemory,
                                   std::function<bool()> stopper) {
+  rendering.store(true);
+  process(mfpMemory, stopper, &camera, &style);
+}
+
+// the calling thread takes the batches and follows the states through them,
+// the workers share a queue of jobs for each kind, and the one completing
+// the oldest batch publishes it along with the completed ones following it,
+// outside of the jobs lock
+void SimDataPipeline::process(bool mfpMemory,
+                              std::function<bool()> const& stopper,
+                              Camera const* camera, RenderStyle const* style) {
   processing.store(true);
-  std::unique_lock<std::mutex> rawDataLock{rawDataMtx, std::defer_lock};
-  while (!stopper()) {
-    rawDataLock.lock();
-    rawDataCv.wait_for(rawDataLock, std::chrono::milliseconds(100), [this] {
-      return rawData.size() > statSize.load() || doneAddingData.load();
-    });
-    size_t statSizeL{statSize.load()};  // stat size for this iteration
-    if (doneAddingData.load() && rawData.size() < statSizeL) {
-      break;
-    }
+  stoppedProcessing.store(false);
+  bool const withRenders{camera != nullptr};
+  size_t const maxBatches{statsWorkers + (withRenders ? renderWorkers : 0)};
 
-    size_t nStats{rawData.size() / statSizeL};
-    size_t chunkSize{statChunkSize.load()};
-    if (chunkSize) {
-      nStats = nStats > chunkSize ? chunkSize : nStats;
+  // stat the next batch continues, and last frame time
+  std::optional<TdStats> chain{};
+  if (mfpMemory) {
+    std::lock_guard<std::mutex> lastStatGuard{lastStatMtx};
+    // the published stats must not see the chain moving on
+    if (lastStat.has_value()) {
+      chain = lastStat->detached();
     }
+  }
+  std::optional<double> renderTime{};
+  {
+    std::lock_guard<std::mutex> gTimeGuard{gTimeMtx};
+    renderTime = gTime;
+  }
 
-    if (nStats) {
-      auto data{std::make_shared<std::vector<GasData>>()};
-      std::vector<TdStats> tempStats{};
-      std::vector<std::pair<sf::Texture, double>> tempRenders{};
-      data->insert(
-          data->end(), std::make_move_iterator(rawData.begin()),
-          std::make_move_iterator(rawData.begin() +
-                                  static_cast<long>(nStats * statSizeL)));
-      assert(data->size());
-      rawData.erase(rawData.begin(),
-                    rawData.begin() + static_cast<long>(nStats * statSizeL));
-      rawDataLock.unlock();
+  std::mutex jobsMtx{};
+  std::condition_variable jobsCv{};
+  std::deque<std::unique_ptr<Batch>> batches{};  // in order
+  std::deque<Batch*> statsJobs{};
+  std::deque<Batch*> renderJobs{};
+  std::vector<std::unique_ptr<Batch>> spareBatches{};  // reused
+  size_t publishingBatches{0};  // taken out of batches by the publisher
+  bool closing{false};
+  std::exception_ptr failure{};
 
-      std::thread sThread{[=, &tempStats]() {
-        try {
-          processStats(*data, mfpMemory, statSizeL, tempStats);
-        } catch (std::exception const& e) {
-          std::terminate();
+  auto work{[&](bool renderer) {
+    std::deque<Batch*>& jobs{renderer ? renderJobs : statsJobs};
+    std::unique_lock<std::mutex> jobsLock{jobsMtx};
+    while (true) {
+      jobsCv.wait(jobsLock, [&] { return !jobs.empty() || closing; });
+      if (jobs.empty()) {
+        break;
+      }
+      Batch& batch{*jobs.front()};
+      jobs.pop_front();
+      jobsLock.unlock();
+      std::exception_ptr error{};
+      try {
+        if (renderer) {
+          processGraphics(batch, *camera, *style);
+        } else {
+          processStats(batch);
         }
-      }};
-
-      std::thread gThread{[=, &tempRenders]() {
+      } catch (...) {
+        error = std::current_exception();
+      }
+      jobsLock.lock();
+      (renderer ? batch.rendersDone : batch.statsDone) = true;
+      if (error && !failure) {
+        failure = error;
+      }
+      // a single worker publishes at a time, then takes over the batches the
+      // others completed meanwhile, so that they stay in order
+      while (!publishingBatches && !failure) {
+        std::vector<std::unique_ptr<Batch>> ready{};
+        while (batches.size() && batches.front()->statsDone &&
+               (batches.front()->rendersDone || !withRenders)) {
+          ready.emplace_back(std::move(batches.front()));
+          batches.pop_front();
+        }
+        if (ready.empty()) {
+          break;
+        }
+        publishingBatches = ready.size();
+        jobsLock.unlock();
         try {
-          processGraphics(*data, camera, style, tempRenders);
-        } catch (std::exception const& e) {
-          std::terminate();
+          for (std::unique_ptr<Batch>& published : ready) {
+            publish(*published, withRenders);
+          }
+        } catch (...) {
+          error = std::current_exception();
+        }
+        jobsLock.lock();
+        publishingBatches = 0;
+        if (error && !failure) {
+          failure = error;
+        }
+        for (std::unique_ptr<Batch>& published : ready) {
+          spareBatches.emplace_back(std::move(published));
         }
-      }};
+      }
+      jobsCv.notify_all();
+    }
+  }};
+  std::vector<std::thread> workers{};
+  for (size_t i{0}; i < maxBatches; ++i) {
+    workers.emplace_back(work, i >= statsWorkers);
+  }
 
-      if (sThread.joinable()) {
-        sThread.join();
+  std::unique_ptr<Batch> next{};
+  while (!stopper()) {
+    {
+      std::unique_lock<std::mutex> jobsLock{jobsMtx};
+      jobsCv.wait(jobsLock, [&] {
+        return batches.size() + publishingBatches < maxBatches || failure;
+      });
+      if (failure) {
+        break;
+      }
+      if (!next && spareBatches.size()) {
+        next = std::move(spareBatches.back());
+        spareBatches.pop_back();
       }
-      if (gThread.joinable()) {
-        gThread.join();
+    }
+    if (!next) {
+      next = std::make_unique<Batch>();
+    }
+    if (!waitForOutputs(withRenders, stopper) ||
+        !takeData(next->data, next->statSize, stopper)) {
+      break;
+    }
+    if (next->data.empty()) {
+      continue;
+    }
+    prepareStats(*next, mfpMemory, chain);
+    if (withRenders) {
+      prepareGraphics(*next, renderTime);
+    }
+    {
+      std::lock_guard<std::mutex> jobsGuard{jobsMtx};
+      next->statsDone = false;
+      next->rendersDone = false;
+      statsJobs.push_back(next.get());
+      if (withRenders) {
+        renderJobs.push_back(next.get());
       }
-      {  // output guard scope begin
-        std::lock_guard<std::mutex> outputGuard{outputMtx};
-        {  // stats guard scope begin
-          std::lock_guard<std::mutex> lastStatGuard{lastStatMtx};
-          std::lock_guard<std::mutex> statsGuard{statsMtx};
-          stats.insert(stats.end(), std::make_move_iterator(tempStats.begin()),
-                       std::make_move_iterator(tempStats.end()));
-          lastStat = stats.back();
-        }  // stats guard scope end
-        {  // renders guard scope begin
-          std::lock_guard<std::mutex> gTimeGuard{gTimeMtx};
-          std::lock_guard<std::mutex> rendersGuard{rendersMtx};
-          renders.insert(renders.end(),
-                         std::make_move_iterator(tempRenders.begin()),
-                         std::make_move_iterator(tempRenders.end()));
-          gTime = renders.back().second;
-        }  // renders guard scope end
-      }  // output guard scope end
-      addedResults.store(true);
-      outputCv.notify_all();
-      tempStats.clear();
-      tempRenders.clear();
-    } else {
-      rawDataLock.unlock();
+      batches.emplace_back(std::move(next));
     }
+    jobsCv.notify_all();
   }
+
+  {
+    std::lock_guard<std::mutex> jobsGuard{jobsMtx};
+    if (failure) {
+      statsJobs.clear();
+      renderJobs.clear();
+    }
+    closing = true;
+  }
+  jobsCv.notify_all();
+  for (std::thread& w : workers) {
+    w.join();
+  }
+  // the stats state is ahead of the published stats after a failure
+  if (!failure) {
+    finishCheckpoints();
+  } else if (checkpointWrite.valid()) {
+    checkpointWrite.wait();
+  }
+  {
+    std::lock_guard<std::mutex> outputGuard{outputMtx};
+    stoppedProcessing.store(true);
+  }
+  outputCv.notify_all();
+  ring->wake();
   processing.store(false);
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
 }
 
-void SimDataPipeline::processGraphics(
-    std::vector<GasData> const& data, Camera const& camera,
-    RenderStyle const& style,
-    std::vector<std::pair<sf::Texture, double>>& tempRenders) {
-  sf::RenderTexture picture;
-  picture.setActive();
+void SimDataPipeline::publish(Batch& batch, bool withRenders) {
+  {  // output guard scope begin
+    std::lock_guard<std::mutex> outputGuard{outputMtx};
+    {  // stats guard scope begin
+      std::lock_guard<std::mutex> lastStatGuard{lastStatMtx};
+      std::lock_guard<std::mutex> statsGuard{statsMtx};
+      stats.insert(stats.end(), std::make_move_iterator(batch.stats.begin()),
+                   std::make_move_iterator(batch.stats.end()));
+      lastStat = stats.back();
+      droppedItems[1] += trimQueue(stats, queueLimits[1], statBytes);
+    }  // stats guard scope end
+    if (withRenders) {  // renders guard scope begin
+      std::lock_guard<std::mutex> gTimeGuard{gTimeMtx};
+      std::lock_guard<std::mutex> rendersGuard{rendersMtx};
+      renders.insert(renders.end(),
+                     std::make_move_iterator(batch.renders.begin()),
+                     std::make_move_iterator(batch.renders.end()));
+      if (batch.renders.size()) {
+        gTime = batch.renders.back().second;
+      }
+      droppedItems[2] += trimQueue(renders, queueLimits[2], renderBytes);
+    }  // renders guard scope end
+    ++publishedBatches;
+  }  // output guard scope end
+  addedResults.store(true);
+  outputCv.notify_all();
+  checkpoint(batch);
+
+  batch.data.clear();
+  batch.stats.clear();
+  batch.renders.clear();
+  batch.endState.reset();
+  batch.endPositions.clear();
+  batch.graphicsStart.reset();
+}
 
-  // setting local time variables
-  double gTimeL;
+// the graphics state is kept at the end of the taken data, the frame times
+// follow the same sums as when drawn
+void SimDataPipeline::prepareGraphics(Batch& batch,
+                                      std::optional<double>& renderTime) {
+  std::vector<GasData> const& data{batch.data};
   double gDeltaTL{gDeltaT.load()};
-  {
+  assert(gDeltaTL > 0.);
+  if (!renderTime.has_value()) {
+    renderTime = data[0].getT0() - gDeltaTL;
     std::lock_guard<std::mutex> gTimeGuard{gTimeMtx};
-    assert(gDeltaTL > 0.);
-    if (!gTime.has_value()) {
-      gTime = data[0].getT0() - gDeltaTL;
-    }
-    assert(gTime <= data[0].getT0());
-    gTimeL = *gTime;
+    gTime = renderTime;
+  }
+  assert(*renderTime <= data[0].getT0());
+  batch.gTime = *renderTime;
+  batch.gDeltaT = gDeltaTL;
+  if (!data[0].isKeyframe()) {
+    batch.graphicsStart = graphicsState;
+  }
+  for (GasData const& d : data) {
+    advance(graphicsState, d);
+  }
+  double gTimeL{*renderTime};
+  while (gTimeL + gDeltaTL < data[0].getT0()) {
+    gTimeL += gDeltaTL;
   }
+  while (gTimeL + gDeltaTL <= data.back().getTime()) {
+    gTimeL += gDeltaTL;
+  }
+  renderTime = gTimeL;
+}
 
-  tempRenders.reserve(
+// frames only depend on their state and time, so they are collected in order
+// and drawn in parallel, each thread on its own targets, a few per thread at
+// a time to bound the copies of the states
+void SimDataPipeline::processGraphics(Batch& batch, Camera const& camera,
+                                      RenderStyle const& style) {
+  std::vector<GasData> const& data{batch.data};
+  std::optional<GasState> state{std::move(batch.graphicsStart)};
+  double gTimeL{batch.gTime};
+  double gDeltaTL{batch.gDeltaT};
+
+  batch.renders.reserve(
       static_cast<size_t>((data.back().getTime() - data.front().getTime()) /
                           gDeltaTL) +
       1);
@@ -247,51 +511,382 @@ void SimDataPipeline::processGraphics(
     gTimeL += gDeltaTL;
   }
 
+  struct Frame {
+    size_t state{0};
+    double deltaT{0.};  // from the state
+    double time{0.};
+  };
+  size_t const maxFrames{
+      4 * static_cast<size_t>(tbb::this_task_arena::max_concurrency())};
+  std::vector<GasState> frameStates{};
+  std::vector<Frame> frames{};
+  auto drawFrames{[&] {
+    size_t first{batch.renders.size()};
+    batch.renders.resize(first + frames.size());
+    tbb::parallel_for(size_t{0}, frames.size(), [&](size_t i) {
+      // drawGas runs parallel loops itself: while waiting for them a thread
+      // mustn't take up another frame, which would draw on the same targets
+      tbb::this_task_arena::isolate([&] {
+        RenderTargets& targets{renderTargets.local()};
+        GasState const& frameState{frameStates[frames[i].state]};
+        if (renderBackend == RenderBackend::cpu) {
+          // kept as pixels, as uploading them needs a gl context
+          drawGas(frameState, camera, targets.canvas, style, frames[i].deltaT);
+          batch.renders[first + i] = {
+              Render{targets.canvas.getSize(), targets.canvas.getPixelsPtr()},
+              frames[i].time};
+        } else {
+          drawGas(frameState, camera, targets, style, frames[i].deltaT);
+          batch.renders[first + i] = {Render{targets.picture.getTexture()},
+                                      frames[i].time};
+        }
+      });
+    });
+    frames.clear();
+    frameStates.clear();
+  }};
+
   for (GasData const& dat : data) {
+    GasState const& s{advance(state, dat)};
+    size_t const nFrames{frames.size()};
     while (gTimeL + gDeltaTL <= dat.getTime()) {
       gTimeL += gDeltaTL;
-      drawGas(dat, camera, picture, style, gTimeL - dat.getTime());
-      tempRenders.emplace_back(picture.getTexture(), gTimeL);
+      frames.push_back({frameStates.size(), gTimeL - dat.getTime(), gTimeL});
+    }
+    if (frames.size() != nFrames) {
+      frameStates.push_back(s);
+      // synced here, so that the frames drawn from the same state in
+      // parallel only read it
+      frameStates.back().getParticles();
+    }
+    if (frames.size() >= maxFrames) {
+      drawFrames();
     }
   }
+  drawFrames();
 }
 
-void SimDataPipeline::processStats(std::vector<GasData> const& data,
-                                   bool mfpMemory, size_t statSizeL,
-                                   std::vector<GS::TdStats>& tempStats) {
+// the stats are computed in parallel from the state after the first event
+// of each one and from the stat each one continues, both found by this
+// sequential pass that only follows the gas state, the collision positions
+// and the current speeds, so that the results match the ones of chaining
+// the stats one after the other
+void SimDataPipeline::prepareStats(Batch& batch, bool mfpMemory,
+                                   std::optional<TdStats>& chain) {
+  std::vector<GasData> const& data{batch.data};
+  size_t statSizeL{batch.statSize};
   assert(!(data.size() % statSizeL));
+  size_t nStats{data.size() / statSizeL};
+
+  batch.firstStates.clear();
+  batch.firstStates.reserve(nStats);
+  batch.prevStats.assign(nStats, std::nullopt);
+  std::optional<TdStats> tracked{};
+  for (size_t i{0}; i < nStats; ++i) {
+    GasState const& first{advance(statsState, data[i * statSizeL])};
+    batch.firstStates.emplace_back(first);
+    if (mfpMemory) {
+      if (chain.has_value()) {
+        batch.prevStats[i] = chain->detached();
+        chain = TdStats{first, std::move(*chain)};
+      } else {
+        chain = TdStats{first, speedsHTemplate, statsTracker};
+      }
+    } else if (i + 1 == nStats && !checkpointPath.empty()) {
+      // only followed for the collision positions of the checkpoints
+      tracked = TdStats{first, speedsHTemplate, statsTracker};
+    }
+    std::optional<TdStats>& skipping{mfpMemory ? chain : tracked};
+    for (size_t j{1}; j < statSizeL; ++j) {
+      GasState const& state{advance(statsState, data[i * statSizeL + j])};
+      if (skipping.has_value()) {
+        skipping->skipData(state);
+      }
+    }
+  }
+  if (!checkpointPath.empty()) {
+    batch.endState = statsState;
+    batch.endPositions =
+        (mfpMemory ? chain : tracked)->getMemory().lastCollPositions;
+  }
+}
 
-  tempStats.reserve(data.size() / statSizeL);
+void SimDataPipeline::processStats(Batch& batch) {
+  std::vector<GasData> const& data{batch.data};
+  size_t statSizeL{batch.statSize};
+  size_t nStats{data.size() / statSizeL};
 
-  if (mfpMemory) {
+  std::vector<std::optional<TdStats>> results(nStats);
+  tbb::parallel_for(
+      tbb::blocked_range<size_t>(0, nStats, 1),
+      [&](tbb::blocked_range<size_t> const& range) {
+        for (size_t i{range.begin()}; i < range.end(); ++i) {
+          GasState state{std::move(batch.firstStates[i])};
+          TdStats stat{batch.prevStats[i].has_value()
+                           ? TdStats{state, std::move(*batch.prevStats[i])}
+                           : TdStats{state, speedsHTemplate}};
+          for (size_t j{1}; j < statSizeL; ++j) {
+            state.apply(data[i * statSizeL + j]);
+            stat.addData(state);
+          }
+          results[i] = std::move(stat);
+        }
+      });
+
+  // each stat keeps the tracker it was computed on, left at its end, since
+  // the chain one keeps changing after publishing
+  batch.stats.reserve(nStats);
+  for (std::optional<TdStats>& stat : results) {
+    batch.stats.emplace_back(std::move(*stat));
+  }
+}
+
+// called after publishing each batch, whose end state was kept when
+// checkpointing, the processing thread being already past it
+void SimDataPipeline::checkpoint(Batch const& batch) {
+  processedEvents += batch.data.size();
+  if (checkpointPath.empty()) {
+    return;
+  }
+  assert(batch.endState.has_value());
+  if (lastCheckpointTime.has_value() &&
+      batch.endState->getTime() < *lastCheckpointTime + checkpointInterval) {
+    return;
+  }
+  // a slow disk skips checkpoints instead of stalling the processing
+  if (checkpointWrite.valid()) {
+    if (checkpointWrite.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready) {
+      return;
+    }
+    checkpointWrite.get();  // rethrows write errors
+  }
+  writeLastSnapshot(*batch.endState, batch.endPositions);
+}
+
+// the collision positions are the ones of the last published stat, which
+// can't be read from its tracker while the processing thread moves it on
+void SimDataPipeline::writeLastSnapshot(
+    GasState const& state, std::vector<GSVectorD> const& positions) {
+  Checkpoint c{};
+  c.radius = state.getRadius();
+  c.mass = state.getMass();
+  c.boxSide = state.getBoxSide();
+  c.time = state.getTime();
+  c.events = processedEvents;
+  c.particles = state.getParticles();
+  {
     std::lock_guard<std::mutex> lastStatGuard{lastStatMtx};
-    for (size_t i{0}; i < data.size() / statSizeL; ++i) {
-      TdStats stat{tempStats.size()
-                       ? TdStats{data[i * statSizeL], TdStats(tempStats.back())}
-                   : lastStat.has_value()
-                       ? TdStats{data[i * statSizeL], std::move(*lastStat)}
-                       : TdStats{data[i * statSizeL], speedsHTemplate}};
-      lastStat.reset();
-      for (size_t j{1}; j < statSizeL; ++j) {
-        stat.addData(data[i * statSizeL + j]);
+    if (lastStat.has_value()) {
+      c.lastStat = TdStats::Memory{positions, lastStat->getTemp(),
+                                   lastStat->getTime(),
+                                   lastStat->getBoxSide()};
+    }
+  }
+  {
+    std::lock_guard<std::mutex> gTimeGuard{gTimeMtx};
+    c.gTime = gTime;
+  }
+  {
+    std::lock_guard<std::mutex> fTimeGuard{fTimeMtx};
+    c.fTime = shownFTime;
+  }
+  lastCheckpointTime = c.time;
+  checkpointWrite = std::async(
+      std::launch::async, [c = std::move(c), path = checkpointPath] {
+        writeCheckpoint(c, path);
+      });
+}
+
+// the checkpoint of the last processed stat is written before returning
+void SimDataPipeline::finishCheckpoints() {
+  if (checkpointWrite.valid()) {
+    checkpointWrite.get();
+  }
+  if (!checkpointPath.empty() && statsState.has_value() &&
+      lastCheckpointTime != statsState->getTime()) {
+    std::vector<GSVectorD> positions{};
+    {
+      std::lock_guard<std::mutex> lastStatGuard{lastStatMtx};
+      if (lastStat.has_value()) {
+        positions = lastStat->getMemory().lastCollPositions;
       }
-      tempStats.emplace_back(std::move(stat));
     }
-    lastStat = tempStats.back();
-  } else {
-    for (size_t i{0}; i < data.size() / statSizeL; ++i) {
-      TdStats stat{data[i * statSizeL], speedsHTemplate};
-      for (size_t j{1}; j < statSizeL; ++j) {
-        stat.addData(data[i * statSizeL + j]);
+    writeLastSnapshot(*statsState, positions);
+    checkpointWrite.get();
+  }
+}
+
+bool SimDataPipeline::waitForResults(std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> resultsLock{outputMtx};
+  outputCv.wait_for(resultsLock, timeout, [this] {
+    return publishedBatches != waitedBatches || stoppedProcessing.load();
+  });
+  bool published{publishedBatches != waitedBatches};
+  waitedBatches = publishedBatches;
+  return published;
+}
+
+size_t SimDataPipeline::getRawDataSize() { return ring->size(); }
+
+size_t SimDataPipeline::queueFill(PipelineQueue queue, bool inBytes) {
+  switch (queue) {
+    case PipelineQueue::rawData:
+      return inBytes ? rawDataBytes.load() : ring->size();
+    case PipelineQueue::stats: {
+      std::lock_guard<std::mutex> statsGuard{statsMtx};
+      if (!inBytes || stats.empty()) {
+        return stats.size();
       }
-      tempStats.emplace_back(std::move(stat));
+      return stats.size() * statBytes(stats.back());
+    }
+    case PipelineQueue::renders: {
+      std::lock_guard<std::mutex> rendersGuard{rendersMtx};
+      if (!inBytes || renders.empty()) {
+        return renders.size();
+      }
+      return renders.size() * renderBytes(renders.back());
+    }
+    default:
+      throw std::invalid_argument("queueFill error: invalid queue provided");
+  }
+}
+
+QueueStatus SimDataPipeline::getQueueStatus(PipelineQueue queue) {
+  size_t i{static_cast<size_t>(queue)};
+  if (i >= queueLimits.size()) {
+    throw std::invalid_argument(
+        "getQueueStatus error: invalid queue provided");
+  }
+  return {queueFill(queue, false), queueFill(queue, true),
+          droppedItems[i].load(),
+          static_cast<double>(blockedNs[i].load()) * 1E-9};
+}
+
+// blocking outputs past their high watermark, or back only above their low
+// one while waiting
+bool SimDataPipeline::outputsFull(bool withRenders, bool waiting) {
+  for (PipelineQueue queue : {PipelineQueue::stats, PipelineQueue::renders}) {
+    QueueLimits const& limits{queueLimits[static_cast<size_t>(queue)]};
+    if ((queue == PipelineQueue::renders && !withRenders) || !limits.high ||
+        limits.policy != QueuePolicy::block) {
+      continue;
+    }
+    if (queueFill(queue, limits.inBytes) >
+        (waiting ? limits.low : limits.high)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// returns false if stopped while waiting
+bool SimDataPipeline::waitForOutputs(bool withRenders,
+                                     std::function<bool()> const& stopper) {
+  if (!outputsFull(withRenders, false)) {
+    return true;
+  }
+  auto start{std::chrono::steady_clock::now()};
+  std::unique_lock<std::mutex> outputLock{outputMtx};
+  while (outputsFull(withRenders, true)) {
+    if (stopper()) {
+      return false;
     }
+    outputSpaceCv.wait_for(outputLock, std::chrono::milliseconds(100));
   }
+  int64_t blocked{std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count()};
+  blockedNs[1] += blocked;
+  if (withRenders) {
+    blockedNs[2] += blocked;
+  }
+  return true;
 }
 
-size_t SimDataPipeline::getRawDataSize() {
-  std::lock_guard<std::mutex> dataGuard(rawDataMtx);
-  return rawData.size();
+PipelineMemoryUsage SimDataPipeline::memoryUsage() {
+  PipelineMemoryUsage usage{ring->memoryUsage() + keyframeBytes.load(),
+                            queueFill(PipelineQueue::stats, true),
+                            queueFill(PipelineQueue::renders, true), 0};
+  {
+    std::lock_guard<std::mutex> rawDataGuard{rawDataMtx};
+    if (nParticles.has_value()) {
+      usage.states = statesBytes(*nParticles, rendering.load());
+    }
+  }
+  return usage;
+}
+
+// queues bounded by their watermarks can overshoot them by the batch their
+// producer adds at once, for the outputs by the batches being processed
+PipelineMemoryUsage SimDataPipeline::estimateMemory(size_t particlesN,
+                                                    size_t nIters,
+                                                    double eventRate,
+                                                    sf::Vector2u resolution,
+                                                    bool withRenders) const {
+  if (eventRate <= 0.) {
+    throw std::invalid_argument(
+        "estimateMemory error: provided non-positive event rate");
+  }
+  size_t statSizeL{statSize.load()};
+  double framerate{getFramerate()};
+  double simTime{static_cast<double>(nIters) / eventRate};
+  size_t nStats{nIters / statSizeL};
+  size_t chunkSize{statChunkSize.load() ? statChunkSize.load() : nStats};
+  size_t batches{statsWorkers + (withRenders ? renderWorkers : 0)};
+  auto bound{[this](PipelineQueue queue, size_t bytes, size_t itemBytes,
+                    size_t batchItems) {
+    QueueLimits const& limits{queueLimits[static_cast<size_t>(queue)]};
+    if (!limits.high) {
+      return bytes;
+    }
+    size_t limit{limits.inBytes ? limits.high + batchItems * itemBytes
+                                : (limits.high + batchItems) * itemBytes};
+    return bytes < limit ? bytes : limit;
+  }};
+  PipelineMemoryUsage usage{};
+
+  size_t keyframes{frameSnapshots.load()
+                       ? static_cast<size_t>(simTime * framerate) + 1
+                       : (nIters + statSizeL - 1) / statSizeL};
+  keyframes = keyframes < nIters ? keyframes : nIters;
+  size_t particlesBytes{keyframes * particlesN * sizeof(Particle)};
+  size_t rawBytes{nIters * sizeof(GasData) + particlesBytes};
+  size_t queuedBytes{bound(PipelineQueue::rawData, rawBytes,
+                           nIters ? rawBytes / nIters : 0, statSizeL)};
+  // the records are held by the ring slots, the queued ones adding the
+  // particles of their keyframes
+  double queued{rawBytes ? static_cast<double>(queuedBytes) /
+                               static_cast<double>(rawBytes)
+                         : 0.};
+  if (nIters > ring->capacity()) {
+    double ringShare{static_cast<double>(ring->capacity()) /
+                     static_cast<double>(nIters)};
+    queued = queued < ringShare ? queued : ringShare;
+  }
+  usage.rawData =
+      ring->memoryUsage() +
+      static_cast<size_t>(queued * static_cast<double>(particlesBytes));
+
+  size_t statBytes{sizeof(TdStats) - sizeof(FixedHistogram) +
+                   FixedHistogram{speedsHTemplate}.memoryUsage() +
+                   CollisionTracker::memoryUsage(particlesN)};
+  usage.stats = bound(PipelineQueue::stats, nStats * statBytes, statBytes,
+                      batches * chunkSize);
+
+  if (withRenders) {
+    size_t frames{static_cast<size_t>(simTime * framerate) + 1};
+    size_t frameBytes{sizeof(std::pair<Render, double>) +
+                      size_t{resolution.x} * resolution.y * 4};
+    size_t batchFrames{static_cast<size_t>(
+                           static_cast<double>(chunkSize * statSizeL) /
+                           eventRate * framerate) +
+                       1};
+    usage.renders = bound(PipelineQueue::renders, frames * frameBytes,
+                          frameBytes, batches * batchFrames);
+  }
+  usage.states = statesBytes(particlesN, withRenders);
+  return usage;
 }
 
 size_t SimDataPipeline::getNStats() {
@@ -311,6 +906,7 @@ std::vector<TdStats> SimDataPipeline::getStats(bool emptyQueue) {
         stats.clear();
       }
     }  // lock scope end
+    outputSpaceCv.notify_all();
     return std::vector<TdStats>(std::make_move_iterator(tempStats.begin()),
                                 std::make_move_iterator(tempStats.end()));
   } else {
@@ -324,9 +920,9 @@ size_t SimDataPipeline::getNRenders() {
   return renders.size();
 }
 
-std::vector<sf::Texture> SimDataPipeline::getRenders(bool emptyQueue) {
+std::vector<Render> SimDataPipeline::getRenders(bool emptyQueue) {
   sf::Context c;
-  std::vector<sf::Texture> tempRenders{};
+  std::vector<Render> tempRenders{};
   if (emptyQueue) {
     std::lock_guard<std::mutex> rendersGuard{rendersMtx};
     tempRenders.reserve(renders.size());
@@ -334,6 +930,7 @@ std::vector<sf::Texture> SimDataPipeline::getRenders(bool emptyQueue) {
       tempRenders.emplace_back(std::move(r.first));
     }
     renders.clear();
+    outputSpaceCv.notify_all();
   } else {
     std::lock_guard<std::mutex> rendersGuard{rendersMtx};
     tempRenders.reserve(renders.size());
@@ -353,6 +950,11 @@ void SimDataPipeline::setStatChunkSize(size_t s) {
   }
 }
 
+std::optional<double> SimDataPipeline::getGTime() {
+  std::lock_guard<std::mutex> gTimeGuard{gTimeMtx};
+  return gTime;
+}
+
 void SimDataPipeline::setFramerate(double framerate) {
   if (framerate <= 0) {
     throw std::invalid_argument(
@@ -363,10 +965,88 @@ void SimDataPipeline::setFramerate(double framerate) {
 }
 
 void SimDataPipeline::setStatSize(size_t s) {
-  if (s) {
+  if (!s) {
+    throw(std::invalid_argument("setStatSize error: provided null stat size"));
+  } else if (s > ring->capacity()) {
+    throw std::invalid_argument(
+        "setStatSize error: provided stat size larger than the raw data ring "
+        "capacity");
+  } else {
     statSize.store(s);
+  }
+}
+
+void SimDataPipeline::setRingCapacity(size_t capacity) {
+  if (keyframeAdded) {
+    throw std::logic_error(
+        "setRingCapacity error: called after data was added");
+  } else if (capacity < statSize.load()) {
+    throw std::invalid_argument(
+        "setRingCapacity error: provided capacity smaller than the stat size");
   } else {
-    throw(std::invalid_argument("setStatSize error: provided null stat size"));
+    ring = std::make_unique<EventRing>(capacity);
+  }
+}
+
+void SimDataPipeline::setCheckpoints(std::string const& path,
+                                     double interval) {
+  if (path.empty()) {
+    throw std::invalid_argument("setCheckpoints error: provided empty path");
+  } else if (interval < 0.) {
+    throw std::invalid_argument(
+        "setCheckpoints error: provided negative interval");
+  } else {
+    checkpointPath = path;
+    checkpointInterval = interval;
+  }
+}
+
+void SimDataPipeline::resume(Checkpoint const& c) {
+  if (nParticles.has_value() || processedEvents) {
+    throw std::logic_error(
+        "SDP resume error: called after data was added or on a resumed "
+        "pipeline");
+  }
+  if (c.particles.empty()) {
+    throw std::invalid_argument(
+        "SDP resume error: provided checkpoint with no particles");
+  }
+  nParticles = c.particles.size();
+  processedEvents = c.events;
+  rawDataBackTime = c.time;
+  lastCheckpointTime = c.time;
+  if (c.lastStat.has_value()) {
+    lastStat = TdStats{*c.lastStat, speedsHTemplate};
+  }
+  gTime = c.gTime;
+  fTime = c.fTime;
+  shownFTime = c.fTime;
+}
+
+void SimDataPipeline::setQueueLimits(PipelineQueue queue,
+                                     QueueLimits const& limits) {
+  if (static_cast<size_t>(queue) >= queueLimits.size()) {
+    throw std::invalid_argument(
+        "setQueueLimits error: invalid queue provided");
+  } else if (limits.low > limits.high) {
+    throw std::invalid_argument(
+        "setQueueLimits error: provided low watermark above the high one");
+  } else if (queue == PipelineQueue::rawData &&
+             limits.policy != QueuePolicy::block) {
+    throw std::invalid_argument(
+        "setQueueLimits error: raw data can only block");
+  } else {
+    queueLimits[static_cast<size_t>(queue)] = limits;
+  }
+}
+
+void SimDataPipeline::setWorkers(size_t statsWorkersN,
+                                 size_t renderWorkersN) {
+  if (!statsWorkersN || !renderWorkersN) {
+    throw std::invalid_argument("setWorkers error: provided null workers");
+  } else {
+    statsWorkers = statsWorkersN;
+    renderWorkers = renderWorkersN;
   }
 }
 
@@ -3,12 +3,17 @@
 
 #include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstddef>
+#include <cstdint>
 #include <deque>
 #include <functional>
+#include <future>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -18,24 +23,69 @@
 
 #include <TH1.h>
 
+#include <tbb/enumerable_thread_specific.h>
+
+#include "DataProcessing/Checkpoint.hpp"
+#include "DataProcessing/CollisionTracker.hpp"
+#include "DataProcessing/EventRing.hpp"
 #include "DataProcessing/GasData.hpp"
+#include "DataProcessing/GasState.hpp"
+#include "Graphics/Camera.hpp"
+#include "Graphics/Render.hpp"
 #include "Graphics/RenderStyle.hpp"
+#include "PhysicsEngine/GSVector.hpp"
 #include "TdStats.hpp"
 
 class TList;
 
 namespace GS {
 
-class Camera;
-
 enum class VideoOpts { justGas, justStats, gasPlusCoords, all };
+// what draws the gas frames: sfml on the gpu, or the tiled cpu rasterizer for
+// machines without a usable opengl context
+enum class RenderBackend { sfml, cpu };
+
+enum class PipelineQueue { rawData, stats, renders };
+// what happens to a queue past its high watermark, until it gets back to the
+// low one: its producer waits, or its oldest items are thrown away
+enum class QueuePolicy { block, dropOldest };
+
+struct QueueLimits {
+  size_t high{0};  // 0 for an unbounded queue
+  size_t low{0};
+  bool inBytes{false};  // items otherwise
+  QueuePolicy policy{QueuePolicy::block};
+};
+
+struct QueueStatus {
+  size_t items{0};
+  size_t bytes{0};  // estimated
+  size_t dropped{0};
+  double blockedTime{0.};  // seconds the producer waited for the consumers
+};
+
+// bytes held by a pipeline, renders counted as uncompressed rgba textures,
+// mostly living in gpu memory
+struct PipelineMemoryUsage {
+  size_t rawData{0};  // the raw data ring and the queued keyframes particles
+  size_t stats{0};
+  size_t renders{0};
+  size_t states{0};  // gas states and collision tracker, from their sizes
+  size_t total() const { return rawData + stats + renders + states; }
+};
 
 class SimDataPipeline {
  public:
   SimDataPipeline(size_t statSize, double framerate,
                   TH1D const& speedsHTemplate);
 
+  // the records are moved out of data, which is left empty with its buffer
+  // for the caller to reuse
+  // a single thread at a time can add data
   void addData(std::vector<GasData>&& data);
+  // the calling thread takes the batches of raw data and hands them to the
+  // stats and render workers, their results are published in batch order
+  // a single thread at a time can process data
   // just stats overload
   void processData(
       bool mfpMemory = true,
@@ -50,61 +100,185 @@ class SimDataPipeline {
       std::function<void(TH1D&, VideoOpts)> fitLambda = {},
       std::array<std::function<void()>, 4> drawLambdas = {});
 
+  // returns once batches were published since the previous call, after
+  // processing stopped or after timeout, whether there are new results
+  // a single thread at a time can wait
+  bool waitForResults(std::chrono::milliseconds timeout);
+
   size_t getRawDataSize();
   size_t getNStats();
   std::vector<TdStats> getStats(bool clearMem = false);
   size_t getNRenders();
-  std::vector<sf::Texture> getRenders(bool clearMem = false);
+  // the cpu backend ones still as pixels, see Render
+  std::vector<Render> getRenders(bool clearMem = false);
   bool isProcessing() { return processing.load(); }
   bool isDone() { return doneAddingData.load(); }
-  void setDone() { doneAddingData.store(true); }
+  void setDone() {
+    doneAddingData.store(true);
+    ring->wake();
+  }
 
   void setStatChunkSize(size_t statChunkSize);
   size_t getStatChunkSize() const { return statChunkSize.load(); }
   void setFramerate(double framerate);
   double getFramerate() const { return 1. / gDeltaT.load(); }
+  // time of the last published render, the frames following it every
+  // 1 / framerate, unset until the first batch is processed or resumed
+  std::optional<double> getGTime();
+  // makes the simulation add full snapshots only for the events frames are
+  // drawn from instead of at the start of every batch, so that their memory
+  // follows the framerate instead of the event count
+  void setFrameSnapshots(bool onFrames) { frameSnapshots.store(onFrames); }
+  bool getFrameSnapshots() const { return frameSnapshots.load(); }
   size_t getStatSize() const { return statSize.load(); }
+  // can't exceed the raw data ring capacity
   void setStatSize(size_t size);
+  size_t getRingCapacity() const { return ring->capacity(); }
+  // slots of the raw data ring, rounded up to a power of two, by default the
+  // larger of 4096 and four times the starting stat size
+  // to be called before any data is added
+  void setRingCapacity(size_t capacity);  // non thread-safe
+  // threads computing the stats and drawing the renders of the batches, at
+  // most their sum of batches being processed at once
+  void setWorkers(size_t statsWorkers,
+                  size_t renderWorkers);  // non thread-safe
+  size_t getStatsWorkers() const { return statsWorkers; }
+  size_t getRenderWorkers() const { return renderWorkers; }
+  void setRenderBackend(RenderBackend backend) {  // non thread-safe
+    renderBackend = backend;
+  }
+  RenderBackend getRenderBackend() const { return renderBackend; }
   void setFont(sf::Font const& font);  // non thread-safe
+  // the processing thread writes a checkpoint to path at the end of the
+  // first processed stat after each interval of simulated time, and one when
+  // processing stops, without waiting for the writes to complete
+  void setCheckpoints(std::string const& path,
+                      double interval);  // non thread-safe
+  // continues the stats, renders and frames of a checkpointed run, to be
+  // called before any data is added
+  void resume(Checkpoint const& checkpoint);  // non thread-safe
+  // raw data can only block, its records depending on the previous ones
+  // addData blocks on a full raw data queue, processData waits for room in
+  // the stats and renders queues before processing each batch
+  void setQueueLimits(PipelineQueue queue,
+                      QueueLimits const& limits);  // non thread-safe
+  QueueLimits getQueueLimits(PipelineQueue queue) const {
+    return queueLimits[static_cast<size_t>(queue)];
+  }
+  QueueStatus getQueueStatus(PipelineQueue queue);
+
+  PipelineMemoryUsage memoryUsage();
+  // peak usage of a run of nIters events of particlesN particles, eventRate
+  // being the expected events per simulated second, when nothing empties the
+  // queues but their watermarks, with the current settings
+  PipelineMemoryUsage estimateMemory(size_t particlesN, size_t nIters,
+                                     double eventRate,
+                                     sf::Vector2u resolution,
+                                     bool withRenders) const;
 
  private:
-  void processStats(std::vector<GasData> const& data, bool mfpMemory,
-                    size_t statSizeL, std::vector<TdStats>& tempResults);
-  void processGraphics(
-      std::vector<GasData> const& data, Camera const& camera,
-      RenderStyle const& style,
-      std::vector<std::pair<sf::Texture, double>>& tempRenders);
+  // raw data taken by the processing thread along with what it found
+  // following it in order, so that the workers can process it on their own
+  struct Batch {
+    std::vector<GasData> data{};
+    size_t statSize{0};
+    // state after the first event of each stat and the stat it continues
+    std::vector<GasState> firstStates{};
+    std::vector<std::optional<TdStats>> prevStats{};
+    // for checkpoints
+    std::optional<GasState> endState{};
+    std::vector<GSVectorD> endPositions{};
+    std::optional<GasState> graphicsStart{};
+    double gTime{0.};  // last frame before the batch
+    double gDeltaT{0.};
+    std::vector<TdStats> stats{};
+    std::vector<std::pair<Render, double>> renders{};
+    bool statsDone{false};
+    bool rendersDone{false};
+  };
+
+  void process(bool mfpMemory, std::function<bool()> const& stopper,
+               Camera const* camera, RenderStyle const* style);
+  void prepareStats(Batch& batch, bool mfpMemory,
+                    std::optional<TdStats>& chain);
+  void processStats(Batch& batch);
+  void prepareGraphics(Batch& batch, std::optional<double>& renderTime);
+  void processGraphics(Batch& batch, Camera const& camera,
+                       RenderStyle const& style);
+  void publish(Batch& batch, bool withRenders);
+  void checkpoint(Batch const& batch);
+  void finishCheckpoints();
+  void writeLastSnapshot(GasState const& state,
+                         std::vector<GSVectorD> const& positions);
+  bool takeData(std::vector<GasData>& data, size_t& statSizeL,
+                std::function<bool()> const& stopper);
+  size_t queueFill(PipelineQueue queue, bool inBytes);  // locks the queue
+  bool outputsFull(bool withRenders, bool waiting);
+  bool waitForOutputs(bool withRenders, std::function<bool()> const& stopper);
 
   std::atomic<bool> doneAddingData{false};
   std::atomic<bool> processing{false};
   std::atomic<bool> addedResults{false};
-  std::deque<GasData> rawData{};
-  std::mutex rawDataMtx;
-  std::condition_variable rawDataCv;
-  std::optional<double> rawDataBackTime{};
+  std::unique_ptr<EventRing> ring;  // filled by addData only
+  std::mutex rawDataMtx;               // nParticles
+  std::optional<double> rawDataBackTime{};  // only used by addData
+  std::atomic<size_t> rawDataBytes{0};
+  std::atomic<size_t> keyframeBytes{0};  // queued keyframes particles
+  std::atomic<bool> stoppedProcessing{false};
+  std::atomic<bool> rendering{false};  // set by the renders overload
 
   std::atomic<size_t> statSize;
-  std::atomic<size_t> statChunkSize;
+  std::atomic<size_t> statChunkSize{0};
+  size_t statsWorkers{1};
+  size_t renderWorkers{1};
+  RenderBackend renderBackend{RenderBackend::sfml};
   std::deque<TdStats> stats{};
   std::mutex statsMtx;
   std::optional<TdStats> lastStat;
   std::mutex lastStatMtx;
 
   std::atomic<double> gDeltaT;  // last render time
+  std::atomic<bool> frameSnapshots{false};
   std::optional<double> gTime;  // time of last published render
   std::mutex gTimeMtx;
-  std::deque<std::pair<sf::Texture, double>> renders;
+  std::deque<std::pair<Render, double>> renders;
   std::mutex rendersMtx;
+  // kept by each thread drawing frames
+  tbb::enumerable_thread_specific<RenderTargets> renderTargets{};
 
   std::mutex outputMtx;
   std::condition_variable outputCv;
+  std::condition_variable outputSpaceCv;  // uses outputMtx
+  size_t publishedBatches{0};             // guarded by outputMtx
+  size_t waitedBatches{0};                // only used by waitForResults
+
+  std::array<QueueLimits, 3> queueLimits{};
+  std::array<std::atomic<size_t>, 3> droppedItems{};
+  std::array<std::atomic<int64_t>, 3> blockedNs{};
 
   std::optional<double> fTime;  // time of last published frame
+  // fTime as left by the last getVideo call, for the checkpoints
+  std::optional<double> shownFTime;
+  std::mutex fTimeMtx;
 
   std::optional<size_t> nParticles;
+  bool keyframeAdded{false};
 
   const TH1D speedsHTemplate;
   sf::Font font;
+
+  // only used by the processing thread, the checkpoint members by the
+  // thread publishing the batches
+  std::optional<GasState> statsState{};
+  // reused by the chains built from scratch, never by published stats
+  std::shared_ptr<CollisionTracker> statsTracker{
+      std::make_shared<CollisionTracker>()};
+  std::optional<GasState> graphicsState{};
+  std::string checkpointPath{};
+  double checkpointInterval{0.};
+  size_t processedEvents{0};
+  std::optional<double> lastCheckpointTime{};
+  std::future<void> checkpointWrite{};
 };
 
 }  // namespace GS
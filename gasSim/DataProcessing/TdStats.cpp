@@ -1,28 +1,43 @@
 #include "TdStats.hpp"
 
-#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cmath>
+#include <memory>
 #include <numeric>
 #include <stdexcept>
+#include <string>
 #include <utility>
 #include <vector>
 
-#include "DataProcessing/GasData.hpp"
+#include "DataProcessing/CollisionTracker.hpp"
+#include "DataProcessing/GasState.hpp"
 #include "PhysicsEngine/Collision.hpp"
 #include "PhysicsEngine/Particle.hpp"
 
 namespace GS {
 
+// from the energy tracked by the state, O(1)
+double temperature(GasState const& state, double mass) {
+  return state.getEnergy(mass) * 2. /
+         static_cast<double>(state.getNParticles()) / 3.;
+}
+
+// the template is copied once, then shared by the chained stats
+std::shared_ptr<TH1D const> makeSpeedsH(TH1D const& speedsHTemplate) {
+  auto speedsH{std::make_shared<TH1D>(speedsHTemplate)};
+  speedsH->SetDirectory(nullptr);
+  return speedsH;
+}
+
 // Constructors
-TdStats::TdStats(GasData const& firstState, TH1D const& speedsHTemplate)
-    : wallPulses{},
-      lastCollPositions(std::vector<GSVectorD>(firstState.getParticles().size(),
-                                               {0., 0., 0.})),
-      T{std::accumulate(
-            firstState.getParticles().begin(), firstState.getParticles().end(),
-            0., [](double x, Particle const& p) { return x + energy(p); }) *
-        2. / static_cast<double>(getNParticles()) / 3.},
-      freePaths{},
+TdStats::TdStats(GasState const& firstState, TH1D const& speedsHTemplate,
+                 std::shared_ptr<CollisionTracker> sharedTracker)
+    : mass{firstState.getMass()},
+      wallPulses{},
+      tracker{std::move(sharedTracker)},
+      nParticles{firstState.getNParticles()},
+      T{temperature(firstState, mass)},
       t0(firstState.getT0()),
       time(firstState.getTime()),
       boxSide(firstState.getBoxSide()) {
@@ -30,34 +45,35 @@ TdStats::TdStats(GasData const& firstState, TH1D const& speedsHTemplate)
     throw std::invalid_argument(
         "TdStats constructor error: non-empty speedsH template provided");
   }
-  speedsH = speedsHTemplate;
-  speedsH.SetDirectory(nullptr);
+  speedsH = makeSpeedsH(speedsHTemplate);
+  speedsHist = FixedHistogram{speedsHTemplate};
+  if (tracker) {
+    tracker->reset(firstState);
+  } else {
+    tracker = std::make_shared<CollisionTracker>(firstState);
+  }
+  checkEnergy(firstState, "TdStats constructor error");
   if (firstState.getCollType() == 'w') {
     addPulse(firstState);
-  } else if (firstState.getCollType() == 'p') {
-    lastCollPositions[firstState.getP2Index()] = firstState.getP2().position;
   }
-  lastCollPositions[firstState.getP1Index()] = firstState.getP1().position;
-  std::for_each(firstState.getParticles().begin(),
-                firstState.getParticles().end(),
-                [this](Particle const& p) { speedsH.Fill(p.speed.norm()); });
+  addCollisions(firstState);
+  speedsHist.setValues(tracker->getSpeeds());
+  speedsHist.fill();
 }
 
 bool isNegligible(double epsilon, double x) {
   return std::fabs(epsilon / x) < 1E-6;
 }
 
-TdStats::TdStats(GasData const& data, TdStats&& prevStats)
-    : wallPulses{},
-      T{std::accumulate(
-            data.getParticles().begin(), data.getParticles().end(), 0.,
-            [](double x, Particle const& p) { return x + energy(p); }) *
-        2. / static_cast<double>(data.getParticles().size()) / 3.},
-      freePaths{},
+TdStats::TdStats(GasState const& data, TdStats&& prevStats)
+    : mass{prevStats.mass},
+      wallPulses{},
+      nParticles{prevStats.nParticles},
+      T{temperature(data, mass)},
       t0{data.getT0()},
       time{data.getTime()},
       boxSide{data.getBoxSide()} {
-  if (data.getParticles().size() != prevStats.getNParticles()) {
+  if (data.getNParticles() != prevStats.getNParticles()) {
     throw std::invalid_argument(
         "TdStats constructor error: provided data with non-matching particle "
         "number");
@@ -74,50 +90,30 @@ TdStats::TdStats(GasData const& data, TdStats&& prevStats)
         "TdStats constructor error: provided gas and stats with non-matching "
         "temperatures");
   } else {
-    prevStats.speedsH.Reset("ICES");
+    nEvents = prevStats.nEvents;
+    checkEnergy(data, "TdStats constructor error");
     speedsH = prevStats.speedsH;
-    speedsH.SetDirectory(nullptr);
-    lastCollPositions = std::move(prevStats.lastCollPositions);
+    tracker = prevStats.tracker;
+    speedsHist = prevStats.speedsHist;
 
     if (data.getCollType() == 'w') {
       addPulse(data);
-      if (lastCollPositions[data.getP1Index()] != GSVectorD({0., 0., 0.})) {
-        freePaths.emplace_back(
-            (data.getP1().position - lastCollPositions[data.getP1Index()])
-                .norm());
-      }
-    } else if (data.getCollType() == 'p') {
-      if (lastCollPositions[data.getP1Index()] != GSVectorD({0., 0., 0.})) {
-        freePaths.emplace_back(
-            (data.getP1().position - lastCollPositions[data.getP1Index()])
-                .norm());
-      }
-      if (lastCollPositions[data.getP2Index()] != GSVectorD({0., 0., 0.})) {
-        freePaths.emplace_back(
-            (data.getP2().position - lastCollPositions[data.getP2Index()])
-                .norm());
-      }
-      lastCollPositions[data.getP2Index()] = data.getP2().position;
     }
-    lastCollPositions[data.getP1Index()] = data.getP1().position;
-
-    std::for_each(data.getParticles().begin(), data.getParticles().end(),
-                  [this](Particle const& p) { speedsH.Fill(p.speed.norm()); });
+    chainSpeeds(data, true);
+    addCollisions(data);
   }
 }
 
-TdStats::TdStats(GasData const& data, TdStats&& prevStats,
+TdStats::TdStats(GasState const& data, TdStats&& prevStats,
                  TH1D const& speedsHTemplate)
-    : wallPulses{},
-      T{std::accumulate(
-            data.getParticles().begin(), data.getParticles().end(), 0.,
-            [](double x, Particle const& p) { return x + energy(p); }) *
-        2. / static_cast<double>(data.getParticles().size()) / 3.},
-      freePaths{},
+    : mass{prevStats.mass},
+      wallPulses{},
+      nParticles{prevStats.nParticles},
+      T{temperature(data, mass)},
       t0(data.getT0()),
       time(data.getTime()),
       boxSide(data.getBoxSide()) {
-  if (data.getParticles().size() != prevStats.getNParticles()) {
+  if (data.getNParticles() != prevStats.getNParticles()) {
     throw std::invalid_argument(
         "TdStats constructor error: provided data with different particle "
         "number");
@@ -134,121 +130,137 @@ TdStats::TdStats(GasData const& data, TdStats&& prevStats,
         "TdStats constructor error: provided gas and stats with non-matching "
         "temperatures");
   } else {
+    nEvents = prevStats.nEvents;
+    checkEnergy(data, "TdStats constructor error");
+    bool sameBinning{true};
     {
       TH1D* defH = new TH1D();
       defH->SetDirectory(nullptr);
       if (speedsHTemplate.IsEqual(defH)) {
-        prevStats.speedsH.Reset("ICES");
         speedsH = prevStats.speedsH;
-        speedsH.SetDirectory(nullptr);
       } else {
         if (speedsHTemplate.GetEntries() != 0.) {
           delete defH;
           throw std::runtime_error(
               "TdStats constructor error: provided non-empty speedsH template");
         } else {
-          speedsH = speedsHTemplate;
-          speedsH.SetDirectory(nullptr);
+          speedsH = makeSpeedsH(speedsHTemplate);
+          sameBinning = false;
         }
       }
       delete defH;
     }
 
-    lastCollPositions = std::move(prevStats.lastCollPositions);
+    tracker = prevStats.tracker;
     T = prevStats.T;
+    speedsHist = sameBinning ? prevStats.speedsHist
+                             : FixedHistogram{speedsHTemplate};
 
     if (data.getCollType() == 'w') {
       addPulse(data);
-      if (lastCollPositions[data.getP1Index()] != GSVectorD({0., 0., 0.})) {
-        freePaths.emplace_back(
-            (data.getP1().position - lastCollPositions[data.getP1Index()])
-                .norm());
-      }
-    } else if (data.getCollType() == 'p') {
-      if (lastCollPositions[data.getP1Index()] != GSVectorD({0., 0., 0.})) {
-        freePaths.emplace_back(
-            (data.getP1().position - lastCollPositions[data.getP1Index()])
-                .norm());
-      }
-      if (lastCollPositions[data.getP2Index()] != GSVectorD({0., 0., 0.})) {
-        freePaths.emplace_back(
-            (data.getP2().position - lastCollPositions[data.getP2Index()])
-                .norm());
-      }
-      lastCollPositions[data.getP2Index()] = data.getP2().position;
     }
-    lastCollPositions[data.getP1Index()] = data.getP1().position;
+    chainSpeeds(data, sameBinning);
+    addCollisions(data);
+  }
+}
 
-    std::for_each(data.getParticles().begin(), data.getParticles().end(),
-                  [this](Particle const& p) { speedsH.Fill(p.speed.norm()); });
+TdStats::TdStats(Memory memory, TH1D const& speedsHTemplate)
+    : wallPulses{},
+      tracker{std::make_shared<CollisionTracker>(
+          std::move(memory.lastCollPositions))},
+      nParticles{tracker->getNParticles()},
+      T{memory.T},
+      t0{memory.time},
+      time{memory.time},
+      boxSide{memory.boxSide} {
+  if (speedsHTemplate.GetEntries() != 0.) {
+    throw std::invalid_argument(
+        "TdStats constructor error: non-empty speedsH template provided");
+  }
+  if (!getNParticles() || boxSide <= 0. || T < 0.) {
+    throw std::invalid_argument(
+        "TdStats constructor error: provided invalid stats memory");
   }
+  speedsH = makeSpeedsH(speedsHTemplate);
+  speedsHist = FixedHistogram{speedsHTemplate};
 }
 
 TdStats::TdStats(TdStats const& s)
-    : wallPulses(s.wallPulses),
-      lastCollPositions(s.lastCollPositions),
+    : mass(s.mass),
+      wallPulses(s.wallPulses),
+      tracker(s.tracker),
+      nParticles(s.nParticles),
       T(s.T),
-      freePaths(s.freePaths),
+      freePathsSum(s.freePathsSum),
+      nFreePaths(s.nFreePaths),
       speedsH(s.speedsH),
+      speedsHist(s.speedsHist),
       t0(s.t0),
       time(s.time),
-      boxSide(s.boxSide) {
-  speedsH.SetDirectory(nullptr);
-}
+      boxSide(s.boxSide),
+      nEvents(s.nEvents) {}
 
 TdStats::TdStats(TdStats&& s) noexcept
-    : wallPulses(std::move(s.wallPulses)),
-      lastCollPositions(std::move(s.lastCollPositions)),
+    : mass(s.mass),
+      wallPulses(std::move(s.wallPulses)),
+      tracker(std::move(s.tracker)),
+      nParticles(s.nParticles),
       T(s.T),
-      freePaths(std::move(s.freePaths)),
-      speedsH(s.speedsH),
+      freePathsSum(s.freePathsSum),
+      nFreePaths(s.nFreePaths),
+      speedsH(std::move(s.speedsH)),
+      speedsHist(std::move(s.speedsHist)),
       t0(s.t0),
       time(s.time),
-      boxSide(s.boxSide) {
-  speedsH.SetDirectory(nullptr);
-}
+      boxSide(s.boxSide),
+      nEvents(s.nEvents) {}
 
 TdStats& TdStats::operator=(TdStats const& s) {
   if (this == &s) {
     return *this;
   }
+  mass = s.mass;
   wallPulses = s.wallPulses;
-  lastCollPositions = s.lastCollPositions;
+  tracker = s.tracker;
+  nParticles = s.nParticles;
   T = s.T;
-  freePaths = s.freePaths;
+  freePathsSum = s.freePathsSum;
+  nFreePaths = s.nFreePaths;
   speedsH = s.speedsH;
-  speedsH.SetDirectory(nullptr);
+  speedsHist = s.speedsHist;
   t0 = s.t0;
   time = s.time;
   boxSide = s.boxSide;
+  nEvents = s.nEvents;
   return *this;
 }
 
 TdStats& TdStats::operator=(TdStats&& s) noexcept {
+  mass = s.mass;
   wallPulses = std::move(s.wallPulses);
-  lastCollPositions = std::move(s.lastCollPositions);
+  tracker = std::move(s.tracker);
+  nParticles = s.nParticles;
   T = s.T;
-  freePaths = std::move(s.freePaths);
-  speedsH = s.speedsH;
-  speedsH.SetDirectory(nullptr);
+  freePathsSum = s.freePathsSum;
+  nFreePaths = s.nFreePaths;
+  speedsH = std::move(s.speedsH);
+  speedsHist = std::move(s.speedsHist);
   t0 = s.t0;
   time = s.time;
   boxSide = s.boxSide;
+  nEvents = s.nEvents;
   return *this;
 }
 
-void TdStats::addData(GasData const& data) {
-  double dataT{std::accumulate(
-                   data.getParticles().begin(), data.getParticles().end(), 0.,
-                   [](double x, Particle const& p) { return x + energy(p); }) *
-               2. / static_cast<double>(data.getParticles().size()) / 3.};
-  if (data.getParticles().size() != getNParticles()) {
+void TdStats::addData(GasState const& data) {
+  double dataT{temperature(data, mass)};
+  if (data.getNParticles() != getNParticles()) {
     throw std::invalid_argument(
         "TdStats addData error: non-matching gas particles number");
   } else if (!isNegligible(data.getT0() - time, time + data.getT0()) ||
              data.getTime() <= time) {
     throw std::invalid_argument(
-        "TdStats addData error: provided non-time contiguous GasData instance");
+        "TdStats addData error: provided non-time contiguous GasState");
   } else if (data.getBoxSide() != boxSide) {
     throw std::invalid_argument(
         "TdStats addData error: provided non-matching data box side");
@@ -256,59 +268,131 @@ void TdStats::addData(GasData const& data) {
     throw std::invalid_argument(
         "TdStats addData error: provided non-matching data temperature");
   } else {
+    checkEnergy(data, "TdStats addData error");
     time = data.getTime();
     if (data.getCollType() == 'w') {
       addPulse(data);
+    } else {
+      setSpeed(data.getP2Index(), data.getP2().speed.norm());
+    }
+    setSpeed(data.getP1Index(), data.getP1().speed.norm());
+    speedsHist.fill();
+    addCollisions(data);
+  }
+}
 
-      if (lastCollPositions[data.getP1Index()] != GSVectorD({0., 0., 0.})) {
-        freePaths.emplace_back(
-            (data.getP1().position - lastCollPositions[data.getP1Index()])
-                .norm());
-      }
+void TdStats::skipData(GasState const& data) {
+  if (data.getNParticles() != getNParticles()) {
+    throw std::invalid_argument(
+        "TdStats skipData error: non-matching gas particles number");
+  }
+  ++nEvents;
+  time = data.getTime();
+  if (data.getCollType() == 'p') {
+    setSpeed(data.getP2Index(), data.getP2().speed.norm());
+    tracker->addCollision(data.getP2Index(), data.getP2().position);
+  }
+  setSpeed(data.getP1Index(), data.getP1().speed.norm());
+  tracker->addCollision(data.getP1Index(), data.getP1().position);
+}
 
-      lastCollPositions[data.getP1Index()] = data.getP1().position;
+TdStats TdStats::detached() const {
+  TdStats s{*this};
+  s.tracker = std::make_shared<CollisionTracker>(*tracker);
+  return s;
+}
 
-    } else {
-      if (lastCollPositions[data.getP1Index()] != GSVectorD({0., 0., 0.})) {
-        freePaths.emplace_back(
-            (data.getP1().position - lastCollPositions[data.getP1Index()])
-                .norm());
-      }
-      if (lastCollPositions[data.getP2Index()] != GSVectorD({0., 0., 0.})) {
-        freePaths.emplace_back(
-            (data.getP2().position - lastCollPositions[data.getP2Index()])
-                .norm());
-      }
+// free paths and positions of the colliding particles
+void TdStats::addCollisions(GasState const& data) {
+  addFreePath(
+      tracker->addCollision(data.getP1Index(), data.getP1().position));
+  if (data.getCollType() == 'p') {
+    addFreePath(
+        tracker->addCollision(data.getP2Index(), data.getP2().position));
+  }
+}
+
+// negative free paths mark first collisions
+void TdStats::addFreePath(double freePath) {
+  if (freePath >= 0.) {
+    freePathsSum += freePath;
+    ++nFreePaths;
+  }
+}
+
+// counts the event, comparing every particle energy with the stats
+// temperature when a check is due
+void TdStats::checkEnergy(GasState const& data, char const* error) {
+  size_t interval{getEnergyCheckInterval()};
+  if (interval && !(nEvents % interval)) {
+    double exactT{std::accumulate(data.getParticles().begin(),
+                                  data.getParticles().end(), 0.,
+                                  [this](double x, Particle const& p) {
+                                    return x + energy(p, mass);
+                                  }) *
+                  2. / static_cast<double>(data.getNParticles()) / 3.};
+    if (!isNegligible(exactT - T, exactT + T)) {
+      throw std::invalid_argument(
+          std::string{error} +
+          ": particle energies don't match the stats temperature");
+    }
+  }
+  ++nEvents;
+}
+
+void TdStats::setSpeed(size_t index, double speed) {
+  speedsHist.moveValue(tracker->getSpeed(index), speed);
+  tracker->setSpeed(index, speed);
+}
 
-      lastCollPositions[data.getP1Index()] = data.getP1().position;
-      lastCollPositions[data.getP2Index()] = data.getP2().position;
+// continues the previous stats current speeds, or takes them from the state
+// when the tracker has none, e.g. when resuming
+void TdStats::chainSpeeds(GasState const& data, bool sameBinning) {
+  if (!tracker->hasSpeeds()) {
+    tracker->setSpeeds(data);
+    speedsHist.setValues(tracker->getSpeeds());
+  } else {
+    if (sameBinning) {
+      speedsHist.clearFills();
+    } else {
+      speedsHist.setValues(tracker->getSpeeds());
+    }
+    if (data.getCollType() == 'p') {
+      setSpeed(data.getP2Index(), data.getP2().speed.norm());
     }
-    std::for_each(data.getParticles().begin(), data.getParticles().end(),
-                  [this](Particle const& p) { speedsH.Fill(p.speed.norm()); });
+    setSpeed(data.getP1Index(), data.getP1().speed.norm());
   }
+  speedsHist.fill();
+}
+
+TH1D TdStats::getSpeedH() const {
+  TH1D h{*speedsH};
+  h.SetDirectory(nullptr);
+  speedsHist.writeTo(h);
+  return h;
 }
 
 // Auxiliary addPulse private function, assumes solved collision for input
-void TdStats::addPulse(GasData const& data) {
+void TdStats::addPulse(GasState const& data) {
   assert(data.getCollType() == 'w');
   switch (data.getWall()) {
     case Wall::Front:
-      wallPulses[0] += Particle::getMass() * 2. * data.getP1().speed.y;
+      wallPulses[0] += mass * 2. * data.getP1().speed.y;
       break;
     case Wall::Back:
-      wallPulses[1] -= Particle::getMass() * 2. * data.getP1().speed.y;
+      wallPulses[1] -= mass * 2. * data.getP1().speed.y;
       break;
     case Wall::Left:
-      wallPulses[2] += Particle::getMass() * 2. * data.getP1().speed.x;
+      wallPulses[2] += mass * 2. * data.getP1().speed.x;
       break;
     case Wall::Right:
-      wallPulses[3] -= Particle::getMass() * 2. * data.getP1().speed.x;
+      wallPulses[3] -= mass * 2. * data.getP1().speed.x;
       break;
     case Wall::Top:
-      wallPulses[4] -= Particle::getMass() * 2. * data.getP1().speed.z;
+      wallPulses[4] -= mass * 2. * data.getP1().speed.z;
       break;
     case Wall::Bottom:
-      wallPulses[5] += Particle::getMass() * 2. * data.getP1().speed.z;
+      wallPulses[5] += mass * 2. * data.getP1().speed.z;
       break;
     default:
       throw std::invalid_argument("addPulse error: VOID wall type provided");
@@ -329,19 +413,44 @@ double TdStats::getPressure() const {
 }
 
 double TdStats::getMeanFreePath() const {
-  if (freePaths.size() == 0) {
+  if (nFreePaths == 0) {
     return -1.;
   } else {
-    return std::accumulate(freePaths.begin(), freePaths.end(), 0.) /
-           static_cast<double>(freePaths.size());
+    return freePathsSum / static_cast<double>(nFreePaths);
+  }
+}
+
+TdStats merge(TdStats const& first, TdStats const& second) {
+  if (first.getNParticles() != second.getNParticles()) {
+    throw std::invalid_argument(
+        "TdStats merge error: provided stats with different particle number");
+  } else if (first.boxSide != second.boxSide) {
+    throw std::invalid_argument(
+        "TdStats merge error: provided stats with different box side");
+  } else if (!isNegligible(second.t0 - first.time, second.t0 + first.time) ||
+             second.time <= first.time) {
+    throw std::invalid_argument(
+        "TdStats merge error: provided non time-contiguous stats");
+  } else if (!isNegligible(second.T - first.T, second.T + first.T)) {
+    throw std::invalid_argument(
+        "TdStats merge error: provided stats with non-matching temperatures");
+  }
+  TdStats merged{second};
+  merged.t0 = first.t0;
+  for (size_t i{0}; i < merged.wallPulses.size(); ++i) {
+    merged.wallPulses[i] += first.wallPulses[i];
   }
+  merged.freePathsSum += first.freePathsSum;
+  merged.nFreePaths += first.nFreePaths;
+  merged.speedsHist.merge(first.speedsHist);
+  return merged;
 }
 
 bool TdStats::operator==(TdStats const& stats) const {
   return wallPulses == stats.wallPulses &&
-         lastCollPositions == stats.lastCollPositions &&
-         freePaths == stats.freePaths && t0 == stats.t0 && time == stats.time &&
-         T == stats.T;
+         freePathsSum == stats.freePathsSum &&
+         nFreePaths == stats.nFreePaths && t0 == stats.t0 &&
+         time == stats.time && T == stats.T;
 }
 
 }  // namespace GS
@@ -2,29 +2,48 @@
 #define TDSTATS_HPP
 
 #include <array>
+#include <atomic>
 #include <cmath>
 #include <cstddef>
+#include <memory>
 #include <vector>
 
 #include <TH1.h>
 
+#include "DataProcessing/CollisionTracker.hpp"
+#include "DataProcessing/FixedHistogram.hpp"
 #include "PhysicsEngine/GSVector.hpp"
+#include "PhysicsEngine/Particle.hpp"
 
 namespace GS {
 
-class GasData;
+class GasState;
 
 enum class Wall;
 
 class TdStats {
  public:
-  // construction from scratch of a TdStats
-  TdStats(GasData const& firstState, TH1D const& speedsHTemplate);
-  // to transfer previous collision positions information
-  TdStats(GasData const& data, TdStats&& prevStats);
+  // what a following TdStats takes from the previous one
+  struct Memory {
+    std::vector<GSVectorD> lastCollPositions{};
+    double T{0.};
+    double time{0.};
+    double boxSide{0.};
+  };
+
+  // the gas states are the ones right after each collision
+  // construction from scratch of a TdStats, a provided tracker is reset and
+  // used instead of a new one
+  TdStats(GasState const& firstState, TH1D const& speedsHTemplate,
+          std::shared_ptr<CollisionTracker> tracker = {});
+  // to continue the previous stats collision tracker, which is shared
+  TdStats(GasState const& data, TdStats&& prevStats);
   // to change the speedsHTemplate
-  TdStats(GasData const& data, TdStats&& prevStats,
+  TdStats(GasState const& data, TdStats&& prevStats,
           TH1D const& speedsHTemplate);
+  // stat with no data ending at memory.time, only meant to be used as
+  // prevStats, e.g. when resuming a run
+  TdStats(Memory memory, TH1D const& speedsHTemplate);
   ~TdStats() = default;
 
   TdStats(TdStats const& s);
@@ -32,37 +51,93 @@ class TdStats {
   TdStats(TdStats&& s) noexcept;
   TdStats& operator=(TdStats&&) noexcept;
 
-  void addData(GasData const& data);
+  void addData(GasState const& data);
+  // moves on to data without adding it to the stats: only the counted
+  // events, the collision positions and the current speeds follow it, the
+  // same way addData would
+  void skipData(GasState const& data);
+  // copy holding a copy of the collision tracker instead of sharing it, e.g.
+  // for a stat read by other threads while its chain goes on
+  TdStats detached() const;
 
   double getPressure(Wall wall) const;
   double getPressure() const;
   double getTemp() const { return T; }
-  size_t getNParticles() const { return lastCollPositions.size(); }
+  size_t getNParticles() const { return nParticles; }
   double getVolume() const { return std::pow(boxSide, 3); }
   double getBoxSide() const { return boxSide; }
   double getTime() const { return time; }
   double getTime0() const { return t0; }
   double getDeltaT() const { return time - t0; }
-  TH1D getSpeedH() const { return speedsH; }
+  // event weighted histogram of every particle speed, bin contents and
+  // entries match the ones of filling it at every event, the mean and RMS
+  // sums only up to rounding
+  TH1D getSpeedH() const;
   double getMeanFreePath() const;
+  size_t getNFreePaths() const { return nFreePaths; }
+  // the collision positions are the ones of the latest data added to the
+  // chain of stats sharing the tracker
+  Memory getMemory() const {
+    return {tracker->getLastCollPositions(), T, time, boxSide};
+  }
+
+  // bytes held by this stat, the empty histogram being shared by the chain
+  // while the collision tracker is counted in full, as for a detached stat
+  size_t memoryUsage() const {
+    return sizeof(*this) - sizeof(speedsHist) + speedsHist.memoryUsage() +
+           tracker->memoryUsage();
+  }
 
   bool operator==(TdStats const&) const;
+  // stats over both windows, the second one starting where the first ends,
+  // continuing the second one collision tracker
+  friend TdStats merge(TdStats const& first, TdStats const& second);
+
+  // the temperature is checked against the one tracked by the gas states at
+  // every event, and against every particle energy once every interval
+  // events, 0 meaning never
+  static size_t getEnergyCheckInterval() {
+    return energyCheckInterval.load();
+  }
+  static void setEnergyCheckInterval(size_t interval) {
+    energyCheckInterval.store(interval);
+  }
 
  private:
-  void addPulse(GasData const& data);
+  void addPulse(GasState const& data);
+  void addCollisions(GasState const& data);
+  void addFreePath(double freePath);
+  void checkEnergy(GasState const& data, char const* error);
+  void setSpeed(size_t index, double speed);
+  void chainSpeeds(GasState const& data, bool sameBinning);
+
+#ifdef NDEBUG
+  inline static std::atomic<size_t> energyCheckInterval{1024};
+#else
+  inline static std::atomic<size_t> energyCheckInterval{1};
+#endif
 
+  // the one of the first state, or read at construction from a memory
+  double mass{Particle::getMass()};
   std::array<double, 6> wallPulses{};  // cumulated pulse for each wall
 
-  std::vector<GSVectorD> lastCollPositions{};
+  std::shared_ptr<CollisionTracker> tracker{};
+  size_t nParticles;
   double T;  // would be invariant if not for fp approximation
-  std::vector<double> freePaths{};
-  TH1D speedsH;
+  double freePathsSum{0.};
+  size_t nFreePaths{0};
+  // empty, shared between copies, only converted to on demand
+  std::shared_ptr<TH1D const> speedsH{};
+  FixedHistogram speedsHist{};  // speeds of every particle at each event
 
   double t0;
   double time;  // time at latest collision whose data has been added
   double boxSide;
+  size_t nEvents{0};  // counted for the energy checks
 };
 
+TdStats merge(TdStats const& first, TdStats const& second);
+
 }  // namespace GS
 
 #endif
@@ -7,6 +7,8 @@
 #include <cstring>
 #include <execution>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include <SFML/Graphics/Color.hpp>
 #include <SFML/Graphics/ConvexShape.hpp>
@@ -18,8 +20,9 @@
 #include <SFML/Graphics/VertexArray.hpp>
 #include <SFML/System/Vector2.hpp>
 
-#include "DataProcessing/GasData.hpp"
+#include "DataProcessing/GasState.hpp"
 #include "Graphics/RenderStyle.hpp"
+#include "Graphics/SoftCanvas.hpp"
 #include "PhysicsEngine/Collision.hpp"
 #include "PhysicsEngine/GSVector.hpp"
 #include "PhysicsEngine/Gas.hpp"
@@ -102,7 +105,7 @@ inline void preCollSpeed(GSVectorD& v1, GSVectorD& v2, GSVectorD const& n) {
   v2 -= n * (n * (v2 - v10));
 }
 
-std::vector<GSVectorF> Camera::projectParticles(GasData const& data,
+std::vector<GSVectorF> Camera::projectParticles(GasState const& data,
                                                 double deltaT) const {
   std::vector<GSVectorF> projections{};
   GSVectorF proj{};
@@ -306,23 +309,54 @@ void Camera::computeCamBase() {
   cameraBase = {m, o};
 }
 
+// creates the target only if its size changed
+void fitTarget(sf::RenderTexture& target, Camera const& camera) {
+  if (target.getSize() != sf::Vector2u{camera.getWidth(), camera.getHeight()}) {
+    target.create(camera.getWidth(), camera.getHeight());
+  }
+}
+
+template <typename GasLike>
+void drawWalls(GasLike const& gas, Camera const& camera,
+               sf::RenderTexture& texture, RenderStyle const& style,
+               sf::RenderTexture& backWalls, sf::RenderTexture& frontWalls);
+
 template <typename GasLike>
 void drawGas(GasLike const& gasLike, Camera const& camera,
              sf::RenderTexture& picture, RenderStyle const& style,
              double deltaT) {
-  picture.create(camera.getWidth(), camera.getHeight());
+  fitTarget(picture, camera);
   picture.clear(sf::Color::Transparent);
   drawParticles(gasLike, camera, picture, style, deltaT);
   drawWalls(gasLike, camera, picture, style);
 }
 
+template <typename GasLike>
+void drawGas(GasLike const& gasLike, Camera const& camera,
+             RenderTargets& targets, RenderStyle const& style,
+             double deltaT) {
+  fitTarget(targets.picture, camera);
+  targets.picture.clear(sf::Color::Transparent);
+  drawParticles(gasLike, camera, targets.picture, style, deltaT);
+  drawWalls(gasLike, camera, targets.picture, style, targets.backWalls,
+            targets.frontWalls);
+}
+
 template void drawGas<Gas>(Gas const& gas, Camera const& camera,
                            sf::RenderTexture& picture, RenderStyle const& style,
                            double deltaT);
 
-template void drawGas<GasData>(GasData const& data, Camera const& camera,
-                               sf::RenderTexture& picture,
-                               RenderStyle const& style, double deltaT);
+template void drawGas<GasState>(GasState const& data, Camera const& camera,
+                                sf::RenderTexture& picture,
+                                RenderStyle const& style, double deltaT);
+
+template void drawGas<Gas>(Gas const& gas, Camera const& camera,
+                           RenderTargets& targets, RenderStyle const& style,
+                           double deltaT);
+
+template void drawGas<GasState>(GasState const& data, Camera const& camera,
+                                RenderTargets& targets,
+                                RenderStyle const& style, double deltaT);
 
 void drawParticles(Gas const& gas, Camera const& camera,
                    sf::RenderTexture& texture, RenderStyle const& style,
@@ -333,9 +367,10 @@ void drawParticles(Gas const& gas, Camera const& camera,
       camera.projectParticles(gas.getParticles(), deltaT);
   std::sort(std::execution::par, projections.begin(), projections.end(),
             [](GSVectorF const& a, GSVectorF const& b) { return a.z < b.z; });
+  float const pixRadius{
+      camera.getNPixels(static_cast<float>(gas.getRadius()))};
   for (GSVectorF const& proj : projections) {
-    float r{camera.getNPixels(static_cast<float>(Particle::getRadius())) *
-            proj.z};
+    float r{pixRadius * proj.z};
     sf::Vector2f vertexes[4]{{proj.x - r, proj.y + r},
                              {proj.x + r, proj.y + r},
                              {proj.x + r, proj.y - r},
@@ -351,7 +386,7 @@ void drawParticles(Gas const& gas, Camera const& camera,
   texture.draw(particles, &style.getPartTexture());
 }
 
-void drawParticles(GasData const& data, Camera const& camera,
+void drawParticles(GasState const& data, Camera const& camera,
                    sf::RenderTexture& texture, RenderStyle const& style,
                    double deltaT) {
   sf::VertexArray particles(sf::Quads, 4 * data.getParticles().size());
@@ -360,9 +395,10 @@ void drawParticles(GasData const& data, Camera const& camera,
   std::vector<GSVectorF> projections = camera.projectParticles(data, deltaT);
   std::sort(std::execution::par, projections.begin(), projections.end(),
             [](GSVectorF const& a, GSVectorF const& b) { return a.z < b.z; });
+  float const pixRadius{
+      camera.getNPixels(static_cast<float>(data.getRadius()))};
   for (GSVectorF const& proj : projections) {
-    float r{camera.getNPixels(static_cast<float>(Particle::getRadius())) *
-            proj.z};
+    float r{pixRadius * proj.z};
     sf::Vector2f vertexes[4]{{proj.x - r, proj.y + r},
                              {proj.x + r, proj.y + r},
                              {proj.x + r, proj.y - r},
@@ -418,12 +454,23 @@ std::array<GSVectorF, 6> gasWallData(GasLike const& gasLike, char wall) {
 }
 
 template std::array<GSVectorF, 6> gasWallData<Gas>(Gas const& gas, char wall);
-template std::array<GSVectorF, 6> gasWallData<GasData>(GasData const& gasData,
-                                                       char wall);
+template std::array<GSVectorF, 6> gasWallData<GasState>(
+    GasState const& gasData, char wall);
 
 template <typename GasLike>
 void drawWalls(GasLike const& gas, const Camera& camera,
                sf::RenderTexture& texture, RenderStyle const& style) {
+  sf::RenderTexture backWalls;
+  sf::RenderTexture frontWalls;
+  drawWalls(gas, camera, texture, style, backWalls, frontWalls);
+}
+
+// composes the walls projections around the particles drawn on texture,
+// through the two scratch targets
+template <typename GasLike>
+void drawWalls(GasLike const& gas, Camera const& camera,
+               sf::RenderTexture& texture, RenderStyle const& style,
+               sf::RenderTexture& backWalls, sf::RenderTexture& frontWalls) {
   std::array<GSVectorF, 6> wallData{};
   GSVectorF wallN{};
   GSVectorF wallCenter{};
@@ -466,11 +513,9 @@ void drawWalls(GasLike const& gas, const Camera& camera,
     }
   }
 
-  sf::RenderTexture backWalls;
-  backWalls.create(camera.getWidth(), camera.getHeight());
+  fitTarget(backWalls, camera);
   backWalls.clear(style.getBGColor());
-  sf::RenderTexture frontWalls;
-  frontWalls.create(camera.getWidth(), camera.getHeight());
+  fitTarget(frontWalls, camera);
   frontWalls.clear(sf::Color::Transparent);
   // draw walls projections
   for (sf::ConvexShape const& wallPrj : backWallPrjs) {
@@ -495,8 +540,87 @@ void drawWalls(GasLike const& gas, const Camera& camera,
   texture.draw(auxSprite);
 }
 
-template void drawWalls<GasData>(GasData const& data, Camera const& camera,
-                                 sf::RenderTexture& texture,
-                                 RenderStyle const& style);
+template void drawWalls<GasState>(GasState const& data, Camera const& camera,
+                                  sf::RenderTexture& texture,
+                                  RenderStyle const& style);
+
+// the pictures of the sfml backend come out with the projected y axis going
+// up, the canvas rows go down
+std::vector<SpriteQuad> spriteQuads(std::vector<GSVectorF>& projections,
+                                    float pixRadius, unsigned height) {
+  std::sort(std::execution::par, projections.begin(), projections.end(),
+            [](GSVectorF const& a, GSVectorF const& b) { return a.z < b.z; });
+  std::vector<SpriteQuad> quads{};
+  quads.reserve(projections.size());
+  for (GSVectorF const& proj : projections) {
+    quads.push_back(
+        {proj.x, static_cast<float>(height) - proj.y, pixRadius * proj.z});
+  }
+  return quads;
+}
+
+void drawParticles(Gas const& gas, Camera const& camera, SoftCanvas& canvas,
+                   RenderStyle const& style, double deltaT) {
+  std::vector<GSVectorF> projections{
+      camera.projectParticles(gas.getParticles(), deltaT)};
+  canvas.drawSprites(
+      style.getPartImage(),
+      spriteQuads(projections,
+                  camera.getNPixels(static_cast<float>(gas.getRadius())),
+                  camera.getHeight()));
+}
+
+void drawParticles(GasState const& data, Camera const& camera,
+                   SoftCanvas& canvas, RenderStyle const& style,
+                   double deltaT) {
+  std::vector<GSVectorF> projections{camera.projectParticles(data, deltaT)};
+  canvas.drawSprites(
+      style.getPartImage(),
+      spriteQuads(projections,
+                  camera.getNPixels(static_cast<float>(data.getRadius())),
+                  camera.getHeight()));
+}
+
+template <typename GasLike>
+void drawGas(GasLike const& gasLike, Camera const& camera, SoftCanvas& canvas,
+             RenderStyle const& style, double deltaT) {
+  canvas.create(camera.getWidth(), camera.getHeight());
+  canvas.clear(style.getBGColor());
+  float const height{static_cast<float>(camera.getHeight())};
+  // as in drawWalls, the walls facing the camera go over the particles
+  std::vector<std::vector<sf::Vector2f>> frontWalls{};
+  for (char wall : style.getWallsOpts()) {
+    std::array<GSVectorF, 6> wallData{gasWallData(gasLike, wall)};
+    std::vector<sf::Vector2f> wallProj{};
+    for (size_t i{0}; i < 4; ++i) {
+      GSVectorF proj{camera.getPointProjection(wallData[i])};
+      if (proj.z < 1.f && proj.z > 0.f) {
+        wallProj.emplace_back(proj.x, height - proj.y);
+      }
+    }
+    if (wallProj.size() < 3) {
+      continue;
+    }
+    if (wallData[4] * (wallData[5] - camera.getFocus()) < 0.f) {
+      frontWalls.emplace_back(std::move(wallProj));
+    } else {
+      canvas.fillPolygon(wallProj, style.getWallsColor(),
+                         style.getWOutlineColor(), 1.f);
+    }
+  }
+  drawParticles(gasLike, camera, canvas, style, deltaT);
+  for (std::vector<sf::Vector2f> const& wallProj : frontWalls) {
+    canvas.fillPolygon(wallProj, style.getWallsColor(),
+                       style.getWOutlineColor(), 1.f);
+  }
+}
+
+template void drawGas<Gas>(Gas const& gas, Camera const& camera,
+                           SoftCanvas& canvas, RenderStyle const& style,
+                           double deltaT);
+
+template void drawGas<GasState>(GasState const& data, Camera const& camera,
+                                SoftCanvas& canvas, RenderStyle const& style,
+                                double deltaT);
 
 }  // namespace GS
@@ -8,12 +8,17 @@
 
 #include "PhysicsEngine/GSVector.hpp"
 #include "RenderStyle.hpp"
+#include "SoftCanvas.hpp"
 
 namespace GS {
 
-class GasData;
-class Gas;
-struct Particle;
+class GasState;
+template <typename FP>
+class BasicGas;
+using Gas = BasicGas<double>;
+template <typename FP>
+struct BasicParticle;
+using Particle = BasicParticle<double>;
 
 class Camera {
  public:
@@ -25,7 +30,7 @@ class Camera {
   GSVectorF getPointProjection(GSVectorF const& point) const;
   std::vector<GSVectorF> projectParticles(
       std::vector<Particle> const& particles, double deltaT = 0.) const;
-  std::vector<GSVectorF> projectParticles(GasData const& data,
+  std::vector<GSVectorF> projectParticles(GasState const& data,
                                           double deltaT) const;
   // auxiliary member functions
   float getTopSide() const;
@@ -64,16 +69,30 @@ class Camera {
   unsigned height;
 };
 
+// what drawGas composes a frame on, kept between frames by a thread so that
+// the targets are only created again when the resolution changes
+struct RenderTargets {
+  sf::RenderTexture picture;
+  sf::RenderTexture backWalls;
+  sf::RenderTexture frontWalls;
+  SoftCanvas canvas;  // for the cpu backend
+};
+
 template <typename GasLike>
 void drawGas(GasLike const& gasLike, Camera const& camera,
              sf::RenderTexture& picture, RenderStyle const& style,
              double deltaT = 0.);
+// draws on targets.picture
+template <typename GasLike>
+void drawGas(GasLike const& gasLike, Camera const& camera,
+             RenderTargets& targets, RenderStyle const& style,
+             double deltaT = 0.);
 
 void drawParticles(Gas const& gas, Camera const& camera,
                    sf::RenderTexture& texture, RenderStyle const& style,
                    double deltaT = 0.);
 
-void drawParticles(GasData const& data, Camera const& camera,
+void drawParticles(GasState const& data, Camera const& camera,
                    sf::RenderTexture& texture, RenderStyle const& style,
                    double deltaT = 0.);
 
@@ -81,6 +100,19 @@ template <typename GasLike>
 void drawWalls(GasLike const& gas, Camera const& camera,
                sf::RenderTexture& texture, RenderStyle const& style);
 
+// cpu backend, drawing the picture of the sfml one in memory, canvas being
+// resized to the camera resolution
+template <typename GasLike>
+void drawGas(GasLike const& gasLike, Camera const& camera, SoftCanvas& canvas,
+             RenderStyle const& style, double deltaT = 0.);
+
+void drawParticles(Gas const& gas, Camera const& camera, SoftCanvas& canvas,
+                   RenderStyle const& style, double deltaT = 0.);
+
+void drawParticles(GasState const& data, Camera const& camera,
+                   SoftCanvas& canvas, RenderStyle const& style,
+                   double deltaT = 0.);
+
 }  // namespace GS
 
 #endif
@@ -0,0 +1,30 @@
+#include "Render.hpp"
+
+#include <stdexcept>
+
+#include <SFML/Config.hpp>
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/System/Vector2.hpp>
+
+namespace GS {
+
+Render::Render(sf::Vector2u size, sf::Uint8 const* pixels) {
+  image.create(size.x, size.y, pixels);
+}
+
+sf::Vector2u Render::getSize() const {
+  return isUploaded() ? texture.getSize() : image.getSize();
+}
+
+sf::Texture const& Render::getTexture() {
+  if (!isUploaded()) {
+    if (!texture.loadFromImage(image)) {
+      throw std::runtime_error("getTexture error: couldn't upload the pixels");
+    }
+    image = sf::Image{};
+  }
+  return texture;
+}
+
+}  // namespace GS
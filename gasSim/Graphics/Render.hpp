@@ -0,0 +1,35 @@
+#ifndef RENDER_HPP
+#define RENDER_HPP
+
+#include <SFML/Config.hpp>
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/System/Vector2.hpp>
+
+namespace GS {
+
+// a drawn frame, a texture for the sfml backend or the rgba pixels for the
+// cpu one, which drawing threads without a gl context can fill
+// the pixels are uploaded on the first getTexture, from the thread showing
+// the frame
+class Render {
+ public:
+  Render() = default;
+  explicit Render(sf::Texture const& textureV) : texture{textureV} {}
+  // copies size.x * size.y rgba pixels
+  Render(sf::Vector2u size, sf::Uint8 const* pixels);
+
+  sf::Vector2u getSize() const;
+  bool isUploaded() const { return !image.getSize().x; }
+  // empty once uploaded
+  sf::Image const& getImage() const { return image; }
+  sf::Texture const& getTexture();
+
+ private:
+  sf::Texture texture{};
+  sf::Image image{};
+};
+
+}  // namespace GS
+
+#endif
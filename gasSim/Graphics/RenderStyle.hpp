@@ -4,13 +4,15 @@
 #include <string>
 
 #include <SFML/Graphics/Color.hpp>
+#include <SFML/Graphics/Image.hpp>
 #include <SFML/Graphics/Texture.hpp>
 
 namespace GS {
 
 class RenderStyle {
  public:
-  RenderStyle(sf::Texture const& texture) : partTexture(texture) {}
+  RenderStyle(sf::Texture const& texture)
+      : partTexture(texture), partImage(texture.copyToImage()) {}
   RenderStyle() = delete;
 
   std::string const& getWallsOpts() const { return wallsOpts; }
@@ -21,7 +23,12 @@ class RenderStyle {
   void setWOutlineColor(sf::Color color) { wOutlineColor = color; }
 
   sf::Texture const& getPartTexture() const { return partTexture; }
-  void setPartTexture(sf::Texture const& texture) { partTexture = texture; }
+  // copy of the particle texture in memory, for the cpu backend
+  sf::Image const& getPartImage() const { return partImage; }
+  void setPartTexture(sf::Texture const& texture) {
+    partTexture = texture;
+    partImage = texture.copyToImage();
+  }
 
   sf::Color getBGColor() const { return background; }
   void setBGColor(sf::Color color) { background = color; }
@@ -34,6 +41,7 @@ class RenderStyle {
   sf::Color wOutlineColor{sf::Color::Black};
 
   sf::Texture partTexture;
+  sf::Image partImage;
 
   sf::Color background{sf::Color::White};
 };
@@ -0,0 +1,330 @@
+#include "SoftCanvas.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <SFML/Config.hpp>
+#include <SFML/Graphics/Color.hpp>
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/System/Vector2.hpp>
+
+#include <tbb/parallel_for.h>
+
+namespace GS {
+
+// first pixel whose center is past coordinate x, within [0, max]
+unsigned pixelBound(float x, unsigned max) {
+  float bound{std::ceil(x - 0.5f)};
+  if (!(bound > 0.f)) {
+    return 0;
+  }
+  return bound < static_cast<float>(max) ? static_cast<unsigned>(bound) : max;
+}
+
+// calls f(firstRow, endRow, firstCol, endCol) in parallel for each tile
+// holding rows from rowFirst to rowEnd
+template <typename F>
+void forEachTile(unsigned width, unsigned rowFirst, unsigned rowEnd,
+                 F const& f) {
+  unsigned const side{SoftCanvas::tileSide};
+  if (rowFirst >= rowEnd || !width) {
+    return;
+  }
+  unsigned const firstTileRow{rowFirst / side};
+  size_t const tileRows{(rowEnd - 1) / side + 1 - firstTileRow};
+  size_t const tileCols{(width + side - 1) / side};
+  tbb::parallel_for(size_t{0}, tileRows * tileCols, [&](size_t t) {
+    unsigned tileRow{firstTileRow + static_cast<unsigned>(t / tileCols)};
+    unsigned col0{static_cast<unsigned>(t % tileCols) * side};
+    f(std::max(rowFirst, tileRow * side),
+      std::min(rowEnd, (tileRow + 1) * side), col0,
+      std::min(width, col0 + side));
+  });
+}
+
+// pixels of row whose centers lie inside the convex polygon
+std::pair<unsigned, unsigned> polygonSpan(
+    std::vector<sf::Vector2f> const& points, unsigned row, unsigned width) {
+  float const y{static_cast<float>(row) + 0.5f};
+  float left{INFINITY};
+  float right{-INFINITY};
+  for (size_t i{0}; i < points.size(); ++i) {
+    sf::Vector2f const& a{points[i]};
+    sf::Vector2f const& b{points[(i + 1) % points.size()]};
+    if ((a.y <= y && b.y > y) || (b.y <= y && a.y > y)) {
+      float x{a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y)};
+      left = std::min(left, x);
+      right = std::max(right, x);
+    }
+  }
+  if (left > right) {
+    return {0, 0};
+  }
+  return {pixelBound(left, width), pixelBound(right, width)};
+}
+
+// the convex polygon with its sides moved out by distance, the way sfml
+// builds the outlines of its shapes
+std::vector<sf::Vector2f> outsetPolygon(std::vector<sf::Vector2f> const& points,
+                                        float distance) {
+  size_t const n{points.size()};
+  float area{0.f};
+  for (size_t i{0}; i < n; ++i) {
+    sf::Vector2f const& a{points[i]};
+    sf::Vector2f const& b{points[(i + 1) % n]};
+    area += a.x * b.y - b.x * a.y;
+  }
+  float const orientation{area > 0.f ? 1.f : -1.f};
+  std::vector<sf::Vector2f> normals(n);
+  for (size_t i{0}; i < n; ++i) {
+    sf::Vector2f const& a{points[i]};
+    sf::Vector2f const& b{points[(i + 1) % n]};
+    float length{std::hypot(b.x - a.x, b.y - a.y)};
+    normals[i] = length > 0.f ? sf::Vector2f{orientation * (b.y - a.y) / length,
+                                             orientation * (a.x - b.x) / length}
+                              : normals[(i + n - 1) % n];
+  }
+  std::vector<sf::Vector2f> outset(n);
+  for (size_t i{0}; i < n; ++i) {
+    sf::Vector2f const& n0{normals[(i + n - 1) % n]};
+    sf::Vector2f const& n1{normals[i]};
+    float factor{1.f + n0.x * n1.x + n0.y * n1.y};
+    sf::Vector2f miter{factor > 1e-3f ? sf::Vector2f{(n0.x + n1.x) / factor,
+                                                     (n0.y + n1.y) / factor}
+                                      : n1};
+    outset[i] = {points[i].x + miter.x * distance,
+                 points[i].y + miter.y * distance};
+  }
+  return outset;
+}
+
+void SoftCanvas::create(unsigned widthV, unsigned heightV) {
+  if (widthV != width || heightV != height) {
+    width = widthV;
+    height = heightV;
+    pixels.assign(size_t{width} * height * 4, 0);
+  }
+}
+
+sf::Color SoftCanvas::getPixel(unsigned x, unsigned y) const {
+  sf::Uint8 const* p{pixels.data() + (size_t{y} * width + x) * 4};
+  return {p[0], p[1], p[2], p[3]};
+}
+
+void SoftCanvas::clear(sf::Color color) {
+  std::array<sf::Uint8, 4> const rgba{color.r, color.g, color.b, color.a};
+  forEachTile(
+      width, 0, height,
+      [&](unsigned row0, unsigned row1, unsigned col0, unsigned col1) {
+        for (unsigned row{row0}; row < row1; ++row) {
+          sf::Uint8* p{pixels.data() + (size_t{row} * width + col0) * 4};
+          for (unsigned col{col0}; col < col1; ++col, p += 4) {
+            std::memcpy(p, rgba.data(), 4);
+          }
+        }
+      });
+}
+
+void SoftCanvas::fillPolygon(std::vector<sf::Vector2f> const& points,
+                             sf::Color fill, sf::Color outline,
+                             float outlineThickness) {
+  if (points.size() < 3) {
+    return;
+  }
+  std::vector<sf::Vector2f> outer{};
+  if (outlineThickness > 0.f && outline.a) {
+    outer = outsetPolygon(points, outlineThickness);
+  }
+  std::vector<sf::Vector2f> const& bounds{outer.empty() ? points : outer};
+  auto [top, bottom]{std::minmax_element(
+      bounds.begin(), bounds.end(),
+      [](sf::Vector2f const& a, sf::Vector2f const& b) { return a.y < b.y; })};
+
+  // a row of the constant colors, blended like any other source
+  std::array<sf::Uint8, 4 * tileSide> fillRow{};
+  std::array<sf::Uint8, 4 * tileSide> outlineRow{};
+  for (size_t i{0}; i < fillRow.size(); i += 4) {
+    fillRow[i] = fill.r;
+    fillRow[i + 1] = fill.g;
+    fillRow[i + 2] = fill.b;
+    fillRow[i + 3] = fill.a;
+    outlineRow[i] = outline.r;
+    outlineRow[i + 1] = outline.g;
+    outlineRow[i + 2] = outline.b;
+    outlineRow[i + 3] = outline.a;
+  }
+  auto blendSpan{[&](std::array<sf::Uint8, 4 * tileSide> const& src,
+                     unsigned row, unsigned first, unsigned end) {
+    if (first < end) {
+      blendPixels(pixels.data() + (size_t{row} * width + first) * 4,
+                  src.data(), end - first);
+    }
+  }};
+
+  forEachTile(
+      width, pixelBound(top->y, height), pixelBound(bottom->y, height),
+      [&](unsigned row0, unsigned row1, unsigned col0, unsigned col1) {
+        for (unsigned row{row0}; row < row1; ++row) {
+          auto [first, end]{polygonSpan(points, row, width)};
+          if (first < end) {
+            first = std::clamp(first, col0, col1);
+            end = std::clamp(end, col0, col1);
+            blendSpan(fillRow, row, first, end);
+          }
+          if (outer.size()) {
+            auto [outFirst, outEnd]{polygonSpan(outer, row, width)};
+            outFirst = std::clamp(outFirst, col0, col1);
+            outEnd = std::clamp(outEnd, col0, col1);
+            if (first < end) {
+              blendSpan(outlineRow, row, outFirst, first);
+              blendSpan(outlineRow, row, end, outEnd);
+            } else {
+              blendSpan(outlineRow, row, outFirst, outEnd);
+            }
+          }
+        }
+      });
+}
+
+void SoftCanvas::drawSprites(sf::Image const& sprite,
+                             std::vector<SpriteQuad> const& quads) {
+  sf::Vector2u const sSize{sprite.getSize()};
+  if (!sSize.x || !sSize.y || !width || !height) {
+    return;
+  }
+  sf::Uint8 const* const sPixels{sprite.getPixelsPtr()};
+
+  // the quads reaching each row of tiles, in order
+  std::vector<std::vector<size_t>> tileRowQuads((height - 1) / tileSide + 1);
+  for (size_t q{0}; q < quads.size(); ++q) {
+    unsigned first{pixelBound(quads[q].y - quads[q].radius, height)};
+    unsigned end{pixelBound(quads[q].y + quads[q].radius, height)};
+    if (first < end) {
+      for (unsigned t{first / tileSide}; t <= (end - 1) / tileSide; ++t) {
+        tileRowQuads[t].push_back(q);
+      }
+    }
+  }
+
+  forEachTile(
+      width, 0, height,
+      [&](unsigned row0, unsigned row1, unsigned col0, unsigned col1) {
+        std::array<sf::Uint8, 4 * tileSide> texels{};
+        for (size_t q : tileRowQuads[row0 / tileSide]) {
+          SpriteQuad const& quad{quads[q]};
+          float const left{quad.x - quad.radius};
+          float const top{quad.y - quad.radius};
+          float const side{2.f * quad.radius};
+          unsigned const first{
+              std::clamp(pixelBound(left, width), col0, col1)};
+          unsigned const end{
+              std::clamp(pixelBound(left + side, width), col0, col1)};
+          unsigned const firstRow{
+              std::clamp(pixelBound(top, height), row0, row1)};
+          unsigned const endRow{
+              std::clamp(pixelBound(top + side, height), row0, row1)};
+          float const scaleX{static_cast<float>(sSize.x) / side};
+          float const scaleY{static_cast<float>(sSize.y) / side};
+          for (unsigned row{firstRow}; row < endRow; ++row) {
+            size_t sy{std::min(
+                size_t{sSize.y - 1},
+                static_cast<size_t>(
+                    (static_cast<float>(row) + 0.5f - top) * scaleY))};
+            sf::Uint8 const* sRow{sPixels + sy * sSize.x * 4};
+            for (unsigned col{first}; col < end; ++col) {
+              size_t sx{std::min(
+                  size_t{sSize.x - 1},
+                  static_cast<size_t>(
+                      (static_cast<float>(col) + 0.5f - left) * scaleX))};
+              std::memcpy(texels.data() + (col - first) * 4, sRow + sx * 4,
+                          4);
+            }
+            if (first < end) {
+              blendPixels(pixels.data() + (size_t{row} * width + first) * 4,
+                          texels.data(), end - first);
+            }
+          }
+        }
+      });
+}
+
+// source color weighted by its alpha, destination by its complement, the
+// alpha channels added with the source one in full
+// x / 255 is rounded as (x + 128 + (x + 128) / 256) / 256, exact in 16 bits
+sf::Uint8 blendChannel(unsigned src, unsigned srcFactor, unsigned dst,
+                       unsigned dstFactor) {
+  unsigned x{src * srcFactor + dst * dstFactor + 128};
+  return static_cast<sf::Uint8>((x + (x >> 8)) >> 8);
+}
+
+#if defined(__SSE2__)
+
+char const* blendKernelISA() { return "sse2"; }
+
+// two pixels, one channel per 16 bit lane
+__m128i blendTwo(__m128i src, __m128i dst) {
+  __m128i const full{_mm_set1_epi16(255)};
+  __m128i const alphaLanes{_mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0)};
+  __m128i alpha{_mm_shufflehi_epi16(
+      _mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)),
+      _MM_SHUFFLE(3, 3, 3, 3))};
+  __m128i srcFactor{_mm_or_si128(_mm_andnot_si128(alphaLanes, alpha),
+                                 _mm_and_si128(alphaLanes, full))};
+  __m128i x{_mm_add_epi16(
+      _mm_add_epi16(_mm_mullo_epi16(src, srcFactor),
+                    _mm_mullo_epi16(dst, _mm_sub_epi16(full, alpha))),
+      _mm_set1_epi16(128))};
+  return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+#else
+
+char const* blendKernelISA() { return "scalar"; }
+
+#endif
+
+void blendPixels(sf::Uint8* dst, sf::Uint8 const* src, size_t n) {
+  size_t i{0};
+#if defined(__SSE2__)
+  __m128i const zero{_mm_setzero_si128()};
+  __m128i const alphaMask{_mm_set1_epi32(static_cast<int>(0xff000000))};
+  for (; i + 4 <= n; i += 4) {
+    __m128i s{_mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i * 4))};
+    // fully transparent texels leave the pixels as they are
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alphaMask),
+                                          zero)) == 0xffff) {
+      continue;
+    }
+    __m128i d{_mm_loadu_si128(reinterpret_cast<__m128i const*>(dst + i * 4))};
+    __m128i lo{
+        blendTwo(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero))};
+    __m128i hi{
+        blendTwo(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero))};
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4),
+                     _mm_packus_epi16(lo, hi));
+  }
+#endif
+  for (; i < n; ++i) {
+    sf::Uint8 const* s{src + i * 4};
+    sf::Uint8* d{dst + i * 4};
+    unsigned alpha{s[3]};
+    if (!alpha) {
+      continue;
+    }
+    for (size_t c{0}; c < 3; ++c) {
+      d[c] = blendChannel(s[c], alpha, d[c], 255 - alpha);
+    }
+    d[3] = blendChannel(s[3], 255, d[3], 255 - alpha);
+  }
+}
+
+}  // namespace GS
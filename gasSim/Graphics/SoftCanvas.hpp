@@ -0,0 +1,61 @@
+#ifndef SOFTCANVAS_HPP
+#define SOFTCANVAS_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <SFML/Config.hpp>
+#include <SFML/Graphics/Color.hpp>
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/System/Vector2.hpp>
+
+namespace GS {
+
+// square in pixels, textured with a whole sprite
+struct SpriteQuad {
+  float x{0.f};  // center
+  float y{0.f};
+  float radius{0.f};  // half side
+};
+
+// rgba picture drawn on the cpu, with its rows from the top down, blending
+// like sfml's default alpha blending
+// every drawing call splits the picture in square tiles drawn in parallel
+class SoftCanvas {
+ public:
+  static constexpr unsigned tileSide{64};
+
+  SoftCanvas() = default;
+  SoftCanvas(unsigned widthV, unsigned heightV) { create(widthV, heightV); }
+
+  // keeps the pixels if the size didn't change
+  void create(unsigned widthV, unsigned heightV);
+  sf::Vector2u getSize() const { return {width, height}; }
+  sf::Uint8 const* getPixelsPtr() const { return pixels.data(); }
+  sf::Color getPixel(unsigned x, unsigned y) const;
+
+  void clear(sf::Color color);
+  // covers the pixels whose centers are inside the convex polygon, the
+  // outline being drawn outside of it with mitered corners
+  void fillPolygon(std::vector<sf::Vector2f> const& points, sf::Color fill,
+                   sf::Color outline = sf::Color::Transparent,
+                   float outlineThickness = 0.f);
+  // in order, the sprite sampled at the nearest texel
+  void drawSprites(sf::Image const& sprite,
+                   std::vector<SpriteQuad> const& quads);
+
+ private:
+  unsigned width{0};
+  unsigned height{0};
+  std::vector<sf::Uint8> pixels{};
+};
+
+// blends n rgba pixels of src over dst, rounding like the scalar path
+// whatever the instruction set
+void blendPixels(sf::Uint8* dst, sf::Uint8 const* src, size_t n);
+// instruction set blendPixels was compiled for: "sse2" or "scalar"
+char const* blendKernelISA();
+
+}  // namespace GS
+
+#endif
@@ -7,18 +7,23 @@
 
 namespace GS {
 
-Collision::Collision(double timeV, Particle* p1p) : p1{p1p}, time{timeV} {
+template <typename FP>
+BasicCollision<FP>::BasicCollision(double timeV, BasicParticle<FP>* p1p)
+    : p1{p1p}, time{timeV} {
   if (time < 0.) {
     throw std::invalid_argument(
         "Collision constructor error: provided negative time");
   }
 }
 
-PWCollision::PWCollision(double timeV, Particle* p1p, Wall wallV)
-    : Collision(timeV, p1p), wall{wallV} {}
+template <typename FP>
+BasicPWCollision<FP>::BasicPWCollision(double timeV, BasicParticle<FP>* p1p,
+                                       Wall wallV)
+    : BasicCollision<FP>(timeV, p1p), wall{wallV} {}
 
-void PWCollision::solve() {
-  Particle* p{getP1()};
+template <typename FP>
+void BasicPWCollision<FP>::solve() {
+  BasicParticle<FP>* p{this->getP1()};
   switch (wall) {
     case Wall::Left:
     case Wall::Right:
@@ -38,18 +43,28 @@ void PWCollision::solve() {
   }
 }
 
-PPCollision::PPCollision(double timeV, Particle* p1p, Particle* p2p)
-    : Collision(timeV, p1p), p2{p2p} {}
+template <typename FP>
+BasicPPCollision<FP>::BasicPPCollision(double timeV, BasicParticle<FP>* p1p,
+                                       BasicParticle<FP>* p2p)
+    : BasicCollision<FP>(timeV, p1p), p2{p2p} {}
 
-void PPCollision::solve() {
-  Particle* p1p{getP1()};
-  GSVectorD d{p1p->position - p2->position};
+template <typename FP>
+void BasicPPCollision<FP>::solve() {
+  BasicParticle<FP>* p1p{this->getP1()};
+  GSVector<FP> d{p1p->position - p2->position};
   d.normalize();
-  GSVectorD v{p1p->speed - p2->speed};
-  double proj = d * v;
+  GSVector<FP> v{p1p->speed - p2->speed};
+  FP proj = d * v;
 
   p1p->speed -= d * proj;
   p2->speed += d * proj;
 }
 
+template struct BasicCollision<float>;
+template struct BasicCollision<double>;
+template struct BasicPWCollision<float>;
+template struct BasicPWCollision<double>;
+template struct BasicPPCollision<float>;
+template struct BasicPPCollision<double>;
+
 }  // namespace GS
@@ -3,29 +3,32 @@
 
 namespace GS {
 
-struct Particle;
+template <typename FP>
+struct BasicParticle;
 
 enum class Wall { Front, Back, Left, Right, Top, Bottom, VOID };
 
-struct Collision {
+template <typename FP>
+struct BasicCollision {
  public:
-  Collision(double time, Particle* p);
+  BasicCollision(double time, BasicParticle<FP>* p);
 
   virtual char getType() const = 0;
   virtual void solve() = 0;
 
-  Particle* getP1() { return p1; }
-  Particle const* getP1() const { return p1; }
+  BasicParticle<FP>* getP1() { return p1; }
+  BasicParticle<FP> const* getP1() const { return p1; }
   double getTime() const { return time; }
 
  private:
-  Particle* p1;
+  BasicParticle<FP>* p1;
   double time;
 };
 
-struct PWCollision final : public Collision {
+template <typename FP>
+struct BasicPWCollision final : public BasicCollision<FP> {
  public:
-  PWCollision(double time, Particle* p1, Wall wall);
+  BasicPWCollision(double time, BasicParticle<FP>* p1, Wall wall);
 
   void solve() override;
   char getType() const override { return 'w'; }
@@ -36,19 +39,24 @@ struct PWCollision final : public Collision {
   Wall wall;
 };
 
-struct PPCollision final : public Collision {
+template <typename FP>
+struct BasicPPCollision final : public BasicCollision<FP> {
  public:
-  PPCollision(double time, Particle* p1, Particle* p2);
+  BasicPPCollision(double time, BasicParticle<FP>* p1, BasicParticle<FP>* p2);
 
   char getType() const override { return 'p'; }
   void solve() override;
 
-  Particle* getP2() const { return p2; }
+  BasicParticle<FP>* getP2() const { return p2; }
 
  private:
-  Particle* p2;
+  BasicParticle<FP>* p2;
 };
 
+using Collision = BasicCollision<double>;
+using PWCollision = BasicPWCollision<double>;
+using PPCollision = BasicPPCollision<double>;
+
 }  // namespace GS
 
 #endif
@@ -0,0 +1,352 @@
+#include "CollisionCalendar.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "PhysicsEngine/Collision.hpp"
+#include "PhysicsEngine/GSVector.hpp"
+#include "PhysicsEngine/Particle.hpp"
+#include "PhysicsEngine/WorkerPool.hpp"
+
+namespace GS {
+
+// implemented in Gas.cpp
+template <typename FP>
+double collisionTime(BasicParticle<FP> const& p1, BasicParticle<FP> const& p2,
+                     double radius);
+template <typename FP>
+std::pair<double, Wall> wallCollTime(BasicParticle<FP> const& p,
+                                     double boxSide, double radius);
+
+// same approach check used by the brute force search in Gas::firstPPColl
+template <typename FP>
+inline double approachCollTime(BasicParticle<FP> const& p1,
+                               BasicParticle<FP> const& p2, double radius) {
+  if ((p1.position - p2.position) * (p1.speed - p2.speed) <= 0.) {
+    return collisionTime(p1, p2, radius);
+  } else {
+    return INFINITY;
+  }
+}
+
+// particle i moved from its own local time to time
+template <typename FP>
+inline BasicParticle<FP> atTime(
+    std::vector<BasicParticle<FP>> const& particles,
+    std::vector<double> const& localTimes, size_t i, double time) {
+  BasicParticle<FP> const& p{particles[i]};
+  return {p.position + p.speed * static_cast<FP>(time - localTimes[i]),
+          p.speed};
+}
+
+// ties are broken in the same order the brute force search would choose in:
+// wall collisions first, then lowest particle indexes
+// cell transits have no physical effect and always come first
+bool CollisionCalendar::LaterEvent::operator()(Event const& e1,
+                                               Event const& e2) const {
+  if (e1.time != e2.time) {
+    return e1.time > e2.time;
+  }
+  if (e1.type != e2.type) {
+    return e1.type == EventType::particle ||
+           (e1.type == EventType::wall && e2.type == EventType::transit);
+  }
+  if (e1.type != EventType::particle) {
+    return e1.p1 > e2.p1;
+  }
+  return std::minmax(e1.p1, e1.p2) > std::minmax(e2.p1, e2.p2);
+}
+
+template <typename FP>
+void CollisionCalendar::build(std::vector<BasicParticle<FP>> const& particles,
+                              std::vector<double> const& localTimes,
+                              double boxSide, double radiusV, double time,
+                              bool useGrid, WorkerPool* pool) {
+  clear();
+  radius = radiusV;
+  size_t nP{particles.size()};
+  collCounts.assign(nP, 0);
+  bestTimes.assign(nP, INFINITY);
+
+  // cells must be at least a particle diameter wide, and there is no point in
+  // having many more cells than particles
+  cellsPerSide = 1;
+  if (useGrid) {
+    double maxCells{std::floor(boxSide / (2. * radius))};
+    double fillCells{std::ceil(std::cbrt(static_cast<double>(nP)))};
+    cellsPerSide =
+        static_cast<size_t>(std::max(std::min(maxCells, fillCells), 1.));
+  }
+  cellSide = boxSide / static_cast<double>(cellsPerSide);
+  cells.assign(cellsPerSide * cellsPerSide * cellsPerSide, {});
+  partCells.resize(nP);
+  std::vector<BasicParticle<FP>> current{};
+  current.reserve(nP);
+  for (size_t i{0}; i < nP; ++i) {
+    current.push_back(atTime(particles, localTimes, i, time));
+  }
+  for (size_t i{0}; i < nP; ++i) {
+    auto coord{[&](double x) {
+      double c{std::floor(x / cellSide)};
+      return static_cast<size_t>(
+          std::clamp(c, 0., static_cast<double>(cellsPerSide - 1)));
+    }};
+    GSVector<FP> const& pos{current[i].position};
+    partCells[i] =
+        coord(pos.x) +
+        cellsPerSide * (coord(pos.y) + cellsPerSide * coord(pos.z));
+    cells[partCells[i]].push_back(i);
+  }
+
+  std::vector<Event> best(nP);
+  auto ownEvents{[&](size_t i) {
+    std::pair<double, Wall> wColl{wallCollTime(current[i], boxSide, radius)};
+    best[i] = {time + wColl.first, EventType::wall, i, SIZE_MAX, wColl.second,
+               0, 0};
+    Event t{transit(current[i], i, time)};
+    if (t.time < best[i].time) {
+      best[i] = t;
+    }
+  }};
+  if (pool) {
+    // each worker writes only the best events of its own particles, so every
+    // couple is checked twice
+    size_t nThreads{pool->getThreadsN()};
+    pool->run([&](size_t thrI) {
+      size_t last{(thrI + 1) * nP / nThreads};
+      for (size_t i{thrI * nP / nThreads}; i < last; ++i) {
+        ownEvents(i);
+        forEachNeighbour(i, [&](size_t j) {
+          double t{time + approachCollTime(current[i], current[j], radius)};
+          if (t < best[i].time) {
+            best[i] = {t, EventType::particle, i, j, Wall::VOID, 0, 0};
+          }
+        });
+      }
+    });
+  } else {
+    // every neighbouring couple is checked only once, updating both
+    // particles' best events
+    for (size_t i{0}; i < nP; ++i) {
+      ownEvents(i);
+    }
+    for (size_t i{0}; i < nP; ++i) {
+      forEachNeighbour(i, [&](size_t j) {
+        if (j < i) {
+          return;
+        }
+        double t{time + approachCollTime(current[i], current[j], radius)};
+        if (t < best[i].time) {
+          best[i] = {t, EventType::particle, i, j, Wall::VOID, 0, 0};
+        }
+        if (t < best[j].time) {
+          best[j] = {t, EventType::particle, j, i, Wall::VOID, 0, 0};
+        }
+      });
+    }
+  }
+
+  for (size_t i{0}; i < nP; ++i) {
+    bestTimes[i] = best[i].time;
+    if (std::isfinite(best[i].time)) {
+      events.push(best[i]);
+    }
+  }
+
+  built = true;
+}
+
+void CollisionCalendar::clear() {
+  events = {};
+  collCounts.clear();
+  bestTimes.clear();
+  cells.clear();
+  partCells.clear();
+  built = false;
+}
+
+size_t CollisionCalendar::memoryUsage() const {
+  size_t bytes{events.size() * sizeof(Event) +
+               collCounts.capacity() * sizeof(size_t) +
+               bestTimes.capacity() * sizeof(double) +
+               cells.capacity() * sizeof(std::vector<size_t>) +
+               partCells.capacity() * sizeof(size_t)};
+  for (std::vector<size_t> const& cell : cells) {
+    bytes += cell.capacity() * sizeof(size_t);
+  }
+  return bytes;
+}
+
+bool CollisionCalendar::isValid(Event const& e) const {
+  return collCounts[e.p1] == e.p1Count &&
+         (e.type != EventType::particle || collCounts[e.p2] == e.p2Count);
+}
+
+std::array<size_t, 3> CollisionCalendar::cellCoords(size_t cell) const {
+  return {cell % cellsPerSide, (cell / cellsPerSide) % cellsPerSide,
+          cell / (cellsPerSide * cellsPerSide)};
+}
+
+// calls f on the indexes of all particles in pI's cell and in the ones
+// surrounding it, pI excluded
+template <typename F>
+void CollisionCalendar::forEachNeighbour(size_t pI, F&& f) const {
+  std::array<size_t, 3> c{cellCoords(partCells[pI])};
+  auto range{[&](size_t x) {
+    return std::pair<size_t, size_t>{x ? x - 1 : 0,
+                                     std::min(x + 1, cellsPerSide - 1)};
+  }};
+  std::pair<size_t, size_t> xR{range(c[0])};
+  std::pair<size_t, size_t> yR{range(c[1])};
+  std::pair<size_t, size_t> zR{range(c[2])};
+  for (size_t z{zR.first}; z <= zR.second; ++z) {
+    for (size_t y{yR.first}; y <= yR.second; ++y) {
+      for (size_t x{xR.first}; x <= xR.second; ++x) {
+        for (size_t j : cells[x + cellsPerSide * (y + cellsPerSide * z)]) {
+          if (j != pI) {
+            f(j);
+          }
+        }
+      }
+    }
+  }
+}
+
+// earliest crossing of the particle's cell boundaries, walls excluded
+template <typename FP>
+CollisionCalendar::Event CollisionCalendar::transit(BasicParticle<FP> const& p,
+                                                    size_t pI,
+                                                    double time) const {
+  Event result{INFINITY, EventType::transit, pI, SIZE_MAX, Wall::VOID,
+               collCounts[pI], 0};
+  std::array<size_t, 3> c{cellCoords(partCells[pI])};
+  std::array<double, 3> pos{p.position.x, p.position.y, p.position.z};
+  std::array<double, 3> spd{p.speed.x, p.speed.y, p.speed.z};
+  size_t stride{1};
+  for (size_t a{0}; a < 3; ++a, stride *= cellsPerSide) {
+    double t{INFINITY};
+    size_t target{SIZE_MAX};
+    if (spd[a] > 0. && c[a] + 1 < cellsPerSide) {
+      t = (static_cast<double>(c[a] + 1) * cellSide - pos[a]) / spd[a];
+      target = partCells[pI] + stride;
+    } else if (spd[a] < 0. && c[a] > 0) {
+      t = (static_cast<double>(c[a]) * cellSide - pos[a]) / spd[a];
+      target = partCells[pI] - stride;
+    }
+    if (time + std::max(t, 0.) < result.time) {
+      result.time = time + std::max(t, 0.);
+      result.p2 = target;
+    }
+  }
+  return result;
+}
+
+template <typename FP>
+CollisionCalendar::Event CollisionCalendar::nextEvent(
+    std::vector<BasicParticle<FP>> const& particles,
+    std::vector<double> const& localTimes, double boxSide, double time) {
+  while (!events.empty()) {
+    Event e{events.top()};
+    if (isValid(e)) {
+      if (e.type != EventType::transit) {
+        return e;
+      }
+      events.pop();
+      std::vector<size_t>& oldCell{cells[partCells[e.p1]]};
+      oldCell.erase(std::find(oldCell.begin(), oldCell.end(), e.p1));
+      cells[e.p2].push_back(e.p1);
+      partCells[e.p1] = e.p2;
+      // the new neighbours have to be made aware of the particle
+      ++collCounts[e.p1];
+      predict(particles, localTimes, boxSide, time, e.p1, true);
+    } else {
+      events.pop();
+      // a stale partner leaves the first particle without a scheduled event,
+      // while a stale first particle has already been rescheduled
+      if (collCounts[e.p1] == e.p1Count) {
+        predict(particles, localTimes, boxSide, time, e.p1, false);
+      }
+    }
+  }
+  return {INFINITY, EventType::wall, SIZE_MAX, SIZE_MAX, Wall::VOID, 0, 0};
+}
+
+template <typename FP>
+void CollisionCalendar::update(std::vector<BasicParticle<FP>> const& particles,
+                               std::vector<double> const& localTimes,
+                               double boxSide, double time) {
+  Event solved{events.top()};
+  events.pop();
+  ++collCounts[solved.p1];
+  if (solved.type == EventType::particle) {
+    ++collCounts[solved.p2];
+  }
+  predict(particles, localTimes, boxSide, time, solved.p1, true);
+  if (solved.type == EventType::particle) {
+    predict(particles, localTimes, boxSide, time, solved.p2, true);
+  }
+}
+
+// schedules the earliest event of particle pI, optionally also scheduling the
+// collisions with pI that come before the other particles' ones (needed when
+// pI's trajectory or neighbourhood changed)
+template <typename FP>
+void CollisionCalendar::predict(std::vector<BasicParticle<FP>> const& particles,
+                                std::vector<double> const& localTimes,
+                                double boxSide, double time, size_t pI,
+                                bool notifyOthers) {
+  BasicParticle<FP> const current{atTime(particles, localTimes, pI, time)};
+  std::pair<double, Wall> wColl{wallCollTime(current, boxSide, radius)};
+  Event best{time + wColl.first, EventType::wall, pI, SIZE_MAX, wColl.second,
+             collCounts[pI], 0};
+  Event t{transit(current, pI, time)};
+  if (t.time < best.time) {
+    best = t;
+  }
+
+  forEachNeighbour(pI, [&](size_t j) {
+    BasicParticle<FP> const other{atTime(particles, localTimes, j, time)};
+    double pTime{time + approachCollTime(current, other, radius)};
+    if (pTime < best.time) {
+      best = {pTime, EventType::particle, pI, j, Wall::VOID,
+              collCounts[pI], collCounts[j]};
+    }
+    if (notifyOthers && pTime < bestTimes[j]) {
+      bestTimes[j] = pTime;
+      events.push({pTime, EventType::particle, j, pI, Wall::VOID, collCounts[j],
+                   collCounts[pI]});
+    }
+  });
+
+  bestTimes[pI] = best.time;
+  if (std::isfinite(best.time)) {
+    events.push(best);
+  }
+}
+
+template void CollisionCalendar::build(
+    std::vector<ParticleF> const& particles,
+    std::vector<double> const& localTimes, double boxSide, double radius,
+    double time, bool useGrid, WorkerPool* pool);
+template void CollisionCalendar::build(std::vector<Particle> const& particles,
+                                       std::vector<double> const& localTimes,
+                                       double boxSide, double radius,
+                                       double time, bool useGrid,
+                                       WorkerPool* pool);
+template CollisionCalendar::Event CollisionCalendar::nextEvent(
+    std::vector<ParticleF> const& particles,
+    std::vector<double> const& localTimes, double boxSide, double time);
+template CollisionCalendar::Event CollisionCalendar::nextEvent(
+    std::vector<Particle> const& particles,
+    std::vector<double> const& localTimes, double boxSide, double time);
+template void CollisionCalendar::update(
+    std::vector<ParticleF> const& particles,
+    std::vector<double> const& localTimes, double boxSide, double time);
+template void CollisionCalendar::update(
+    std::vector<Particle> const& particles,
+    std::vector<double> const& localTimes, double boxSide, double time);
+
+}  // namespace GS
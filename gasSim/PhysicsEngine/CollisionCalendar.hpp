@@ -0,0 +1,94 @@
+#ifndef COLLISIONCALENDAR_HPP
+#define COLLISIONCALENDAR_HPP
+
+#include <array>
+#include <cstddef>
+#include <queue>
+#include <vector>
+
+#include "Collision.hpp"
+
+namespace GS {
+
+template <typename FP>
+struct BasicParticle;
+class WorkerPool;
+
+// event-driven collision search: keeps a priority queue of predicted
+// collisions, only re-predicting the ones of the particles whose speed changed
+// optionally bins the particles in a uniform grid of cells at least a
+// particle diameter wide, so that only neighbouring cells are searched
+// the particles' precision only matters to the functions reading them
+class CollisionCalendar {
+ public:
+  enum class EventType { particle, wall, transit };  // transit: cell change
+
+  struct Event {
+    double time;  // absolute time of the event
+    EventType type;
+    size_t p1;
+    size_t p2;  // second particle or target cell for transit events
+    Wall wall;
+    size_t p1Count;  // p1 collisions count at prediction time
+    size_t p2Count;
+  };
+
+  // localTimes holds the time each particle's position refers to, particles
+  // are extrapolated to time when needed
+  // radius is kept for the following predictions
+  // the first predictions are split between the workers of pool if given
+  template <typename FP>
+  void build(std::vector<BasicParticle<FP>> const& particles,
+             std::vector<double> const& localTimes, double boxSide,
+             double radius, double time, bool useGrid = false,
+             WorkerPool* pool = nullptr);
+  void clear();
+  bool isBuilt() const { return built; }
+  // predicted events still queued included, invalidated ones too
+  size_t memoryUsage() const;
+  size_t getCellsPerSide() const { return cellsPerSide; }
+
+  // discards invalidated events and handles cell transits, returns the first
+  // valid collision without popping it, INFINITY time if none
+  template <typename FP>
+  Event nextEvent(std::vector<BasicParticle<FP>> const& particles,
+                  std::vector<double> const& localTimes, double boxSide,
+                  double time);
+  // pops the first event and re-predicts the collisions of the particles
+  // involved in it, expects them to have been moved to its time and solved
+  template <typename FP>
+  void update(std::vector<BasicParticle<FP>> const& particles,
+              std::vector<double> const& localTimes, double boxSide,
+              double time);
+
+ private:
+  struct LaterEvent {
+    bool operator()(Event const& e1, Event const& e2) const;
+  };
+
+  template <typename FP>
+  void predict(std::vector<BasicParticle<FP>> const& particles,
+               std::vector<double> const& localTimes, double boxSide,
+               double time, size_t pI, bool notifyOthers);
+  bool isValid(Event const& e) const;
+  template <typename FP>
+  Event transit(BasicParticle<FP> const& p, size_t pI, double time) const;
+  std::array<size_t, 3> cellCoords(size_t cell) const;
+  template <typename F>
+  void forEachNeighbour(size_t pI, F&& f) const;
+
+  bool built{false};
+  std::priority_queue<Event, std::vector<Event>, LaterEvent> events{};
+  std::vector<size_t> collCounts{};  // per-particle invalidation counters
+  std::vector<double> bestTimes{};   // per-particle earliest scheduled event
+
+  double radius{0.};
+  size_t cellsPerSide{1};
+  double cellSide{0.};
+  std::vector<std::vector<size_t>> cells{};  // particle indexes in each cell
+  std::vector<size_t> partCells{};           // cell of each particle
+};
+
+}  // namespace GS
+
+#endif
@@ -1,89 +1,177 @@
 #include "Gas.hpp"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <iostream>
-#include <iterator>
-#include <mutex>
+#include <limits>
+#include <memory>
 #include <numeric>
+#include <optional>
 #include <random>
 #include <stdexcept>
-#include <thread>
 #include <utility>
 #include <vector>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include "DataProcessing/Checkpoint.hpp"
 #include "DataProcessing/GasData.hpp"
 #include "DataProcessing/SimDataPipeline.hpp"
 #include "GSVector.hpp"
 #include "PhysicsEngine/Collision.hpp"
+#include "PhysicsEngine/CollisionCalendar.hpp"
 #include "PhysicsEngine/Particle.hpp"
+#include "PhysicsEngine/ParticleSoA.hpp"
+#include "PhysicsEngine/WorkerPool.hpp"
 
 namespace GS {
 
-template <typename Iterator, typename Function>
-void for_each_couple(Iterator first, Iterator last, Function f) {
-  for (auto it1 = first; it1 != last; ++it1) {
-    for (auto it2 = std::next(it1); it2 != last; ++it2) {
-      f(*it1, *it2);
-    }
+// bins the particles in a grid of cells at least a diameter wide, so that
+// only couples in neighbouring cells can overlap
+// couples closer than a diameter by at most tolerance don't count, particles
+// outside of the box go in its border cells
+template <typename FP>
+bool anyOverlap(std::vector<BasicParticle<FP>> const& particles,
+                double boxSide, double radius, double tolerance = 0.) {
+  size_t n{particles.size()};
+  if (n < 2) {
+    return false;
+  }
+  // about one particle per cell, fewer if the diameter doesn't allow it
+  double maxCells{std::min(
+      std::floor(boxSide / (2. * radius)),
+      std::ceil(std::cbrt(static_cast<double>(n))))};
+  size_t perSide{maxCells >= 1. ? static_cast<size_t>(maxCells) : 1};
+  double cellSide{boxSide / static_cast<double>(perSide)};
+
+  auto coord{[=](FP x) {
+    return std::min(perSide - 1, static_cast<size_t>(std::max(
+                                     static_cast<double>(x) / cellSide, 0.)));
+  }};
+  // counting sort of the particle indexes by cell
+  std::vector<size_t> partCells(n);
+  std::vector<size_t> cellStarts(perSide * perSide * perSide + 1, 0);
+  for (size_t i{0}; i < n; ++i) {
+    GSVector<FP> const& pos{particles[i].position};
+    partCells[i] =
+        coord(pos.x) + perSide * (coord(pos.y) + perSide * coord(pos.z));
+    ++cellStarts[partCells[i] + 1];
   }
+  std::partial_sum(cellStarts.begin(), cellStarts.end(), cellStarts.begin());
+  std::vector<size_t> sorted(n);
+  std::vector<size_t> fill(cellStarts.begin(), cellStarts.end() - 1);
+  for (size_t i{0}; i < n; ++i) {
+    sorted[fill[partCells[i]]++] = i;
+  }
+
+  std::atomic<bool> found{false};
+  tbb::parallel_for(
+      tbb::blocked_range<size_t>(0, n),
+      [&](tbb::blocked_range<size_t> const& r) {
+        for (size_t i{r.begin()}; i != r.end() && !found.load(); ++i) {
+          size_t cell{partCells[i]};
+          std::array<size_t, 3> c{cell % perSide, (cell / perSide) % perSide,
+                                  cell / (perSide * perSide)};
+          std::array<size_t, 3> lo{};
+          std::array<size_t, 3> hi{};
+          for (size_t k{0}; k < 3; ++k) {
+            lo[k] = c[k] ? c[k] - 1 : 0;
+            hi[k] = std::min(c[k] + 1, perSide - 1);
+          }
+          for (size_t z{lo[2]}; z <= hi[2]; ++z) {
+            for (size_t y{lo[1]}; y <= hi[1]; ++y) {
+              for (size_t x{lo[0]}; x <= hi[0]; ++x) {
+                size_t other{x + perSide * (y + perSide * z)};
+                for (size_t s{cellStarts[other]}; s < cellStarts[other + 1];
+                     ++s) {
+                  // each couple is checked by its lower index
+                  if (sorted[s] > i &&
+                      overlap(particles[i], particles[sorted[s]],
+                              radius - tolerance / 2.)) {
+                    found.store(true);
+                  }
+                }
+              }
+            }
+          }
+        }
+      });
+  return found.load();
 }
 
-Gas::Gas(std::vector<Particle>&& particlesV, double boxSideV, double timeV)
-    : particles{particlesV}, boxSide{boxSideV}, time{timeV} {
-  liveInstances.fetch_add(1);
+template <typename FP>
+BasicGas<FP>::BasicGas(std::vector<Particle>&& particlesV, double boxSideV,
+                       double timeV)
+    : particles{std::move(particlesV)}, boxSide{boxSideV}, time{timeV} {
+  GasProperties::liveInstances.fetch_add(1);
   if (boxSide <= 0) {
-    liveInstances.fetch_sub(1);
+    GasProperties::liveInstances.fetch_sub(1);
     throw std::invalid_argument(
         "Gas constructor error: non-positive box side provided");
   }
 
-  std::for_each(this->particles.begin(), this->particles.end(),
-                [&](Particle const& p) {
-                  if (!contains(p)) {
-                    liveInstances.fetch_sub(1);
-                    throw std::invalid_argument(
-                        "Gas constructor error: at least one of the provided "
-                        "particles is not inside of gas box.");
-                  }
-                });
-
-  for_each_couple(
-      this->particles.begin(), this->particles.end(),
-      [&](Particle const& p1, Particle const& p2) {
-        if (overlap(p1, p2)) {
-          liveInstances.fetch_sub(1);
-          throw std::invalid_argument(
-              "Gas constructor error: provided overlapping particles");
-        }
-      });
+  if (!std::all_of(this->particles.begin(), this->particles.end(),
+                   [&](Particle const& p) { return contains(p); })) {
+    GasProperties::liveInstances.fetch_sub(1);
+    throw std::invalid_argument(
+        "Gas constructor error: at least one of the provided "
+        "particles is not inside of gas box.");
+  }
+
+  if (anyOverlap(this->particles, boxSide, radius)) {
+    GasProperties::liveInstances.fetch_sub(1);
+    throw std::invalid_argument(
+        "Gas constructor error: provided overlapping particles");
+  }
+}
+
+// splitmix64 finalizer
+std::uint64_t mixBits(std::uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9u;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBu;
+  return z ^ (z >> 31);
+}
+
+// counter based generator: each value only depends on key and counter, so
+// the draws don't depend on the order or the thread they are made in
+double counterUniform(std::uint64_t key, std::uint64_t counter) {
+  return static_cast<double>(
+             mixBits(key + (counter + 1) * 0x9E3779B97F4A7C15u) >> 11) *
+         0x1p-53;
 }
 
-auto unifRandVec{[](double maxNorm) {
-  double theta;
-  double phi;
-  double rho;
-  static std::default_random_engine eng(std::random_device{}());
-  static std::uniform_real_distribution<double> baseDist(0, 1);
+// uses the counters 3 * index to 3 * index + 2
+GSVectorD unifRandVec(double maxNorm, std::uint64_t key, size_t index) {
   if (maxNorm < 0) {
     throw std::invalid_argument(
         "Random vector generator error: provided negative maxNorm");
   }
-  theta = baseDist(eng) * 2. * M_PI;
-  phi = -M_PI / 2. + baseDist(eng) * M_PI;
-  rho = baseDist(eng) * maxNorm;
+  std::uint64_t counter{3 * static_cast<std::uint64_t>(index)};
+  double theta{counterUniform(key, counter) * 2. * M_PI};
+  double phi{-M_PI / 2. + counterUniform(key, counter + 1) * M_PI};
+  double rho{counterUniform(key, counter + 2) * maxNorm};
   return GSVectorD({rho * std::cos(phi) * std::cos(theta),
                     rho * std::cos(phi) * sin(theta), rho * sin(phi)});
-}};
+}
 
 // parametric constructor with particles distributed
 // in a cubical lattice filling 95% of the box's dimensions and
 // uniform distribution for speed norm and direction
-Gas::Gas(size_t particlesN, double temperature, double boxSideV, double timeV)
+template <typename FP>
+BasicGas<FP>::BasicGas(size_t particlesN, double temperature, double boxSideV,
+                       double timeV, std::optional<unsigned> seed)
     : boxSide(boxSideV), time{timeV} {
+  // particle i draws its speed from the counters of its index, seeded gases
+  // are the same whatever the number of threads generating them
+  std::uint64_t key{mixBits(seed ? *seed : std::random_device{}())};
+
   if (temperature < 0.) {
     throw std::invalid_argument(
         "Gas constructor error: provided negative temperature");
@@ -94,15 +182,15 @@ Gas::Gas(size_t particlesN, double temperature, double boxSideV, double timeV)
   }
 
   if (particlesN) {
-    liveInstances.fetch_add(1);
+    GasProperties::liveInstances.fetch_add(1);
     size_t npPerSide{
         static_cast<size_t>(std::ceil(cbrt(static_cast<double>(particlesN))))};
-    double pR{Particle::getRadius()};
+    double pR{radius};
     double latticeUnit{(boxSide * 0.95 - 2 * pR) /
                        static_cast<double>(npPerSide - 1)};
 
     if (latticeUnit <= 2. * pR) {
-      liveInstances.fetch_sub(1);
+      GasProperties::liveInstances.fetch_sub(1);
       throw std::runtime_error(
           "Gas constructor error: provided particle number-radius too large to "
           "fit into box");
@@ -111,7 +199,7 @@ Gas::Gas(size_t particlesN, double temperature, double boxSideV, double timeV)
       if (particlesN == 1) {
         latticeUnit = 0.;
       } else {
-        liveInstances.fetch_sub(1);
+        GasProperties::liveInstances.fetch_sub(1);
         throw std::runtime_error(
             "Gas constructor error: computed non-finite cubical lattice unit, "
             "aborting");
@@ -120,7 +208,7 @@ Gas::Gas(size_t particlesN, double temperature, double boxSideV, double timeV)
 
     // result of a simple integration, it seems to work
     double maxSpeed =
-        std::sqrt(30. * temperature / (M_PI * Particle::getMass()));
+        std::sqrt(30. * temperature / (M_PI * mass));
 
     auto latticePosition = [=](size_t i) {
       // compute integer lattice coordinate
@@ -134,21 +222,25 @@ Gas::Gas(size_t particlesN, double temperature, double boxSideV, double timeV)
       return GSVectorD{x, y, z};
     };
 
-    size_t index{0};
+    // the last particle is added once the others are, without regrowing
+    particles.reserve(particlesN);
+    particles.resize(particlesN - 1);
     try {
-      std::generate_n(
-          std::back_inserter(particles), particlesN - 1, [=, &index]() {
-            Particle p{{latticePosition(index)}, unifRandVec(maxSpeed)};
-            ++index;
-            return p;
-          });
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, particlesN - 1),
+                        [&](tbb::blocked_range<size_t> const& r) {
+                          for (size_t i{r.begin()}; i != r.end(); ++i) {
+                            particles[i] = {
+                                GSVector<FP>{latticePosition(i)},
+                                GSVector<FP>{unifRandVec(maxSpeed, key, i)}};
+                          }
+                        });
     } catch (std::invalid_argument& e) {
-      liveInstances.fetch_sub(1);
+      GasProperties::liveInstances.fetch_sub(1);
       throw e;
     }
 
     // ensure as exact a final temperature as possible through the last particle
-    GSVectorD direction{unifRandVec(1.)};
+    GSVectorD direction{unifRandVec(1., key, particlesN - 1)};
     direction.normalize();
     double missingEnergy{
         3. * static_cast<double>(particlesN) * temperature / 2. -
@@ -165,33 +257,162 @@ Gas::Gas(size_t particlesN, double temperature, double boxSideV, double timeV)
       }
     }
     particles.emplace_back(Particle(
-        {latticePosition(particlesN - 1),
-         direction * std::sqrt(2. * missingEnergy / Particle::getMass())}));
+        {GSVector<FP>{latticePosition(particlesN - 1)},
+         GSVector<FP>{direction *
+                      std::sqrt(2. * missingEnergy / mass)}}));
   } else {
     if (static_cast<bool>(temperature)) {
       throw std::invalid_argument(
           "Gas constructor error: asked to reach a temperature with zero "
           "particles");
     }
-    liveInstances.fetch_add(1);
+    GasProperties::liveInstances.fetch_add(1);
+  }
+}
+
+// the last particles to collide may be a rounding error past a wall or each
+// other, so the checks allow for the precision of the gas
+template <typename FP>
+BasicGas<FP>::BasicGas(Checkpoint const& checkpoint)
+    : boxSide{checkpoint.boxSide}, time{checkpoint.time} {
+  if (checkpoint.radius != radius || checkpoint.mass != mass) {
+    throw std::invalid_argument(
+        "Gas constructor error: checkpoint particle radius or mass differ "
+        "from the current ones");
+  }
+  if (boxSide <= 0.) {
+    throw std::invalid_argument(
+        "Gas constructor error: non-positive box side provided");
+  }
+  particles.reserve(checkpoint.particles.size());
+  for (GS::Particle const& p : checkpoint.particles) {
+    particles.push_back({GSVector<FP>{p.position}, GSVector<FP>{p.speed}});
+  }
+
+  double const tolerance{std::sqrt(std::numeric_limits<FP>::epsilon()) *
+                         boxSide};
+  double const minPos{radius - tolerance};
+  double const maxPos{boxSide - radius + tolerance};
+  if (!std::all_of(particles.begin(), particles.end(), [&](Particle const& p) {
+        GSVectorD pos{p.position};
+        return minPos <= pos.x && pos.x <= maxPos && minPos <= pos.y &&
+               pos.y <= maxPos && minPos <= pos.z && pos.z <= maxPos;
+      })) {
+    throw std::invalid_argument(
+        "Gas constructor error: at least one of the checkpoint particles is "
+        "not inside of gas box");
+  }
+  if (anyOverlap(particles, boxSide, radius, tolerance)) {
+    throw std::invalid_argument(
+        "Gas constructor error: checkpoint holds overlapping particles");
   }
+  GasProperties::liveInstances.fetch_add(1);
 }
 
-Gas::Gas(Gas const& g)
-    : particles(g.particles), boxSide(g.boxSide), time(g.time) {
-  liveInstances.fetch_add(1);
+template <typename FP>
+BasicGas<FP>::BasicGas(BasicGas const& g)
+    : particles(g.particles),
+      boxSide(g.boxSide),
+      time(g.time),
+      radius(g.radius),
+      mass(g.mass),
+      collSearch(g.collSearch),
+      delayedState(g.delayedState),
+      calendar(g.calendar),
+      workerPool(g.workerPool) {
+  GasProperties::liveInstances.fetch_add(1);
 }
 
-Gas::Gas(Gas&& g) noexcept
-    : particles(std::move(g.particles)), boxSide(g.boxSide), time(g.time) {
-  liveInstances.fetch_add(1);
+template <typename FP>
+BasicGas<FP>::BasicGas(BasicGas&& g) noexcept
+    : particles(std::move(g.particles)),
+      boxSide(g.boxSide),
+      time(g.time),
+      radius(g.radius),
+      mass(g.mass),
+      collSearch(g.collSearch),
+      delayedState(g.delayedState),
+      calendar(std::move(g.calendar)),
+      workerPool(std::move(g.workerPool)) {
+  GasProperties::liveInstances.fetch_add(1);
 }
 
-void Gas::simulate(size_t itN, std::function<bool()> stopper) {
-  for (size_t i{0}; i < itN && !stopper(); ++i) {
-    PPCollision pColl{firstPPColl()};
-    PWCollision wColl{firstPWColl()};
-    Collision* firstColl{nullptr};
+template <typename FP>
+void BasicGas<FP>::setCollSearch(CollSearch search) {
+  if (search != collSearch) {
+    calendar.clear();
+    soa.clear();
+    collSearch = search;
+  }
+}
+
+template <typename FP>
+[[noreturn]] void throwBadCollTime(
+    std::vector<BasicParticle<FP>> const& particles, double collTime) {
+  if (particles.size() == 0) {
+    throw std::runtime_error("Simulate error: called simulate on an empty gas");
+  } else if (collTime < 0.) {
+    throw std::runtime_error(
+        "Simulate error: found negative collision time -> aborting");
+  } else {
+    bool allSpeeds0{true};
+    for (BasicParticle<FP> const& p : particles) {
+      if (allSpeeds0 && p.speed.norm() != 0) {
+        allSpeeds0 = false;
+      }
+    }
+    if (allSpeeds0) {
+      throw std::runtime_error(
+          "Simulate error: called on gas with no moving particles");
+    } else {
+      throw std::runtime_error(
+          "Simulate error: unexplained non finite collision time found -> "
+          "aborting");
+    }
+  }
+}
+
+template <typename FP>
+template <typename SolvedF>
+void BasicGas<FP>::solveNextColl(SolvedF&& onSolved) {
+  if (collSearch != CollSearch::bruteForce) {
+    if (!calendar.isBuilt()) {
+      calendar.build(particles, localTimes, boxSide, radius, time,
+                     collSearch == CollSearch::cellGrid, parallelPool());
+    }
+    CollisionCalendar::Event e{
+        calendar.nextEvent(particles, localTimes, boxSide, time)};
+    // the calendar stores absolute times, rounding can make them lag behind
+    double collTime{std::max(e.time - time, 0.)};
+    if (!std::isfinite(collTime)) {
+      syncAll();
+      throwBadCollTime(particles, collTime);
+    }
+    move(collTime);
+    if (e.type == CollisionCalendar::EventType::wall) {
+      sync(e.p1);
+      BasicPWCollision<FP> coll{collTime, &particles[e.p1], e.wall};
+      coll.solve();
+      calendar.update(particles, localTimes, boxSide, time);
+      onSolved(static_cast<BasicCollision<FP> const*>(&coll));
+    } else {
+      // same particle order as the brute force search
+      std::pair<size_t, size_t> pIs{std::minmax(e.p1, e.p2)};
+      sync(pIs.first);
+      sync(pIs.second);
+      BasicPPCollision<FP> coll{collTime, &particles[pIs.first],
+                                &particles[pIs.second]};
+      coll.solve();
+      calendar.update(particles, localTimes, boxSide, time);
+      onSolved(static_cast<BasicCollision<FP> const*>(&coll));
+    }
+  } else {
+    if (soa.size() != particles.size()) {
+      soa.assign(particles);
+    }
+    BasicPPCollision<FP> pColl{firstPPColl()};
+    BasicPWCollision<FP> wColl{firstPWColl()};
+    BasicCollision<FP>* firstColl{nullptr};
 
     if (pColl.getTime() < wColl.getTime()) {
       firstColl = &pColl;
@@ -202,138 +423,95 @@ void Gas::simulate(size_t itN, std::function<bool()> stopper) {
     double collTime{firstColl->getTime()};
 
     if (std::isfinite(collTime) && collTime >= 0.) {
-      move(firstColl->getTime());
+      move(collTime);
       firstColl->solve();
-    } else if (particles.size() == 0) {
-      throw std::runtime_error(
-          "Simulate error: called simulate on an empty gas");
-    } else if (collTime < 0.) {
-      throw std::runtime_error(
-          "Simulate error: found negative collision time -> aborting");
-    } else if (!std::isfinite(collTime)) {
-      bool allSpeeds0{true};
-      for (Particle const& p : particles) {
-        if (allSpeeds0 && p.speed.norm() != 0) {
-          allSpeeds0 = false;
-        }
-      }
-      if (allSpeeds0) {
-        throw std::runtime_error(
-            "Simulate error: called on gas with no moving particles");
-      } else {
-        throw std::runtime_error(
-            "Simulate error: unexplained non finite collision time found -> "
-            "aborting");
+      soa.set(static_cast<size_t>(firstColl->getP1() - particles.data()),
+              *firstColl->getP1());
+      if (firstColl == &pColl) {
+        soa.set(static_cast<size_t>(pColl.getP2() - particles.data()),
+                *pColl.getP2());
       }
+      onSolved(static_cast<BasicCollision<FP> const*>(firstColl));
+    } else {
+      throwBadCollTime(particles, collTime);
     }
   }
 }
 
-void Gas::simulate(size_t itN, SimDataPipeline& output,
-                   std::function<bool()> stopper) {
+template <typename FP>
+void BasicGas<FP>::simulate(size_t itN, std::function<bool()> stopper) {
+  localTimes.assign(particles.size(), time);
+  for (size_t i{0}; i < itN && !stopper(); ++i) {
+    solveNextColl([](BasicCollision<FP> const*) {});
+  }
+  syncAll();
+}
+
+template <typename FP>
+void BasicGas<FP>::simulate(size_t itN, SimDataPipeline& output,
+                            std::function<bool()> stopper) {
   std::vector<GasData> tempOutput{};
   tempOutput.reserve(output.getStatSize());
+  localTimes.assign(particles.size(), time);
+  bool const frameSnapshots{output.getFrameSnapshots()};
+  double const frameDeltaT{1. / output.getFramerate()};
+  // on the frame grid of the pipeline, which starts at the current time when
+  // it has none yet
+  std::optional<double> gTime{output.getGTime()};
+  double nextFrame{gTime.has_value() ? *gTime + frameDeltaT : time};
 
   for (size_t i{0}; i < itN && !stopper();) {
     for (size_t j{0}; j < output.getStatSize() && i < itN && !stopper();
          ++j, ++i) {
-      PPCollision pColl{firstPPColl()};
-      PWCollision wColl{firstPWColl()};
-      Collision* firstColl{nullptr};
-
-      if (pColl.getTime() < wColl.getTime()) {
-        firstColl = &pColl;
-      } else {
-        firstColl = &wColl;
-      }
-
-      double collTime{firstColl->getTime()};
-
-      if (std::isfinite(collTime) && collTime >= 0.) {
-        move(firstColl->getTime());
-        firstColl->solve();
-        tempOutput.emplace_back(GasData(*this, firstColl));
-      } else if (particles.size() == 0) {
-        throw std::runtime_error(
-            "Simulate error: called simulate on an empty gas");
-      } else if (collTime < 0.) {
-        throw std::runtime_error(
-            "Simulate error: found negative collision time found -> aborting");
-      } else if (!std::isfinite(collTime)) {
-        bool allSpeeds0{true};
-        for (Particle const& p : particles) {
-          if (allSpeeds0 && p.speed.norm() != 0) {
-            allSpeeds0 = false;
+      solveNextColl([&](BasicCollision<FP> const* coll) {
+        // keyframes need every particle at the current time
+        bool keyframe{!j};
+        if (frameSnapshots) {
+          // first event at or after each frame, the one the frame is drawn
+          // from, and the first of the call, which may start the pipeline
+          // state
+          keyframe = !i || time >= nextFrame;
+          while (nextFrame <= time) {
+            nextFrame += frameDeltaT;
           }
         }
-        if (allSpeeds0) {
-          throw std::runtime_error(
-              "Simulate error: called on gas with no moving particles");
-        } else {
-          throw std::runtime_error(
-              "Simulate error: unexplained non finite collision time found -> "
-              "aborting");
+        if (keyframe) {
+          syncAll();
         }
-      }
+        tempOutput.emplace_back(*this, coll, keyframe);
+      });
     }
+    // leaves the buffer to be filled again
     output.addData(std::move(tempOutput));
-    tempOutput.clear();
   }
 
+  syncAll();
   output.setDone();
 }
 
-std::vector<GasData> Gas::rawDataSimulate(size_t itN) {
+template <typename FP>
+std::vector<GasData> BasicGas<FP>::rawDataSimulate(size_t itN) {
   std::vector<GasData> tempOutput{};
   tempOutput.reserve(itN);
+  localTimes.assign(particles.size(), time);
 
   for (size_t i{0}; i < itN; ++i) {
-    PPCollision pColl{firstPPColl()};
-    PWCollision wColl{firstPWColl()};
-    Collision* firstColl{nullptr};
-
-    if (pColl.getTime() < wColl.getTime()) {
-      firstColl = &pColl;
-    } else {
-      firstColl = &wColl;
-    }
-
-    double collTime{firstColl->getTime()};
-
-    if (std::isfinite(collTime) && collTime >= 0.) {
-      move(firstColl->getTime());
-      firstColl->solve();
-      tempOutput.emplace_back(*this, firstColl);
-    } else if (particles.size() == 0) {
-      throw std::runtime_error(
-          "Simulate error: called simulate on an empty gas");
-    } else if (collTime < 0.) {
-      throw std::runtime_error(
-          "Simulate error: found negative collision time found -> aborting");
-    } else if (!std::isfinite(collTime)) {
-      bool allSpeeds0{true};
-      for (Particle const& p : particles) {
-        if (allSpeeds0 && p.speed.norm() != 0) {
-          allSpeeds0 = false;
-        }
-      }
-      if (allSpeeds0) {
-        throw std::runtime_error(
-            "Simulate error: called on gas with no moving particles");
-      } else {
-        throw std::runtime_error(
-            "Simulate error: unexplained non finite collision time found -> "
-            "aborting");
+    solveNextColl([&](BasicCollision<FP> const* coll) {
+      if (!i) {
+        syncAll();
       }
-    }
+      tempOutput.emplace_back(*this, coll, !i);
+    });
   }
+  syncAll();
   return tempOutput;
 }
 
-bool Gas::contains(Particle const& p) {
+template <typename FP>
+bool BasicGas<FP>::contains(Particle const& p) {
   if (particles.size()) {
-    double r = p.getRadius();
-    GSVectorD pos = p.position;
+    double r = radius;
+    GSVectorD pos{p.position};
     return (r < pos.x && pos.x < boxSide - r && r < pos.y &&
             pos.y < boxSide - r && r < pos.z && pos.z < boxSide - r &&
             &particles.front() <= &p && &p <= &particles.back());
@@ -342,44 +520,47 @@ bool Gas::contains(Particle const& p) {
   }
 }
 
-PWCollision Gas::firstPWColl() {
+// earliest wall collision of a single particle
+template <typename FP>
+std::pair<double, Wall> wallCollTime(BasicParticle<FP> const& p,
+                                     double boxSide, double radius) {
   // elementary auxiliary lambda
-  auto getPWCollision{[&, this](double position, double speed, Wall negWall,
-                                Wall posWall, Particle* p) -> PWCollision {
+  auto getPWCollTime{[&](double position, double speed, Wall negWall,
+                         Wall posWall) -> std::pair<double, Wall> {
     // walls are implemented as the xy, yz, xz planes and their parallels,
     // shifted by the box side
     double cTime = (speed < 0)
-                       ? (position - Particle::getRadius()) / (-speed)
-                       : (boxSide - Particle::getRadius() - position) / speed;
+                       ? (position - radius) / (-speed)
+                       : (boxSide - radius - position) / speed;
     Wall wall = (speed < 0) ? negWall : posWall;
-    return {cTime, p, wall};
+    return {cTime, wall};
   }};
 
-  // second elementary auxiliary lambda
-  auto getWallColl{[&](Particle* p) {
-    PWCollision result =
-        getPWCollision(p->position.x, p->speed.x, Wall::Left, Wall::Right, p);
-    PWCollision collY =
-        getPWCollision(p->position.y, p->speed.y, Wall::Front, Wall::Back, p);
-    PWCollision collZ =
-        getPWCollision(p->position.z, p->speed.z, Wall::Bottom, Wall::Top, p);
-
-    if (result.getTime() > collY.getTime()) {
-      result = collY;
-    }
-    if (result.getTime() > collZ.getTime()) {
-      result = collZ;
-    }
+  std::pair<double, Wall> result{
+      getPWCollTime(p.position.x, p.speed.x, Wall::Left, Wall::Right)};
+  std::pair<double, Wall> collY{
+      getPWCollTime(p.position.y, p.speed.y, Wall::Front, Wall::Back)};
+  std::pair<double, Wall> collZ{
+      getPWCollTime(p.position.z, p.speed.z, Wall::Bottom, Wall::Top)};
 
-    return result;
-  }};
+  if (result.first > collY.first) {
+    result = collY;
+  }
+  if (result.first > collZ.first) {
+    result = collZ;
+  }
+
+  return result;
+}
 
-  PWCollision firstColl{INFINITY, nullptr, Wall::Front};
+template <typename FP>
+BasicPWCollision<FP> BasicGas<FP>::firstPWColl() {
+  BasicPWCollision<FP> firstColl{INFINITY, nullptr, Wall::Front};
 
   std::for_each(particles.begin(), particles.end(), [&](Particle& p) {
-    PWCollision c{getWallColl(&p)};
-    if (c.getTime() < firstColl.getTime()) {
-      firstColl = c;
+    std::pair<double, Wall> c{wallCollTime(p, boxSide, radius)};
+    if (c.first < firstColl.getTime()) {
+      firstColl = {c.first, &p, c.second};
     }
   });
   if (!firstColl.getP1() && !particles.size()) {
@@ -391,23 +572,26 @@ PWCollision Gas::firstPWColl() {
   return firstColl;
 }
 
-double collisionTime(Particle const& p1, Particle const& p2) {
-  GSVectorD relPos = p1.position - p2.position;
-  GSVectorD relSpd = p1.speed - p2.speed;
+// computed in FP, as the brute force kernel does
+template <typename FP>
+double collisionTime(BasicParticle<FP> const& p1, BasicParticle<FP> const& p2,
+                     double radius) {
+  GSVector<FP> relPos = p1.position - p2.position;
+  GSVector<FP> relSpd = p1.speed - p2.speed;
 
-  double a = relSpd * relSpd;
-  double b = relPos * relSpd;
-  double c = (relPos * relPos) - 4 * std::pow(Particle::getRadius(), 2);
+  FP a = relSpd * relSpd;
+  FP b = relPos * relSpd;
+  FP c = (relPos * relPos) - static_cast<FP>(4. * (radius * radius));
 
   double result = INFINITY;
 
-  double delta = std::pow(b, 2) - a * c;
+  FP delta = b * b - a * c;
 
   if (delta > 0) {
-    double deltaSqrt = std::sqrt(delta);
+    FP deltaSqrt = std::sqrt(delta);
 
-    double t1 = (-b - deltaSqrt) / a;
-    double t2 = (-b + deltaSqrt) / a;
+    FP t1 = (-b - deltaSqrt) / a;
+    FP t2 = (-b + deltaSqrt) / a;
 
     if (t1 > 0) {
       result = t1;
@@ -418,6 +602,12 @@ double collisionTime(Particle const& p1, Particle const& p2) {
   return result;
 }
 
+template <typename FP>
+double collisionTime(BasicParticle<FP> const& p1,
+                     BasicParticle<FP> const& p2) {
+  return collisionTime(p1, p2, Particle::getRadius());
+}
+
 // triangular indexing function for set of n elements
 auto trIndex(std::size_t i, std::size_t nEls) {
   const double di = static_cast<double>(i);
@@ -435,19 +625,22 @@ auto trIndex(std::size_t i, std::size_t nEls) {
   return std::pair<size_t, size_t>(rowIndex, colIndex);
 }
 
-PPCollision Gas::firstPPColl() {
-  // collision compare-and-choose lambda
-  auto getBestPPCollision{[](PPCollision& c, Particle* p1, Particle* p2) {
-    GSVectorD relPos{p1->position - p2->position};
-    const GSVectorD relSpd{p1->speed - p2->speed};
-    if (relPos * relSpd <= 0.) {
-      double cTime{collisionTime(*p1, *p2)};
-      if (cTime < c.getTime()) {
-        c = {collisionTime(*p1, *p2), p1, p2};
-      }
-    }
-  }};
+// waking up the workers costs more than the checks themselves for few
+// particles
+template <typename FP>
+WorkerPool* BasicGas<FP>::parallelPool() {
+  if (particles.size() < GasProperties::parallelThreshold.load() ||
+      (workerPool && workerPool->getThreadsN() < 2)) {
+    return nullptr;
+  }
+  if (!workerPool) {
+    workerPool = std::make_shared<WorkerPool>();
+  }
+  return workerPool.get();
+}
 
+template <typename FP>
+BasicPPCollision<FP> BasicGas<FP>::firstPPColl() {
   size_t nP{particles.size()};
 
   if (!nP) {
@@ -455,68 +648,145 @@ PPCollision Gas::firstPPColl() {
         "firstPPColl error: tried to get particle collision from empty gas");
   }
 
-  size_t nChecks{nP * (nP - 1) / 2};
+  assert(soa.size() == nP);
+  double const diameter2{4. * (radius * radius)};
+
+  // checks the couples (row, first)...(row, last - 1)
+  auto checkRow{[&](BasicPPCollision<FP>& c, size_t row, size_t first,
+                    size_t last) {
+    std::pair<double, size_t> coll{
+        firstCollision(soa, row, first, last, diameter2)};
+    if (coll.first < c.getTime()) {
+      c = {coll.first, particles.data() + row,
+           particles.data() + coll.second};
+    }
+  }};
+
+  BasicPPCollision<FP> best{INFINITY, nullptr, nullptr};
 
-  size_t nThreads{std::thread::hardware_concurrency()};
+  WorkerPool* pool{parallelPool()};
+  if (!pool) {
+    for (size_t i{0}; i < nP; ++i) {
+      checkRow(best, i, i + 1, nP);
+    }
+    return best;
+  }
+
+  // padded so that workers never write on the same cache line
+  struct alignas(64) BestSlot {
+    BasicPPCollision<FP> coll{INFINITY, nullptr, nullptr};
+  };
+
+  size_t nChecks{nP * (nP - 1) / 2};
+  size_t nThreads{pool->getThreadsN()};
   size_t checksPerThread{nChecks / nThreads};
   size_t extraChecks{nChecks % nThreads};
-
-  std::vector<std::thread> threads{};
-  threads.reserve(nThreads);
-  std::mutex bestCollsMtx;
-  std::vector<PPCollision> bestColls(nThreads, {INFINITY, nullptr, nullptr});
+  std::vector<BestSlot> bestColls(nThreads);
 
   // concurrent access on particles is read-only
-  // first thread with extra checks
-  threads.emplace(threads.begin(), [&]() {
-    PPCollision c{INFINITY, nullptr, nullptr};
-    size_t endIndex{checksPerThread + extraChecks};
-    for (size_t i{0}; i < endIndex; ++i) {
+  // first worker with extra checks
+  pool->run([&](size_t thrI) {
+    BasicPPCollision<FP> c{INFINITY, nullptr, nullptr};
+    size_t i{thrI ? thrI * checksPerThread + extraChecks : 0};
+    size_t endIndex{(thrI + 1) * checksPerThread + extraChecks};
+    if (i < endIndex) {
+      // the triangular range is split in row segments for the kernel
       std::pair<size_t, size_t> trI{trIndex(i, nP)};
-      getBestPPCollision(c, particles.data() + trI.first,
-                         particles.data() + trI.second);
+      size_t remaining{endIndex - i};
+      for (size_t row{trI.first}, col{trI.second}; remaining;
+           ++row, col = row + 1) {
+        size_t last{std::min(nP, col + remaining)};
+        checkRow(c, row, col, last);
+        remaining -= last - col;
+      }
     }
-    std::lock_guard<std::mutex> bestCollsGuard{bestCollsMtx};
-    bestColls[0] = c;
+    bestColls[thrI].coll = c;
   });
 
-  if (checksPerThread) {
-    // other threads with normal checks number
-    for (size_t threadIndex{1}; threadIndex < nThreads; ++threadIndex) {
-      size_t thrI{threadIndex};
-      threads.emplace(threads.begin() + static_cast<long>(thrI), [&, thrI]() {
-        PPCollision c{INFINITY, nullptr, nullptr};
-        size_t i{thrI * checksPerThread + extraChecks};
-        size_t endIndex{(thrI + 1) * checksPerThread + extraChecks};
-        for (; i < endIndex; ++i) {
-          std::pair<size_t, size_t> trngI{trIndex(i, nP)};
-          getBestPPCollision(c, particles.data() + trngI.first,
-                             particles.data() + trngI.second);
-        }
-        std::lock_guard<std::mutex> bestCollsGuard{bestCollsMtx};
-        bestColls[thrI] = c;
-      });
+  for (BestSlot const& slot : bestColls) {
+    if (slot.coll.getTime() < best.getTime()) {
+      best = slot.coll;
     }
   }
+  return best;
+}
 
-  for (auto& t : threads) {
-    if (t.joinable()) {
-      t.join();
+template <typename FP>
+GasMemoryUsage BasicGas<FP>::memoryUsage() const {
+  return {particles.capacity() * sizeof(Particle) +
+              localTimes.capacity() * sizeof(double),
+          calendar.memoryUsage(), soa.memoryUsage()};
+}
+
+// the calendar holds about eventsPerParticle events for each particle, the
+// invalidated ones waiting to be popped included, the grid about a cell for
+// each particle
+template <typename FP>
+GasMemoryUsage BasicGas<FP>::estimateMemory(size_t particlesN,
+                                            CollSearch search) {
+  constexpr size_t eventsPerParticle{4};
+  GasMemoryUsage usage{};
+  usage.particles = particlesN * (sizeof(Particle) + sizeof(double));
+  if (search == CollSearch::bruteForce) {
+    size_t width{ParticleSoA<FP>::simdWidth};
+    usage.soa = 6 * ((particlesN + width - 1) / width * width) * sizeof(FP);
+  } else {
+    usage.calendar =
+        particlesN * (eventsPerParticle * sizeof(CollisionCalendar::Event) +
+                      sizeof(size_t) + sizeof(double));
+    if (search == CollSearch::cellGrid) {
+      usage.calendar += particlesN * (sizeof(std::vector<size_t>) +
+                                      2 * sizeof(size_t));
     }
   }
-
-  return *std::min_element(bestColls.begin(), bestColls.end(),
-                           [](PPCollision const& c1, PPCollision const& c2) {
-                             return c1.getTime() < c2.getTime();
-                           });
+  return usage;
 }
 
-void Gas::move(double dt) {
+template <typename FP>
+void BasicGas<FP>::move(double dt) {
   assert(dt != INFINITY);
   assert(dt >= 0);
-  std::for_each(particles.begin(), particles.end(),
-                [dt](Particle& p) { p.position += p.speed * dt; });
   time += dt;
+  // the brute force search reads every particle at each iteration anyway
+  if (!delayedState || collSearch == CollSearch::bruteForce) {
+    for (size_t i{0}; i < particles.size(); ++i) {
+      particles[i].position += particles[i].speed * static_cast<FP>(dt);
+      localTimes[i] = time;
+    }
+  }
+  if (collSearch == CollSearch::bruteForce) {
+    soa.move(static_cast<FP>(dt));
+  }
 }
 
+template <typename FP>
+void BasicGas<FP>::sync(size_t pI) {
+  particles[pI].position +=
+      particles[pI].speed * static_cast<FP>(time - localTimes[pI]);
+  localTimes[pI] = time;
+}
+
+template <typename FP>
+void BasicGas<FP>::syncAll() {
+  if (delayedState && collSearch != CollSearch::bruteForce) {
+    for (size_t i{0}; i < particles.size(); ++i) {
+      sync(i);
+    }
+  }
+}
+
+template class BasicGas<float>;
+template class BasicGas<double>;
+
+template double collisionTime(ParticleF const& p1, ParticleF const& p2,
+                              double radius);
+template double collisionTime(Particle const& p1, Particle const& p2,
+                              double radius);
+template double collisionTime(ParticleF const& p1, ParticleF const& p2);
+template double collisionTime(Particle const& p1, Particle const& p2);
+template std::pair<double, Wall> wallCollTime(ParticleF const& p,
+                                              double boxSide, double radius);
+template std::pair<double, Wall> wallCollTime(Particle const& p,
+                                              double boxSide, double radius);
+
 }  // namespace GS
@@ -1,36 +1,84 @@
 #ifndef GAS_HPP
 #define GAS_HPP
 
+#include <atomic>
 #include <cstddef>
 #include <functional>
+#include <memory>
+#include <optional>
 #include <vector>
 
 #include "Collision.hpp"
+#include "CollisionCalendar.hpp"
 #include "Particle.hpp"
+#include "ParticleSoA.hpp"
+#include "WorkerPool.hpp"
 
 namespace GS {
 
 class GasData;
 class SimDataPipeline;
+struct Checkpoint;
 
-class Gas {
+// bruteForce rescans every couple at each iteration, calendar only re-predicts
+// the collisions of the particles involved in the last one, cellGrid also
+// restricts the predictions to the particles in neighbouring cells
+enum class CollSearch { bruteForce, calendar, cellGrid };
+
+// bytes held by a gas, its shared worker pool left out
+struct GasMemoryUsage {
+  size_t particles{0};  // local times included
+  size_t calendar{0};
+  size_t soa{0};
+  size_t total() const { return particles + calendar + soa; }
+};
+
+// live instances count and parallel search threshold, shared by the gases of
+// every precision
+class GasProperties {
+  inline static std::atomic<size_t> liveInstances{0};
+  inline static std::atomic<size_t> parallelThreshold{128};
+
+  template <typename FP>
+  friend class BasicGas;
+};
+
+// particles positions and speeds use FP, times and the quantities derived
+// from them stay in double
+template <typename FP>
+class BasicGas {
  public:
-  Gas() : boxSide{1.}, time{0.} { liveInstances.fetch_add(1); }
-  Gas(std::vector<Particle>&& particles, double boxSide, double time = 0.);
-  Gas(size_t particlesN, double temperature, double boxSide,
-      double time = 0.);  // random parametric constructor
-  ~Gas() { liveInstances.fetch_sub(1); }
+  using Particle = BasicParticle<FP>;
 
-  Gas(Gas const&);
-  Gas& operator=(Gas const&) = default;
-  Gas(Gas&&) noexcept;
-  Gas& operator=(Gas&&) noexcept = default;
+  BasicGas() : boxSide{1.}, time{0.} {
+    GasProperties::liveInstances.fetch_add(1);
+  }
+  // overlaps are checked on a grid, in linear time
+  BasicGas(std::vector<Particle>&& particles, double boxSide,
+           double time = 0.);
+  // random parametric constructor, generated in parallel, seeded ones are
+  // reproducible whatever the number of threads
+  BasicGas(size_t particlesN, double temperature, double boxSide,
+           double time = 0., std::optional<unsigned> seed = {});
+  // resumes a checkpointed run, particle radius and mass must match its ones
+  explicit BasicGas(Checkpoint const& checkpoint);
+  ~BasicGas() { GasProperties::liveInstances.fetch_sub(1); }
+
+  BasicGas(BasicGas const&);
+  BasicGas& operator=(BasicGas const&) = default;
+  BasicGas(BasicGas&&) noexcept;
+  BasicGas& operator=(BasicGas&&) noexcept = default;
 
   void simulate(
       size_t iterationsN, std::function<bool()> stopper = [] { return false; });
+  // data is added in batches of the output stat size, each one starting with
+  // a keyframe, or, with the output frame snapshots on, with keyframes only at
+  // the first event and at the first one after each frame, frames being
+  // counted from the gas time at the call
   void simulate(
       size_t iterationsN, SimDataPipeline& SimOutput,
       std::function<bool()> stopper = [] { return false; });
+  // only the first record is a keyframe
   std::vector<GS::GasData> rawDataSimulate(
       size_t iterationsN);  // mainly for testing purposes
   bool contains(const Particle& p);
@@ -38,20 +86,75 @@ class Gas {
   const std::vector<Particle>& getParticles() const { return particles; }
   double getBoxSide() const { return boxSide; }
   double getTime() const { return time; }
+  // particle radius and mass read at construction, the collision searches use
+  // these instead of the shared atomic ones
+  // the radius can't change while gases exist, a later setMass only affects
+  // the gases built after it
+  double getRadius() const { return radius; }
+  double getMass() const { return mass; }
+  CollSearch getCollSearch() const { return collSearch; }
+  void setCollSearch(CollSearch search);
+  // with a delayed state the calendar searches only move the particles
+  // involved in each event, the others are brought to the current time when a
+  // snapshot is taken, and always at the end of a simulate call
+  bool getDelayedState() const { return delayedState; }
+  void setDelayedState(bool delayed) { delayedState = delayed; }
+  // the brute force search and the first predictions of the calendar
+  // searches use a pool shared between copies, created with one thread per
+  // hardware thread when first needed if none was set
+  // the calendar searches handle each event on the calling thread
+  std::shared_ptr<WorkerPool> getWorkerPool() const { return workerPool; }
+  void setWorkerPool(std::shared_ptr<WorkerPool> pool) {
+    workerPool = std::move(pool);
+  }
 
-  static size_t gasInstances() { return liveInstances.load(); }
+  GasMemoryUsage memoryUsage() const;
+  // expected usage of a gas of particlesN particles searching with search
+  static GasMemoryUsage estimateMemory(
+      size_t particlesN, CollSearch search = CollSearch::cellGrid);
 
- private:
-  inline static std::atomic<size_t> liveInstances{0};
+  // counts the gases of every precision
+  static size_t gasInstances() {
+    return GasProperties::liveInstances.load();
+  }
+  // particles number below which the searches stay single threaded
+  static size_t getParallelThreshold() {
+    return GasProperties::parallelThreshold.load();
+  }
+  static void setParallelThreshold(size_t n) {
+    GasProperties::parallelThreshold.store(n);
+  }
 
-  PWCollision firstPWColl();
-  PPCollision firstPPColl();
+ private:
+  BasicPWCollision<FP> firstPWColl();
+  BasicPPCollision<FP> firstPPColl();
+  // the worker pool if worth waking up for this gas, nullptr otherwise
+  WorkerPool* parallelPool();
   void move(double dt);
+  void sync(size_t pI);
+  void syncAll();
+  template <typename SolvedF>
+  void solveNextColl(SolvedF&& onSolved);
 
   std::vector<Particle> particles{};
   double boxSide;
   double time;
+  double radius{Particle::getRadius()};
+  double mass{Particle::getMass()};
+  CollSearch collSearch{CollSearch::cellGrid};
+  bool delayedState{true};
+  std::vector<double> localTimes{};  // time of each particle's position
+  CollisionCalendar calendar{};
+  std::shared_ptr<WorkerPool> workerPool{};
+  // component-wise particles read by the brute force search, moved and
+  // updated along with them
+  ParticleSoA<FP> soa{};
 };
+
+using Gas = BasicGas<double>;
+// single precision gas, about half the memory traffic of Gas
+using GasF = BasicGas<float>;
+
 }  // namespace GS
 
 #endif
@@ -7,16 +7,18 @@
 
 namespace GS {
 
-void Particle::setMass(double m) {
+template <typename FP>
+void BasicParticle<FP>::setMass(double m) {
   if (m <= 0.) {
     throw std::invalid_argument(
         "Particle setMass error: non-positive mass provided");
   } else {
-    mass.store(m);
+    ParticleProperties::mass.store(m);
   }
 }
 
-void Particle::setRadius(double r) {
+template <typename FP>
+void BasicParticle<FP>::setRadius(double r) {
   if (r <= 0.) {
     throw std::invalid_argument(
         "Particle setRadius error: non-positive mass provided");
@@ -25,20 +27,49 @@ void Particle::setRadius(double r) {
         "Particle setRadius error: tried to change radius with " +
         std::to_string(Gas::gasInstances()) + " alive Gas instances");
   } else {
-    radius.store(r);
+    ParticleProperties::radius.store(r);
   }
 }
 
-bool overlap(Particle const& p1, Particle const& p2) {
-  return (p1.position - p2.position).norm() < 2. * Particle::getRadius();
+template <typename FP>
+bool overlap(BasicParticle<FP> const& p1, BasicParticle<FP> const& p2) {
+  return overlap(p1, p2, Particle::getRadius());
 }
 
-double energy(Particle const& p) {
-  return p.getMass() * p.speed * p.speed / 2.;
+template <typename FP>
+bool overlap(BasicParticle<FP> const& p1, BasicParticle<FP> const& p2,
+             double radius) {
+  return (p1.position - p2.position).norm() < 2. * radius;
 }
 
-bool operator==(Particle const& p1, Particle const& p2) {
+template <typename FP>
+double energy(BasicParticle<FP> const& p) {
+  return energy(p, Particle::getMass());
+}
+
+template <typename FP>
+double energy(BasicParticle<FP> const& p, double mass) {
+  GSVectorD speed{p.speed};
+  return mass * speed * speed / 2.;
+}
+
+template <typename FP>
+bool operator==(BasicParticle<FP> const& p1, BasicParticle<FP> const& p2) {
   return p1.position == p2.position && p1.speed == p2.speed;
 }
 
+template struct BasicParticle<float>;
+template struct BasicParticle<double>;
+
+template bool overlap(ParticleF const& p1, ParticleF const& p2);
+template bool overlap(Particle const& p1, Particle const& p2);
+template bool overlap(ParticleF const& p1, ParticleF const& p2, double radius);
+template bool overlap(Particle const& p1, Particle const& p2, double radius);
+template double energy(ParticleF const& p);
+template double energy(Particle const& p);
+template double energy(ParticleF const& p, double mass);
+template double energy(Particle const& p, double mass);
+template bool operator==(ParticleF const& p1, ParticleF const& p2);
+template bool operator==(Particle const& p1, Particle const& p2);
+
 }  // namespace GS
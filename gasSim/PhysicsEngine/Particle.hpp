@@ -7,24 +7,46 @@
 
 namespace GS {
 
-struct Particle {
-  GSVectorD position;
-  GSVectorD speed;
+template <typename FP>
+struct BasicParticle;
 
-  static double getMass() { return mass.load(); }
-  static void setMass(double m);
-  static double getRadius() { return radius.load(); }
-  static void setRadius(double r);
-
- private:
+// radius and mass storage, shared by the particles of every precision
+class ParticleProperties {
   inline static std::atomic<double> radius{1.};
   inline static std::atomic<double> mass{1.};
+
+  template <typename FP>
+  friend struct BasicParticle;
 };
 
-bool overlap(Particle const& p1, Particle const& p2);
-double energy(Particle const& p);
+// positions and speeds use FP, everything else stays in double
+template <typename FP>
+struct BasicParticle {
+  GSVector<FP> position;
+  GSVector<FP> speed;
+
+  static double getMass() { return ParticleProperties::mass.load(); }
+  static void setMass(double m);
+  static double getRadius() { return ParticleProperties::radius.load(); }
+  static void setRadius(double r);
+};
 
-bool operator==(Particle const& p1, Particle const& p2);
+using Particle = BasicParticle<double>;
+using ParticleF = BasicParticle<float>;
+
+template <typename FP>
+bool overlap(BasicParticle<FP> const& p1, BasicParticle<FP> const& p2);
+template <typename FP>
+double energy(BasicParticle<FP> const& p);
+// same as above with a given radius or mass, for loops that read it only once
+template <typename FP>
+bool overlap(BasicParticle<FP> const& p1, BasicParticle<FP> const& p2,
+             double radius);
+template <typename FP>
+double energy(BasicParticle<FP> const& p, double mass);
+
+template <typename FP>
+bool operator==(BasicParticle<FP> const& p1, BasicParticle<FP> const& p2);
 
 }  // namespace GS
 
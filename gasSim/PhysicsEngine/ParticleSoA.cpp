@@ -0,0 +1,466 @@
+#include "ParticleSoA.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// the simd kernels are compiled for their instruction sets whatever the
+// target of the build, and picked at run time by the host cpu
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define GS_SIMD_DISPATCH
+#include <immintrin.h>
+#endif
+
+#include "PhysicsEngine/Particle.hpp"
+
+namespace GS {
+
+template <typename FP>
+void ParticleSoA<FP>::assign(
+    std::vector<BasicParticle<FP>> const& particles) {
+  nP = particles.size();
+  size_t padded{(nP + simdWidth - 1) / simdWidth * simdWidth};
+  FP const nan{std::numeric_limits<FP>::quiet_NaN()};
+  for (Array* a : {&x, &y, &z, &vx, &vy, &vz}) {
+    a->assign(padded, nan);
+  }
+  for (size_t i{0}; i < nP; ++i) {
+    set(i, particles[i]);
+  }
+}
+
+template <typename FP>
+void ParticleSoA<FP>::clear() {
+  for (Array* a : {&x, &y, &z, &vx, &vy, &vz}) {
+    *a = Array{};
+  }
+  nP = 0;
+}
+
+template <typename FP>
+void ParticleSoA<FP>::set(size_t i, BasicParticle<FP> const& p) {
+  x[i] = p.position.x;
+  y[i] = p.position.y;
+  z[i] = p.position.z;
+  vx[i] = p.speed.x;
+  vy[i] = p.speed.y;
+  vz[i] = p.speed.z;
+}
+
+// the padding stays NaN
+template <typename FP>
+void ParticleSoA<FP>::move(FP dt) {
+  size_t padded{paddedSize()};
+  for (size_t i{0}; i < padded; ++i) {
+    x[i] += vx[i] * dt;
+    y[i] += vy[i] * dt;
+    z[i] += vz[i] * dt;
+  }
+}
+
+template <typename FP>
+std::pair<double, size_t> firstCollisionScalar(ParticleSoA<FP> const& soa,
+                                               size_t i, size_t first,
+                                               size_t last, double diameter2) {
+  std::pair<double, size_t> best{INFINITY, last};
+  FP const d2{static_cast<FP>(diameter2)};
+  FP const xi{soa.x[i]};
+  FP const yi{soa.y[i]};
+  FP const zi{soa.z[i]};
+  FP const vxi{soa.vx[i]};
+  FP const vyi{soa.vy[i]};
+  FP const vzi{soa.vz[i]};
+  for (size_t j{first}; j < last; ++j) {
+    FP rx{xi - soa.x[j]};
+    FP ry{yi - soa.y[j]};
+    FP rz{zi - soa.z[j]};
+    FP sx{vxi - soa.vx[j]};
+    FP sy{vyi - soa.vy[j]};
+    FP sz{vzi - soa.vz[j]};
+    FP b{rx * sx + ry * sy + rz * sz};
+    if (!(b <= 0)) {
+      continue;
+    }
+    FP a{sx * sx + sy * sy + sz * sz};
+    FP c{(rx * rx + ry * ry + rz * rz) - d2};
+    FP delta{b * b - a * c};
+    if (delta > 0) {
+      FP deltaSqrt{std::sqrt(delta)};
+      FP t1{(-b - deltaSqrt) / a};
+      FP t2{(-b + deltaSqrt) / a};
+      FP t{t1 > 0 ? t1 : (t2 > 0 ? t2 : FP{INFINITY})};
+      if (t < best.first) {
+        best = {t, j};
+      }
+    }
+  }
+  return best;
+}
+
+// merges the per-lane bests of a simd search and checks the couples left
+// after its last whole vector, j being the first of them
+template <typename FP, typename Index, size_t w>
+std::pair<double, size_t> finishSearch(ParticleSoA<FP> const& soa, size_t i,
+                                       size_t j, size_t last,
+                                       double diameter2, FP const (&times)[w],
+                                       Index const (&indexes)[w]) {
+  std::pair<double, size_t> result{INFINITY, last};
+  for (size_t l{0}; l < w; ++l) {
+    size_t index{static_cast<size_t>(indexes[l])};
+    if (times[l] < result.first ||
+        (times[l] == result.first && index < result.second)) {
+      result = {times[l], index};
+    }
+  }
+  if (j < last) {
+    std::pair<double, size_t> tail{
+        firstCollisionScalar(soa, i, j, last, diameter2)};
+    if (tail.first < result.first) {
+      result = tail;
+    }
+  }
+  return result;
+}
+
+#ifdef GS_SIMD_DISPATCH
+
+__attribute__((target("avx512f"))) std::pair<double, size_t>
+firstCollisionAVX512(ParticleSoA<double> const& soa, size_t i, size_t first,
+                     size_t last, double diameter2) {
+  constexpr size_t w{8};
+  // the NaN padding lets the last partial vector be loaded whole
+  size_t end{last == soa.size() ? soa.paddedSize() : last};
+  __m512d const xi{_mm512_set1_pd(soa.x[i])};
+  __m512d const yi{_mm512_set1_pd(soa.y[i])};
+  __m512d const zi{_mm512_set1_pd(soa.z[i])};
+  __m512d const vxi{_mm512_set1_pd(soa.vx[i])};
+  __m512d const vyi{_mm512_set1_pd(soa.vy[i])};
+  __m512d const vzi{_mm512_set1_pd(soa.vz[i])};
+  __m512d const d2{_mm512_set1_pd(diameter2)};
+  __m512d const zero{_mm512_setzero_pd()};
+  __m512d const inf{_mm512_set1_pd(INFINITY)};
+  __m512d const step{_mm512_set1_pd(static_cast<double>(w))};
+  __m512d best{inf};
+  __m512d bestIdx{_mm512_set1_pd(static_cast<double>(last))};
+  __m512d idx{_mm512_add_pd(_mm512_set1_pd(static_cast<double>(first)),
+                            _mm512_set_pd(7., 6., 5., 4., 3., 2., 1., 0.))};
+
+  size_t j{first};
+  for (; j + w <= end; j += w) {
+    __m512d rx{_mm512_sub_pd(xi, _mm512_loadu_pd(soa.x.data() + j))};
+    __m512d ry{_mm512_sub_pd(yi, _mm512_loadu_pd(soa.y.data() + j))};
+    __m512d rz{_mm512_sub_pd(zi, _mm512_loadu_pd(soa.z.data() + j))};
+    __m512d sx{_mm512_sub_pd(vxi, _mm512_loadu_pd(soa.vx.data() + j))};
+    __m512d sy{_mm512_sub_pd(vyi, _mm512_loadu_pd(soa.vy.data() + j))};
+    __m512d sz{_mm512_sub_pd(vzi, _mm512_loadu_pd(soa.vz.data() + j))};
+    // no fused multiply-adds, results must match the scalar path bit by bit
+    __m512d b{_mm512_add_pd(
+        _mm512_add_pd(_mm512_mul_pd(rx, sx), _mm512_mul_pd(ry, sy)),
+        _mm512_mul_pd(rz, sz))};
+    __m512d a{_mm512_add_pd(
+        _mm512_add_pd(_mm512_mul_pd(sx, sx), _mm512_mul_pd(sy, sy)),
+        _mm512_mul_pd(sz, sz))};
+    __m512d c{_mm512_sub_pd(
+        _mm512_add_pd(
+            _mm512_add_pd(_mm512_mul_pd(rx, rx), _mm512_mul_pd(ry, ry)),
+            _mm512_mul_pd(rz, rz)),
+        d2)};
+    __m512d delta{
+        _mm512_sub_pd(_mm512_mul_pd(b, b), _mm512_mul_pd(a, c))};
+    __mmask8 valid{
+        static_cast<__mmask8>(_mm512_cmp_pd_mask(b, zero, _CMP_LE_OQ) &
+                              _mm512_cmp_pd_mask(delta, zero, _CMP_GT_OQ))};
+    if (!valid) {
+      idx = _mm512_add_pd(idx, step);
+      continue;
+    }
+    __m512d deltaSqrt{_mm512_sqrt_pd(delta)};
+    __m512d minusB{_mm512_sub_pd(zero, b)};
+    __m512d t1{_mm512_div_pd(_mm512_sub_pd(minusB, deltaSqrt), a)};
+    __m512d t2{_mm512_div_pd(_mm512_add_pd(minusB, deltaSqrt), a)};
+    __m512d t{_mm512_mask_blend_pd(_mm512_cmp_pd_mask(t2, zero, _CMP_GT_OQ),
+                                   inf, t2)};
+    t = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(t1, zero, _CMP_GT_OQ), t, t1);
+    t = _mm512_mask_blend_pd(valid, inf, t);
+    __mmask8 better{_mm512_cmp_pd_mask(t, best, _CMP_LT_OQ)};
+    best = _mm512_mask_blend_pd(better, best, t);
+    bestIdx = _mm512_mask_blend_pd(better, bestIdx, idx);
+    idx = _mm512_add_pd(idx, step);
+  }
+
+  alignas(64) double times[w];
+  alignas(64) double indexes[w];
+  _mm512_store_pd(times, best);
+  _mm512_store_pd(indexes, bestIdx);
+  return finishSearch(soa, i, j, last, diameter2, times, indexes);
+}
+
+// indexes are tracked as 32 bit integers, floats can't represent them all
+__attribute__((target("avx512f"))) std::pair<double, size_t>
+firstCollisionAVX512(ParticleSoA<float> const& soa, size_t i, size_t first,
+                     size_t last, double diameter2) {
+  constexpr size_t w{16};
+  // the NaN padding lets the last partial vector be loaded whole
+  size_t end{last == soa.size() ? soa.paddedSize() : last};
+  __m512 const xi{_mm512_set1_ps(soa.x[i])};
+  __m512 const yi{_mm512_set1_ps(soa.y[i])};
+  __m512 const zi{_mm512_set1_ps(soa.z[i])};
+  __m512 const vxi{_mm512_set1_ps(soa.vx[i])};
+  __m512 const vyi{_mm512_set1_ps(soa.vy[i])};
+  __m512 const vzi{_mm512_set1_ps(soa.vz[i])};
+  __m512 const d2{_mm512_set1_ps(static_cast<float>(diameter2))};
+  __m512 const zero{_mm512_setzero_ps()};
+  __m512 const inf{_mm512_set1_ps(INFINITY)};
+  __m512i const step{_mm512_set1_epi32(static_cast<int32_t>(w))};
+  __m512 best{inf};
+  __m512i bestIdx{_mm512_set1_epi32(static_cast<int32_t>(last))};
+  __m512i idx{_mm512_add_epi32(
+      _mm512_set1_epi32(static_cast<int32_t>(first)),
+      _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15))};
+
+  size_t j{first};
+  for (; j + w <= end; j += w) {
+    __m512 rx{_mm512_sub_ps(xi, _mm512_loadu_ps(soa.x.data() + j))};
+    __m512 ry{_mm512_sub_ps(yi, _mm512_loadu_ps(soa.y.data() + j))};
+    __m512 rz{_mm512_sub_ps(zi, _mm512_loadu_ps(soa.z.data() + j))};
+    __m512 sx{_mm512_sub_ps(vxi, _mm512_loadu_ps(soa.vx.data() + j))};
+    __m512 sy{_mm512_sub_ps(vyi, _mm512_loadu_ps(soa.vy.data() + j))};
+    __m512 sz{_mm512_sub_ps(vzi, _mm512_loadu_ps(soa.vz.data() + j))};
+    __m512 b{_mm512_add_ps(
+        _mm512_add_ps(_mm512_mul_ps(rx, sx), _mm512_mul_ps(ry, sy)),
+        _mm512_mul_ps(rz, sz))};
+    __m512 a{_mm512_add_ps(
+        _mm512_add_ps(_mm512_mul_ps(sx, sx), _mm512_mul_ps(sy, sy)),
+        _mm512_mul_ps(sz, sz))};
+    __m512 c{_mm512_sub_ps(
+        _mm512_add_ps(
+            _mm512_add_ps(_mm512_mul_ps(rx, rx), _mm512_mul_ps(ry, ry)),
+            _mm512_mul_ps(rz, rz)),
+        d2)};
+    __m512 delta{_mm512_sub_ps(_mm512_mul_ps(b, b), _mm512_mul_ps(a, c))};
+    __mmask16 valid{
+        static_cast<__mmask16>(_mm512_cmp_ps_mask(b, zero, _CMP_LE_OQ) &
+                               _mm512_cmp_ps_mask(delta, zero, _CMP_GT_OQ))};
+    if (!valid) {
+      idx = _mm512_add_epi32(idx, step);
+      continue;
+    }
+    __m512 deltaSqrt{_mm512_sqrt_ps(delta)};
+    __m512 minusB{_mm512_sub_ps(zero, b)};
+    __m512 t1{_mm512_div_ps(_mm512_sub_ps(minusB, deltaSqrt), a)};
+    __m512 t2{_mm512_div_ps(_mm512_add_ps(minusB, deltaSqrt), a)};
+    __m512 t{_mm512_mask_blend_ps(_mm512_cmp_ps_mask(t2, zero, _CMP_GT_OQ),
+                                  inf, t2)};
+    t = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(t1, zero, _CMP_GT_OQ), t, t1);
+    t = _mm512_mask_blend_ps(valid, inf, t);
+    __mmask16 better{_mm512_cmp_ps_mask(t, best, _CMP_LT_OQ)};
+    best = _mm512_mask_blend_ps(better, best, t);
+    bestIdx = _mm512_mask_blend_epi32(better, bestIdx, idx);
+    idx = _mm512_add_epi32(idx, step);
+  }
+
+  alignas(64) float times[w];
+  alignas(64) int32_t indexes[w];
+  _mm512_store_ps(times, best);
+  _mm512_store_si512(indexes, bestIdx);
+  return finishSearch(soa, i, j, last, diameter2, times, indexes);
+}
+
+__attribute__((target("avx2"))) std::pair<double, size_t>
+firstCollisionAVX2(ParticleSoA<double> const& soa, size_t i, size_t first,
+                   size_t last, double diameter2) {
+  constexpr size_t w{4};
+  // the NaN padding lets the last partial vector be loaded whole
+  size_t end{last == soa.size() ? soa.paddedSize() : last};
+  __m256d const xi{_mm256_set1_pd(soa.x[i])};
+  __m256d const yi{_mm256_set1_pd(soa.y[i])};
+  __m256d const zi{_mm256_set1_pd(soa.z[i])};
+  __m256d const vxi{_mm256_set1_pd(soa.vx[i])};
+  __m256d const vyi{_mm256_set1_pd(soa.vy[i])};
+  __m256d const vzi{_mm256_set1_pd(soa.vz[i])};
+  __m256d const d2{_mm256_set1_pd(diameter2)};
+  __m256d const zero{_mm256_setzero_pd()};
+  __m256d const inf{_mm256_set1_pd(INFINITY)};
+  __m256d const step{_mm256_set1_pd(static_cast<double>(w))};
+  __m256d best{inf};
+  __m256d bestIdx{_mm256_set1_pd(static_cast<double>(last))};
+  __m256d idx{_mm256_add_pd(_mm256_set1_pd(static_cast<double>(first)),
+                            _mm256_set_pd(3., 2., 1., 0.))};
+
+  size_t j{first};
+  for (; j + w <= end; j += w) {
+    __m256d rx{_mm256_sub_pd(xi, _mm256_loadu_pd(soa.x.data() + j))};
+    __m256d ry{_mm256_sub_pd(yi, _mm256_loadu_pd(soa.y.data() + j))};
+    __m256d rz{_mm256_sub_pd(zi, _mm256_loadu_pd(soa.z.data() + j))};
+    __m256d sx{_mm256_sub_pd(vxi, _mm256_loadu_pd(soa.vx.data() + j))};
+    __m256d sy{_mm256_sub_pd(vyi, _mm256_loadu_pd(soa.vy.data() + j))};
+    __m256d sz{_mm256_sub_pd(vzi, _mm256_loadu_pd(soa.vz.data() + j))};
+    // no fused multiply-adds, results must match the scalar path bit by bit
+    __m256d b{_mm256_add_pd(
+        _mm256_add_pd(_mm256_mul_pd(rx, sx), _mm256_mul_pd(ry, sy)),
+        _mm256_mul_pd(rz, sz))};
+    __m256d a{_mm256_add_pd(
+        _mm256_add_pd(_mm256_mul_pd(sx, sx), _mm256_mul_pd(sy, sy)),
+        _mm256_mul_pd(sz, sz))};
+    __m256d c{_mm256_sub_pd(
+        _mm256_add_pd(
+            _mm256_add_pd(_mm256_mul_pd(rx, rx), _mm256_mul_pd(ry, ry)),
+            _mm256_mul_pd(rz, rz)),
+        d2)};
+    __m256d delta{
+        _mm256_sub_pd(_mm256_mul_pd(b, b), _mm256_mul_pd(a, c))};
+    __m256d valid{_mm256_and_pd(_mm256_cmp_pd(b, zero, _CMP_LE_OQ),
+                                _mm256_cmp_pd(delta, zero, _CMP_GT_OQ))};
+    if (!_mm256_movemask_pd(valid)) {
+      idx = _mm256_add_pd(idx, step);
+      continue;
+    }
+    __m256d deltaSqrt{_mm256_sqrt_pd(delta)};
+    __m256d minusB{_mm256_sub_pd(zero, b)};
+    __m256d t1{_mm256_div_pd(_mm256_sub_pd(minusB, deltaSqrt), a)};
+    __m256d t2{_mm256_div_pd(_mm256_add_pd(minusB, deltaSqrt), a)};
+    __m256d t{_mm256_blendv_pd(inf, t2, _mm256_cmp_pd(t2, zero, _CMP_GT_OQ))};
+    t = _mm256_blendv_pd(t, t1, _mm256_cmp_pd(t1, zero, _CMP_GT_OQ));
+    t = _mm256_blendv_pd(inf, t, valid);
+    __m256d better{_mm256_cmp_pd(t, best, _CMP_LT_OQ)};
+    best = _mm256_blendv_pd(best, t, better);
+    bestIdx = _mm256_blendv_pd(bestIdx, idx, better);
+    idx = _mm256_add_pd(idx, step);
+  }
+
+  alignas(32) double times[w];
+  alignas(32) double indexes[w];
+  _mm256_store_pd(times, best);
+  _mm256_store_pd(indexes, bestIdx);
+  return finishSearch(soa, i, j, last, diameter2, times, indexes);
+}
+
+// indexes are tracked as 32 bit integers, floats can't represent them all
+__attribute__((target("avx2"))) std::pair<double, size_t>
+firstCollisionAVX2(ParticleSoA<float> const& soa, size_t i, size_t first,
+                   size_t last, double diameter2) {
+  constexpr size_t w{8};
+  // the NaN padding lets the last partial vector be loaded whole
+  size_t end{last == soa.size() ? soa.paddedSize() : last};
+  __m256 const xi{_mm256_set1_ps(soa.x[i])};
+  __m256 const yi{_mm256_set1_ps(soa.y[i])};
+  __m256 const zi{_mm256_set1_ps(soa.z[i])};
+  __m256 const vxi{_mm256_set1_ps(soa.vx[i])};
+  __m256 const vyi{_mm256_set1_ps(soa.vy[i])};
+  __m256 const vzi{_mm256_set1_ps(soa.vz[i])};
+  __m256 const d2{_mm256_set1_ps(static_cast<float>(diameter2))};
+  __m256 const zero{_mm256_setzero_ps()};
+  __m256 const inf{_mm256_set1_ps(INFINITY)};
+  __m256i const step{_mm256_set1_epi32(static_cast<int32_t>(w))};
+  __m256 best{inf};
+  __m256i bestIdx{_mm256_set1_epi32(static_cast<int32_t>(last))};
+  __m256i idx{
+      _mm256_add_epi32(_mm256_set1_epi32(static_cast<int32_t>(first)),
+                       _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))};
+
+  size_t j{first};
+  for (; j + w <= end; j += w) {
+    __m256 rx{_mm256_sub_ps(xi, _mm256_loadu_ps(soa.x.data() + j))};
+    __m256 ry{_mm256_sub_ps(yi, _mm256_loadu_ps(soa.y.data() + j))};
+    __m256 rz{_mm256_sub_ps(zi, _mm256_loadu_ps(soa.z.data() + j))};
+    __m256 sx{_mm256_sub_ps(vxi, _mm256_loadu_ps(soa.vx.data() + j))};
+    __m256 sy{_mm256_sub_ps(vyi, _mm256_loadu_ps(soa.vy.data() + j))};
+    __m256 sz{_mm256_sub_ps(vzi, _mm256_loadu_ps(soa.vz.data() + j))};
+    __m256 b{_mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(rx, sx), _mm256_mul_ps(ry, sy)),
+        _mm256_mul_ps(rz, sz))};
+    __m256 a{_mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(sx, sx), _mm256_mul_ps(sy, sy)),
+        _mm256_mul_ps(sz, sz))};
+    __m256 c{_mm256_sub_ps(
+        _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(rx, rx), _mm256_mul_ps(ry, ry)),
+            _mm256_mul_ps(rz, rz)),
+        d2)};
+    __m256 delta{_mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(a, c))};
+    __m256 valid{_mm256_and_ps(_mm256_cmp_ps(b, zero, _CMP_LE_OQ),
+                               _mm256_cmp_ps(delta, zero, _CMP_GT_OQ))};
+    if (!_mm256_movemask_ps(valid)) {
+      idx = _mm256_add_epi32(idx, step);
+      continue;
+    }
+    __m256 deltaSqrt{_mm256_sqrt_ps(delta)};
+    __m256 minusB{_mm256_sub_ps(zero, b)};
+    __m256 t1{_mm256_div_ps(_mm256_sub_ps(minusB, deltaSqrt), a)};
+    __m256 t2{_mm256_div_ps(_mm256_add_ps(minusB, deltaSqrt), a)};
+    __m256 t{_mm256_blendv_ps(inf, t2, _mm256_cmp_ps(t2, zero, _CMP_GT_OQ))};
+    t = _mm256_blendv_ps(t, t1, _mm256_cmp_ps(t1, zero, _CMP_GT_OQ));
+    t = _mm256_blendv_ps(inf, t, valid);
+    __m256 better{_mm256_cmp_ps(t, best, _CMP_LT_OQ)};
+    best = _mm256_blendv_ps(best, t, better);
+    // the comparison sets every byte of the selected lanes
+    bestIdx = _mm256_blendv_epi8(bestIdx, idx, _mm256_castps_si256(better));
+    idx = _mm256_add_epi32(idx, step);
+  }
+
+  alignas(32) float times[w];
+  alignas(32) int32_t indexes[w];
+  _mm256_store_ps(times, best);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(indexes), bestIdx);
+  return finishSearch(soa, i, j, last, diameter2, times, indexes);
+}
+
+#endif
+
+template <typename FP>
+using CollisionKernel = std::pair<double, size_t> (*)(ParticleSoA<FP> const&,
+                                                      size_t, size_t, size_t,
+                                                      double);
+
+struct CollisionKernels {
+  char const* isa;
+  CollisionKernel<double> doubleKernel;
+  CollisionKernel<float> floatKernel;
+};
+
+// widest instruction set the host cpu supports, checked once
+CollisionKernels const& collisionKernels() {
+  static CollisionKernels const kernels{[]() -> CollisionKernels {
+#ifdef GS_SIMD_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+      return {"avx512", firstCollisionAVX512, firstCollisionAVX512};
+    }
+    if (__builtin_cpu_supports("avx2")) {
+      return {"avx2", firstCollisionAVX2, firstCollisionAVX2};
+    }
+#endif
+    return {"scalar", firstCollisionScalar<double>,
+            firstCollisionScalar<float>};
+  }()};
+  return kernels;
+}
+
+char const* collisionKernelISA() { return collisionKernels().isa; }
+
+std::pair<double, size_t> firstCollision(ParticleSoA<double> const& soa,
+                                         size_t i, size_t first, size_t last,
+                                         double diameter2) {
+  return collisionKernels().doubleKernel(soa, i, first, last, diameter2);
+}
+
+std::pair<double, size_t> firstCollision(ParticleSoA<float> const& soa,
+                                         size_t i, size_t first, size_t last,
+                                         double diameter2) {
+  return collisionKernels().floatKernel(soa, i, first, last, diameter2);
+}
+
+template class ParticleSoA<float>;
+template class ParticleSoA<double>;
+
+template std::pair<double, size_t> firstCollisionScalar(
+    ParticleSoA<float> const& soa, size_t i, size_t first, size_t last,
+    double diameter2);
+template std::pair<double, size_t> firstCollisionScalar(
+    ParticleSoA<double> const& soa, size_t i, size_t first, size_t last,
+    double diameter2);
+
+}  // namespace GS
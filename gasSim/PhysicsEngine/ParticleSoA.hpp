@@ -0,0 +1,103 @@
+#ifndef PARTICLESOA_HPP
+#define PARTICLESOA_HPP
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace GS {
+
+template <typename FP>
+struct BasicParticle;
+
+// allocator for arrays that can be loaded with aligned simd instructions
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+  using value_type = T;
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(AlignedAllocator<U, Alignment> const&) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(
+        ::operator new(n * sizeof(T), std::align_val_t{Alignment}));
+  }
+  void deallocate(T* p, size_t) {
+    ::operator delete(p, std::align_val_t{Alignment});
+  }
+
+  template <typename U>
+  bool operator==(AlignedAllocator<U, Alignment> const&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(AlignedAllocator<U, Alignment> const&) const {
+    return false;
+  }
+};
+
+// particles positions and speeds split by component
+// every array is padded to a multiple of simdWidth with NaNs, which never
+// produce a collision, so that whole vectors can be loaded up to the end
+template <typename FP>
+class ParticleSoA {
+ public:
+  using Array = std::vector<FP, AlignedAllocator<FP>>;
+  static constexpr size_t simdWidth{64 / sizeof(FP)};  // one cache line
+
+  ParticleSoA() = default;
+  explicit ParticleSoA(std::vector<BasicParticle<FP>> const& particles) {
+    assign(particles);
+  }
+
+  void assign(std::vector<BasicParticle<FP>> const& particles);
+  void clear();
+  // same arithmetic as the particles' own updates, so that both stay equal
+  void set(size_t i, BasicParticle<FP> const& p);
+  void move(FP dt);
+
+  size_t size() const { return nP; }
+  size_t paddedSize() const { return x.size(); }
+  size_t memoryUsage() const { return 6 * x.capacity() * sizeof(FP); }
+
+  Array x{};
+  Array y{};
+  Array z{};
+  Array vx{};
+  Array vy{};
+  Array vz{};
+
+ private:
+  size_t nP{0};
+};
+
+// earliest collision between particle i and the approaching particles in
+// [first, last), using the same formula as collisionTime
+// returns the collision time and the partner index, lowest index on ties,
+// {INFINITY, last} if there is none
+// diameter2 is the squared particle diameter, 4 * (r * r)
+// the float overload computes everything in single precision
+std::pair<double, size_t> firstCollision(ParticleSoA<double> const& soa,
+                                         size_t i, size_t first, size_t last,
+                                         double diameter2);
+std::pair<double, size_t> firstCollision(ParticleSoA<float> const& soa,
+                                         size_t i, size_t first, size_t last,
+                                         double diameter2);
+// same as firstCollision, always using the scalar path
+template <typename FP>
+std::pair<double, size_t> firstCollisionScalar(ParticleSoA<FP> const& soa,
+                                               size_t i, size_t first,
+                                               size_t last, double diameter2);
+// instruction set firstCollision picked for the host cpu: "avx512", "avx2"
+// or "scalar"
+char const* collisionKernelISA();
+
+}  // namespace GS
+
+#endif
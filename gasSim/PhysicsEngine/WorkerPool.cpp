@@ -0,0 +1,85 @@
+#include "WorkerPool.hpp"
+
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace GS {
+
+WorkerPool::WorkerPool(size_t threadsN) {
+  if (!threadsN) {
+    threadsN = std::thread::hardware_concurrency();
+  }
+  if (threadsN > 1) {
+    workers.reserve(threadsN - 1);
+    for (size_t i{1}; i < threadsN; ++i) {
+      workers.emplace_back([this, i] { workerLoop(i); });
+    }
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> jobGuard{jobMtx};
+    stopping = true;
+  }
+  jobCv.notify_all();
+  for (std::thread& t : workers) {
+    t.join();
+  }
+}
+
+void WorkerPool::run(std::function<void(size_t)> const& job_) {
+  std::lock_guard<std::mutex> runGuard{runMtx};
+  {
+    std::lock_guard<std::mutex> jobGuard{jobMtx};
+    job = &job_;
+    pending = workers.size();
+    ++generation;
+  }
+  jobCv.notify_all();
+
+  // the job must outlive the workers using it, even if worker 0 throws
+  std::exception_ptr error{nullptr};
+  try {
+    job_(0);
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  std::unique_lock<std::mutex> jobLock{jobMtx};
+  doneCv.wait(jobLock, [this] { return !pending; });
+  job = nullptr;
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void WorkerPool::workerLoop(size_t index) {
+  size_t lastGeneration{0};
+  while (true) {
+    std::function<void(size_t)> const* currentJob{nullptr};
+    {
+      std::unique_lock<std::mutex> jobLock{jobMtx};
+      jobCv.wait(jobLock, [&] {
+        return stopping || generation != lastGeneration;
+      });
+      if (stopping) {
+        return;
+      }
+      lastGeneration = generation;
+      currentJob = job;
+    }
+
+    // jobs are expected to handle their own errors, as with std::thread
+    (*currentJob)(index);
+
+    std::lock_guard<std::mutex> jobGuard{jobMtx};
+    if (!--pending) {
+      doneCv.notify_one();
+    }
+  }
+}
+
+}  // namespace GS
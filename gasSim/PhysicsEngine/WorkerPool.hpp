@@ -0,0 +1,46 @@
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GS {
+
+// fixed set of long-lived threads running the same job on each iteration
+// the calling thread takes part in the job as worker 0
+class WorkerPool {
+ public:
+  // 0 threads means one for each hardware thread
+  explicit WorkerPool(size_t threadsN = 0);
+  ~WorkerPool();
+
+  WorkerPool(WorkerPool const&) = delete;
+  WorkerPool& operator=(WorkerPool const&) = delete;
+
+  size_t getThreadsN() const { return workers.size() + 1; }
+
+  // calls job(workerIndex) once on every worker, returns when all are done
+  // concurrent calls are serialized
+  void run(std::function<void(size_t)> const& job);
+
+ private:
+  void workerLoop(size_t index);
+
+  std::vector<std::thread> workers{};
+  std::mutex runMtx{};
+  std::mutex jobMtx{};
+  std::condition_variable jobCv{};
+  std::condition_variable doneCv{};
+  std::function<void(size_t)> const* job{nullptr};
+  size_t generation{0};
+  size_t pending{0};
+  bool stopping{false};
+};
+
+}  // namespace GS
+
+#endif
@@ -3,6 +3,7 @@
 #include <chrono>
 #include <climits>
 #include <cmath>
+#include <condition_variable>
 #include <cstdio>
 #include <exception>
 #include <filesystem>
@@ -12,10 +13,13 @@
 #include <memory>
 #include <mutex>
 #include <numeric>
+#include <optional>
+#include <random>
 #include <stdexcept>
 #include <string>
 #include <thread>
 #include <utility>
+#include <variant>
 #include <vector>
 
 #include <SFML/Graphics/Color.hpp>
@@ -40,13 +44,23 @@
 #include <TList.h>
 #include <TMultiGraph.h>
 #include <TObject.h>
+#include <TROOT.h>
 
+#include <unistd.h>
+
+#include <tbb/flow_graph.h>
+#include <tbb/global_control.h>
+#include <tbb/task_arena.h>
+
+#include "DataProcessing/Checkpoint.hpp"
+#include "DataProcessing/GasEnsemble.hpp"
 #include "DataProcessing/SimDataPipeline.hpp"
 #include "Graphics/Camera.hpp"
 #include "Graphics/RenderStyle.hpp"
 #include "PhysicsEngine/GSVector.hpp"
 #include "PhysicsEngine/Gas.hpp"
 #include "PhysicsEngine/Particle.hpp"
+#include "PhysicsEngine/WorkerPool.hpp"
 #include "gasSim/Libs/INIReader.h"
 #include "gasSim/Libs/cxxopts.hpp"
 
@@ -117,6 +131,53 @@ GS::VideoOpts stovideoopts(std::string s) {
   }
 }
 
+GS::QueuePolicy stoqueuepolicy(std::string s) {
+  if (s == "block") {
+    return GS::QueuePolicy::block;
+  } else if (s == "dropOldest") {
+    return GS::QueuePolicy::dropOldest;
+  } else {
+    throw std::invalid_argument(
+        "String not corresponding to available queue policy.");
+  }
+}
+
+GS::RenderBackend storenderbackend(std::string s) {
+  if (s == "sfml") {
+    return GS::RenderBackend::sfml;
+  } else if (s == "cpu") {
+    return GS::RenderBackend::cpu;
+  } else {
+    throw std::invalid_argument(
+        "String not corresponding to available render backend.");
+  }
+}
+
+// reads %queue%High, %queue%Low and %queue%Policy from the output section
+GS::QueueLimits readQueueLimits(INIReader const& configFile,
+                                std::string const& queue) {
+  long high{configFile.GetInteger("output", queue + "High", 0)};
+  long low{configFile.GetInteger("output", queue + "Low", 0)};
+  if (high < 0 || low < 0) {
+    throw std::invalid_argument("Found negative " + queue +
+                                " watermarks in config file.");
+  }
+  std::string unit{configFile.Get("output", "queueUnit", "items")};
+  if (unit != "items" && unit != "bytes") {
+    throw std::invalid_argument(
+        "String not corresponding to available queue unit.");
+  }
+  return {static_cast<size_t>(high), static_cast<size_t>(low),
+          unit == "bytes",
+          stoqueuepolicy(configFile.Get("output", queue + "Policy", "block"))};
+}
+
+std::string memoryText(GS::PipelineMemoryUsage const& usage) {
+  return std::to_string(usage.rawData >> 20) + " MiB raw data, " +
+         std::to_string(usage.stats >> 20) + " MiB stats, " +
+         std::to_string(usage.renders >> 20) + " MiB renders";
+}
+
 void throwIfZombie(TObject* o, std::string message,
                    bool deleteIfZombie = false) {
   if (!o) {
@@ -170,6 +231,16 @@ int main(int argc, const char* argv[]) {
         "c,config",
         "Use the given path as the configuration file, defaults to "
         "configs/gasSim_demo.ini",
+        cxxopts::value<std::string>())(
+        "e,ensemble",
+        "Simulate the given number of independent replicas of the configured "
+        "gas without rendering, printing the ensemble averaged stats",
+        cxxopts::value<size_t>())(
+        "seed", "Seed for the ensemble replicas, random if not given",
+        cxxopts::value<unsigned>())(
+        "resume",
+        "Continue the run saved in the given checkpoint file, its gas "
+        "replaces the configured one",
         cxxopts::value<std::string>());
 
     auto opts = options.parse(argc, argv);
@@ -196,19 +267,36 @@ int main(int argc, const char* argv[]) {
     std::cout << "Starting resources loading. Using configFile file at path "
               << configPath << std::endl;
 
+    // a resumed run takes the gas parameters from the checkpoint
+    std::optional<GS::Checkpoint> checkpoint{};
+    if (opts.count("resume")) {
+      std::string checkpointPath{opts["resume"].as<std::string>()};
+      throwIfNotExists(checkpointPath);
+      checkpoint = GS::readCheckpoint(checkpointPath);
+      std::cout << "Resuming from " << checkpointPath << " at time "
+                << checkpoint->time << ", after " << checkpoint->events
+                << " collisions" << std::endl;
+    }
+
     // Loading and validating all necessary simulation parameters
-    double pMass{configFile.GetReal("simulation parameters", "pMass", 1.)};
+    double pMass{checkpoint ? checkpoint->mass
+                            : configFile.GetReal("simulation parameters",
+                                                 "pMass", 1.)};
     if (pMass <= 0) {
       throw std::invalid_argument("Found non-positive mass in config file.");
     }
     GS::Particle::setMass(pMass);
-    double pRadius{configFile.GetReal("simulation parameters", "pRadius", 1.)};
+    double pRadius{checkpoint ? checkpoint->radius
+                              : configFile.GetReal("simulation parameters",
+                                                   "pRadius", 1.)};
     if (pRadius <= 0) {
       throw std::invalid_argument("Found non-positive radius in config file.");
     }
     GS::Particle::setRadius(pRadius);
-    size_t nParticles{static_cast<size_t>(
-        configFile.GetInteger("simulation parameters", "nParticles", 1))};
+    size_t nParticles{
+        checkpoint ? checkpoint->particles.size()
+                   : static_cast<size_t>(configFile.GetInteger(
+                         "simulation parameters", "nParticles", 1))};
     if (nParticles > LONG_MAX) {
       throw(std::invalid_argument("Found non-positive radius in config file."));
     }
@@ -217,7 +305,9 @@ int main(int argc, const char* argv[]) {
       throw std::invalid_argument(
           "Found non-positive target temperature in config file.");
     }
-    double boxSide{configFile.GetReal("simulation parameters", "boxSide", 2.5)};
+    double boxSide{checkpoint ? checkpoint->boxSide
+                              : configFile.GetReal("simulation parameters",
+                                                   "boxSide", 2.5)};
     if (boxSide <= 0) {
       throw std::invalid_argument(
           "Found non-positive box side in config file.");
@@ -226,6 +316,28 @@ int main(int argc, const char* argv[]) {
     if (nStats <= 0) {
       throw std::invalid_argument("Provided negative nStats.");
     }
+    long nThreads{
+        configFile.GetInteger("simulation parameters", "nThreads", 0)};
+    if (nThreads < 0) {
+      throw std::invalid_argument(
+          "Found negative threads number in config file.");
+    }
+    long parallelThreshold{configFile.GetInteger(
+        "simulation parameters", "parallelThreshold",
+        static_cast<long>(GS::Gas::getParallelThreshold()))};
+    if (parallelThreshold < 0) {
+      throw std::invalid_argument(
+          "Found negative parallel threshold in config file.");
+    }
+    GS::Gas::setParallelThreshold(static_cast<size_t>(parallelThreshold));
+    bool singlePrecision{configFile.GetBoolean("simulation parameters",
+                                               "singlePrecision", false)};
+    double checkpointInterval{
+        configFile.GetReal("output", "checkpointInterval", 0.)};
+    if (checkpointInterval < 0) {
+      throw std::invalid_argument(
+          "Found negative checkpoint interval in config file.");
+    }
     double targetBufferTime{configFile.GetReal("output", "targetBuffer", 2.5)};
     if (targetBufferTime <= 0) {
       throw std::invalid_argument(
@@ -282,6 +394,14 @@ int main(int argc, const char* argv[]) {
     const int frameTimems{static_cast<int>(1000. / framerate)};
 
     bool mfpMemory{configFile.GetBoolean("output", "mfpMemory", true)};
+    bool frameSnapshots{
+        configFile.GetBoolean("output", "frameSnapshots", true)};
+    long statsWorkers{configFile.GetInteger("output", "statsWorkers", 1)};
+    long renderWorkers{configFile.GetInteger("output", "renderWorkers", 1)};
+    if (statsWorkers <= 0 || renderWorkers <= 0) {
+      throw std::invalid_argument(
+          "Found non-positive workers number in config file.");
+    }
 
     // Loading of ROOT input file and objects
     std::string ROOTInputPath{
@@ -348,6 +468,35 @@ int main(int argc, const char* argv[]) {
     expMFP->SetParameter(0, targetT / M_SQRT2 / expP->GetParameter(0) /
                                 (M_PI * pRadius * pRadius));
 
+    // ensemble mode: no rendering, just averaged stats on the standard output
+    if (opts.count("ensemble")) {
+      size_t nReplicas{opts["ensemble"].as<size_t>()};
+      unsigned seed{opts.count("seed") ? opts["seed"].as<unsigned>()
+                                       : std::random_device{}()};
+      std::optional<tbb::global_control> threadsLimit{};
+      if (nThreads) {
+        threadsLimit.emplace(tbb::global_control::max_allowed_parallelism,
+                             static_cast<size_t>(nThreads));
+      }
+      std::cout << "Running " << nReplicas << " replicas with seed " << seed
+                << std::endl;
+      GS::GasEnsemble ensemble{nReplicas, nParticles, targetT, boxSide, seed};
+      std::vector<GS::EnsembleStats> results{ensemble.run(
+          nIters / static_cast<size_t>(nStats), static_cast<size_t>(nStats),
+          *speedsHTemplate, mfpMemory)};
+      std::cout << "time, pressure, pressure variance, temperature, "
+                   "temperature variance, mean free path, mean free path "
+                   "variance\n";
+      for (GS::EnsembleStats const& e : results) {
+        std::cout << e.time.mean << ", " << e.pressure.mean << ", "
+                  << e.pressure.variance << ", " << e.temperature.mean << ", "
+                  << e.temperature.variance << ", " << e.meanFreePath.mean
+                  << ", " << e.meanFreePath.variance << '\n';
+      }
+      std::cout << "Ensemble simulation completed." << std::endl;
+      return 0;
+    }
+
     // Loading SFML resources
     sf::Font font;
     std::string fontPath{"assets/" +
@@ -399,10 +548,50 @@ int main(int argc, const char* argv[]) {
 
     /* SIMULATION AND PROCESSING STARTING PHASE */
 
-    GS::Gas gas{nParticles, targetT, boxSide};
+    // snapshots are converted to double, so nothing past the simulation
+    // depends on the precision
+    std::variant<GS::Gas, GS::GasF> gas{};
+    if (checkpoint && singlePrecision) {
+      gas.emplace<GS::GasF>(*checkpoint);
+    } else if (checkpoint) {
+      gas.emplace<GS::Gas>(*checkpoint);
+    } else if (singlePrecision) {
+      gas.emplace<GS::GasF>(nParticles, targetT, boxSide);
+    } else {
+      gas.emplace<GS::Gas>(nParticles, targetT, boxSide);
+    }
+    std::visit(
+        [&](auto& g) {
+          g.setWorkerPool(std::make_shared<GS::WorkerPool>(
+              static_cast<size_t>(nThreads)));
+        },
+        gas);
+    double speedsSum{std::visit(
+        [](auto const& g) {
+          return std::accumulate(
+              g.getParticles().begin(), g.getParticles().end(), 0.,
+              [](double acc, auto const& p) {
+                return acc + static_cast<double>(p.speed.norm());
+              });
+        },
+        gas)};
     GS::SimDataPipeline output{static_cast<unsigned>(nStats), framerate,
                                *speedsHTemplate};
     output.setFont(font);
+    if (checkpoint) {
+      output.resume(*checkpoint);
+      // nIters counts the collisions since the start of the run
+      nIters = nIters > checkpoint->events ? nIters - checkpoint->events : 0;
+      checkpoint.reset();
+    }
+    if (checkpointInterval > 0) {
+      std::filesystem::create_directories("outputs/checkpoints");
+      output.setCheckpoints(
+          "outputs/checkpoints/" +
+              configFile.Get("output", "checkpointName", "checkpoint") +
+              ".gsc",
+          checkpointInterval);
+    }
 
     // target buffer time / hits per second / collisions per TdStats
     // hits per second = particles n / avg coll time
@@ -410,12 +599,7 @@ int main(int argc, const char* argv[]) {
     // average)
     double desiredStatChunkSize{
         targetBufferTime * std::pow(boxSide, 3.) /
-        (M_PI * std::pow(GS::Particle::getRadius(), 2.) *
-         std::accumulate(gas.getParticles().begin(), gas.getParticles().end(),
-                         0.,
-                         [](double acc, const GS::Particle& p) {
-                           return acc + p.speed.norm();
-                         }) *
+        (M_PI * std::pow(GS::Particle::getRadius(), 2.) * speedsSum *
          static_cast<double>(nStats))};
     if (desiredStatChunkSize > static_cast<double>(SIZE_MAX)) {
       throw std::runtime_error(
@@ -424,28 +608,79 @@ int main(int argc, const char* argv[]) {
     }
     output.setStatChunkSize(static_cast<size_t>(
         desiredStatChunkSize >= 1. ? desiredStatChunkSize : 1.));
+    output.setFrameSnapshots(frameSnapshots);
+    output.setWorkers(static_cast<size_t>(statsWorkers),
+                      static_cast<size_t>(renderWorkers));
+    output.setRenderBackend(
+        storenderbackend(configFile.Get("render", "backend", "sfml")));
+    output.setQueueLimits(GS::PipelineQueue::rawData,
+                          readQueueLimits(configFile, "rawData"));
+    output.setQueueLimits(GS::PipelineQueue::stats,
+                          readQueueLimits(configFile, "stats"));
+    output.setQueueLimits(GS::PipelineQueue::renders,
+                          readQueueLimits(configFile, "renders"));
 
-    // General stop signal, shared between threads
-    std::atomic<bool> stop{false};
-
-    std::thread simThread{[&, nIters] {
-      try {
-        gas.simulate(nIters, output, [&] { return stop.load(); });
-      } catch (std::runtime_error const& e) {
-        std::lock_guard<std::mutex> coutGuard{coutMtx};
-        std::cout << "Runtime error: " << e.what() << std::endl;
-        std::terminate();
+    // memory pre-flight: worst case of nothing being drawn from the queues
+    // events per second = particle collisions + wall collisions, from the
+    // mean speed and a relative speed of sqrt(2) times it
+    double eventRate{speedsSum *
+                     (M_SQRT2 * M_PI * std::pow(GS::Particle::getRadius(), 2.) *
+                          2. * static_cast<double>(nParticles) /
+                          std::pow(boxSide, 3.) +
+                      1.5 / boxSide)};
+    long memoryBudgetMiB{configFile.GetInteger("output", "memoryBudget", 0)};
+    if (memoryBudgetMiB < 0) {
+      throw std::invalid_argument(
+          "Found negative memory budget in config file.");
+    }
+    size_t memoryBudget{
+        memoryBudgetMiB
+            ? static_cast<size_t>(memoryBudgetMiB) << 20
+            : static_cast<size_t>(sysconf(_SC_AVPHYS_PAGES)) *
+                  static_cast<size_t>(sysconf(_SC_PAGESIZE))};
+    bool withRenders{videoOpt != GS::VideoOpts::justStats};
+    size_t gasBytes{std::visit(
+        [&](auto const& g) {
+          return g.estimateMemory(nParticles, g.getCollSearch()).total();
+        },
+        gas)};
+    GS::PipelineMemoryUsage estimate{output.estimateMemory(
+        nParticles, nIters, eventRate, gasSize, withRenders)};
+    if (gasBytes + estimate.total() > memoryBudget) {
+      // the unbounded queues share what the gas and states leave, blocking
+      size_t fixedBytes{gasBytes + estimate.states};
+      if (fixedBytes >= memoryBudget) {
+        throw std::runtime_error(
+            "Estimated gas memory exceeds the memory budget. Lower "
+            "nParticles or raise memoryBudget.");
       }
-      std::lock_guard<std::mutex> coutGuard{coutMtx};
-      std::cout
-          << "Simulation thread done.                                      \r"
-          << std::endl;
-    }};
-
-    {
-      std::lock_guard<std::mutex> coutGuard{coutMtx};
-      std::cout << "Simulation thread running." << std::endl;
+      size_t room{memoryBudget - fixedBytes};
+      std::array<std::pair<GS::PipelineQueue, size_t>, 3> shares{
+          {{GS::PipelineQueue::rawData,
+            withRenders ? room / 8 * 3 : room / 8 * 7},
+           {GS::PipelineQueue::stats, room / 8},
+           {GS::PipelineQueue::renders, withRenders ? room / 2 : 0}}};
+      for (auto const& [queue, share] : shares) {
+        if (share && !output.getQueueLimits(queue).high) {
+          output.setQueueLimits(queue, {share, share / 2, true});
+        }
+      }
+      estimate = output.estimateMemory(nParticles, nIters, eventRate,
+                                       gasSize, withRenders);
+      if (gasBytes + estimate.total() > memoryBudget) {
+        throw std::runtime_error(
+            "Estimated memory exceeds the memory budget even with bounded "
+            "queues. Lower the queue watermarks or raise memoryBudget.");
+      }
+      std::cout << "Bounded the output queues to fit the memory budget."
+                << std::endl;
     }
+    std::cout << "Estimated peak memory: "
+              << ((gasBytes + estimate.total()) >> 20) << " MiB out of "
+              << (memoryBudget >> 20) << " MiB" << std::endl;
+
+    // General stop signal, shared between the stages
+    std::atomic<bool> stop{false};
 
     GS::Camera camera{camPos,
                       camSight,
@@ -460,39 +695,6 @@ int main(int argc, const char* argv[]) {
         configFile.GetInteger("render", "gasBgColor", 0xffffffff))));
     style.setWallsOpts(configFile.Get("render", "wallsOpts", "ufdl"));
 
-    std::thread processThread;
-    if (videoOpt != GS::VideoOpts::justStats) {
-      // process stats and graphics
-      processThread = std::thread([&, mfpMemory] {
-        output.processData(camera, style, mfpMemory,
-                           [&] { return stop.load(); });
-        std::lock_guard<std::mutex> coutGuard{coutMtx};
-        std::cout << "Data processing thread done.                         "
-                     "               \r"
-                  << std::endl;
-      });
-    } else {
-      // process only stats
-      processThread = std::thread([&, mfpMemory] {
-        try {
-          output.processData(mfpMemory, [&] { return stop.load(); });
-        } catch (std::runtime_error const& e) {
-          std::lock_guard<std::mutex> coutGuard{coutMtx};
-          std::cout << "Runtime error: " << e.what() << std::endl;
-          std::terminate();
-        }
-        std::lock_guard<std::mutex> coutGuard{coutMtx};
-        std::cout << "Data processing thread done.                         "
-                     "               \r"
-                  << std::endl;
-      });
-    }
-
-    {
-      std::lock_guard<std::mutex> coutGuard{coutMtx};
-      std::cout << "Processing thread running." << std::endl;
-    }
-
     /* SIMULATION AND PROCESSING STARTING PHASE END */
 
     /* GRAPHICAL OUTPUT PREP PHASE */
@@ -576,24 +778,36 @@ int main(int argc, const char* argv[]) {
           expMFP->Draw("SAME");
         }};
 
-    {
-      std::lock_guard<std::mutex> coutGuard{coutMtx};
-      std::cout << "Starting video composition and output." << std::endl;
-    }
-
-    // wait until there's something to process
-    // to avoid premature program exit/hanging on slow/superfast
-    // processing configurations
-    while (!output.isProcessing() && !output.getRawDataSize() &&
-           !output.isDone() && !output.getNStats() && !output.getNRenders()) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
-
     /* GRAPHICAL OUTPUT PREP PHASE END */
 
     /* VIDEO COMPOSITION-OUTPUT PHASE */
 
-    if (configFile.GetBoolean("output", "saveVideo", false)) {
+    // simulation and processing block for the whole run, so they run on
+    // their own threads, the raw data ring blocking the simulation when
+    // processing falls behind, and processing keeps at most its stats and
+    // render workers busy
+    // the output is a flow graph: the compose node makes a buffer of frames
+    // at a time and the sink plays them, a limiter letting composition get at
+    // most a batch ahead of the output instead of piling up frames
+    struct FrameBatch {
+      std::vector<sf::Texture> frames{};
+      bool last{false};  // composed after processing ended
+    };
+
+    bool const saveVideo{configFile.GetBoolean("output", "saveVideo", false)};
+    std::unique_ptr<FILE, int (*)(FILE*)> ffmpeg{nullptr, pclose};
+    std::optional<sf::RenderWindow> window{};
+    sf::Texture lastWindowTxtr;
+    std::mutex windowMtx;  // used both for lastWindowTxtr and window
+    std::condition_variable windowCv;
+    std::atomic<int> pendingBatches{0};  // composed, not yet played
+    bool shownLast{false};               // guarded by windowMtx
+    int droppedFrames{0};                // only used by the sink
+    int framesToDrop{0};
+    std::atomic<int> processedFrames{0};
+    std::function<void(FrameBatch&)> playBatch{};
+
+    if (saveVideo) {
       {
         std::lock_guard<std::mutex> coutGuard{coutMtx};
         std::cout << "Starting video encoding." << std::endl;
@@ -605,144 +819,234 @@ int main(int argc, const char* argv[]) {
           " -i - -c:v libx264 -pix_fmt yuv420p " + "outputs/videos/" +
           configFile.Get("output", "videoOutputName", "output") + ".mp4"};
 
-      FILE* ffmpeg = popen(cmd.c_str(), "w");
+      ffmpeg.reset(popen(cmd.c_str(), "w"));
       if (!ffmpeg) {
         throw std::runtime_error("Failed to open ffmpeg pipe.");
       }
-      bool lastBatch{false};
-      sf::Image auxImg;
-      auxImg.create(windowSize.x, windowSize.y);
-      while (true) {
-        if (output.isDone() && output.getRawDataSize() < output.getStatSize() &&
-            !output.isProcessing()) {
-          lastBatch = true;
-        }
-        std::vector<sf::Texture> frames{
-            output.getVideo(videoOpt, {windowSize.x, windowSize.y}, placeHolder,
-                            *graphsList, true, fitLambda, drawLambdas)};
+      playBatch = [&](FrameBatch& batch) {
+        sf::Image auxImg;
         int i{0};
-        for (sf::Texture& t : frames) {
+        for (sf::Texture& t : batch.frames) {
           auxImg = t.copyToImage();
           fwrite(auxImg.getPixelsPtr(), 1, windowSize.x * windowSize.y * 4,
-                 ffmpeg);
+                 ffmpeg.get());
           ++i;
           std::lock_guard<std::mutex> coutGuard{coutMtx};
-          std::cout << "Encoding batch of " << frames.size() << " frames: "
-                    << static_cast<float>(i) / static_cast<float>(frames.size())
+          std::cout << "Encoding batch of " << batch.frames.size()
+                    << " frames: "
+                    << static_cast<float>(i) /
+                           static_cast<float>(batch.frames.size())
                     << "% complete.                 \r";
           std::cout.flush();
         }
-        if (lastBatch) {
+        if (batch.last) {
+          std::lock_guard<std::mutex> coutGuard{coutMtx};
           std::cout << "Encoding done!" << std::endl;
-          break;
         }
-      }
-      pclose(ffmpeg);
+      };
     } else {  // no permanent video output requested ->
               // wiew-once live video
       {
         std::lock_guard<std::mutex> coutGuard{coutMtx};
         std::cout << "Starting video display." << std::endl;
       }
-      sf::RenderWindow window(sf::VideoMode(windowSize.x, windowSize.y),
-                              "GasSim Display", sf::Style::Default);
-      sf::Texture lastWindowTxtr;
+      window.emplace(sf::VideoMode(windowSize.x, windowSize.y),
+                     "GasSim Display", sf::Style::Default);
       lastWindowTxtr.create(windowSize.x, windowSize.y);
       {
         sf::Image blankWindow;
         blankWindow.create(windowSize.x, windowSize.y, sf::Color::White);
         lastWindowTxtr.update(blankWindow);
       }
-      std::mutex windowMtx;  // used both for lastWindowTxtr and window
-      window.setFramerateLimit(60);
-      window.setActive(false);
-      std::atomic<bool> pauseBufferLoop{false};
-      std::atomic<bool> bufferKillSignal{false};
-      std::atomic<int> queueNumber{1};
-      std::atomic<int> launchedPlayThreadsN{0};
-      std::atomic<int> droppedFrames{0};
-      std::atomic<int> framesToDrop{0};
-      std::atomic<int> processedFrames{0};
-
-      auto playLambda{
-          [&, frameTimems](std::shared_ptr<std::vector<sf::Texture>> rPtr,
-                           int threadN) {
-            sf::Sprite auxS;
-            sf::Event e;
-            while (threadN != queueNumber) {
-              if (stop.load()) {
+      window->setFramerateLimit(60);
+      window->setActive(false);
+
+      // the sink holds the window for a whole batch, the buffering screen
+      // is drawn by the main thread while no batch is waiting
+      playBatch = [&, frameTimems](FrameBatch& batch) {
+        std::lock_guard<std::mutex> windowGuard{windowMtx};
+        if (window->isOpen() && !stop.load()) {
+          window->setActive();
+          sf::Sprite auxS;
+          sf::Event e;
+          auto lastDrawEnd{std::chrono::high_resolution_clock::now()};
+          float frameTimeS{static_cast<float>(frameTimems / 1000.)};
+          std::chrono::duration<float> lastFrameDrawTime{};
+          int i{0};
+          for (const sf::Texture& r : batch.frames) {
+            while (window->pollEvent(e)) {
+              if (e.type == sf::Event::Closed) {
+                stop.store(true);
+                window->close();
                 break;
               }
-              std::this_thread::sleep_for(
-                  std::chrono::milliseconds(frameTimems));
             }
-            if (!stop.load()) {
-              pauseBufferLoop.store(true);
-              std::lock_guard<std::mutex> windowGuard{windowMtx};
-              if (window.isOpen()) {
-                window.setActive();
-                auto lastDrawEnd{std::chrono::high_resolution_clock::now()};
-                float frameTimeS{static_cast<float>(frameTimems / 1000.)};
-                std::chrono::duration<float> lastFrameDrawTime{};
-                int i{0};
-                for (const sf::Texture& r : *rPtr) {
-                  while (window.pollEvent(e)) {
-                    if (e.type == sf::Event::Closed) {
-                      stop.store(true);
-                      bufferKillSignal.store(true);
-                      pauseBufferLoop.store(true);
-                      window.close();
-                      break;
-                    }
-                  }
-                  if (window.isOpen()) {
-                    if (!framesToDrop.load()) {
-                      lastFrameDrawTime =
-                          std::chrono::high_resolution_clock::now() -
-                          lastDrawEnd;
-                      if (lastFrameDrawTime.count() <= frameTimeS) {
-                        auxS.setTexture(r);
-                        window.draw(auxS);
-                        window.display();
-                      } else {
-                        framesToDrop.fetch_add(
-                            static_cast<int>(lastFrameDrawTime.count() /
-                                             static_cast<float>(frameTimems)) -
-                            1);
-                        droppedFrames.fetch_add(1);
-                      }
-                      lastDrawEnd = std::chrono::high_resolution_clock::now();
-                    } else {
-                      framesToDrop.fetch_sub(1);
-                      lastDrawEnd = std::chrono::high_resolution_clock::now();
-                    }
-                    processedFrames.fetch_sub(1);
-                  } else {
-                    break;
-                  }
-                  std::lock_guard<std::mutex> coutGuard{coutMtx};
-                  std::cout << "Status: displaying. Progress: " << ++i
-                            << " from batch of " << rPtr->size()
-                            << " renders      \r";
-                  std::cout.flush();
-                }
-                window.setActive(false);
-                queueNumber++;
-                if (launchedPlayThreadsN == threadN) {
-                  if (rPtr->size()) {
-                    lastWindowTxtr.update(std::move(rPtr->back()));
-                  }
-                  pauseBufferLoop.store(false);
-                  std::lock_guard<std::mutex> coutGuard{coutMtx};
-                  std::cout
-                      << "Status: buffering.                                   "
-                         "                          \r";
-                }
+            if (!window->isOpen() || stop.load()) {
+              break;
+            }
+            if (!framesToDrop) {
+              lastFrameDrawTime =
+                  std::chrono::high_resolution_clock::now() - lastDrawEnd;
+              if (lastFrameDrawTime.count() <= frameTimeS) {
+                auxS.setTexture(r);
+                window->draw(auxS);
+                window->display();
+              } else {
+                framesToDrop +=
+                    static_cast<int>(lastFrameDrawTime.count() /
+                                     static_cast<float>(frameTimems)) -
+                    1;
+                ++droppedFrames;
               }
+            } else {
+              --framesToDrop;
             }
-          }};
+            lastDrawEnd = std::chrono::high_resolution_clock::now();
+            processedFrames.fetch_sub(1);
+            std::lock_guard<std::mutex> coutGuard{coutMtx};
+            std::cout << "Status: displaying. Progress: " << ++i
+                      << " from batch of " << batch.frames.size()
+                      << " renders      \r";
+            std::cout.flush();
+          }
+          if (window->isOpen() && batch.frames.size()) {
+            lastWindowTxtr.update(batch.frames.back());
+          }
+          window->setActive(false);
+        }
+        shownLast = batch.last;
+        if (!--pendingBatches && !batch.last) {
+          std::lock_guard<std::mutex> coutGuard{coutMtx};
+          std::cout << "Status: buffering.                                   "
+                       "                          \r";
+        }
+        windowCv.notify_all();
+      };
+    }
+
+    // compose and sink mostly wait on the processing and on the output, so
+    // the graph gets a thread for each on top of the ones doing the computing
+    constexpr int flowStages{2};
+    tbb::global_control flowThreads{
+        tbb::global_control::max_allowed_parallelism,
+        std::thread::hardware_concurrency() + flowStages};
+    tbb::task_arena flowArena{flowStages + 1};
+    std::optional<tbb::flow::graph> flow{};
+    // the graph runs its nodes in the arena it's made in
+    flowArena.execute([&] { flow.emplace(); });
+
+    // the composition draws on ROOT canvases off the main thread, they are
+    // only ever rasterized
+    gROOT->SetBatch(true);
+
+    // a failing stage stops the others
+    auto stopOnError{[&](auto const& stage) {
+      try {
+        stage();
+      } catch (...) {
+        stop.store(true);
+        throw;
+      }
+    }};
+    std::exception_ptr simulateError{};
+    std::exception_ptr processError{};
+
+    std::atomic<bool> processingOver{false};
+    std::thread simulateThread{[&, nIters] {
+      try {
+        stopOnError([&] {
+          std::visit(
+              [&](auto& g) {
+                g.simulate(nIters, output, [&] { return stop.load(); });
+              },
+              gas);
+        });
+      } catch (...) {
+        simulateError = std::current_exception();
+        return;
+      }
+      std::lock_guard<std::mutex> coutGuard{coutMtx};
+      std::cout << "Simulation done.                                    "
+                   "         \r"
+                << std::endl;
+    }};
+    std::thread processThread{[&, mfpMemory] {
+      try {
+        stopOnError([&] {
+          if (videoOpt != GS::VideoOpts::justStats) {
+            // process stats and graphics
+            output.processData(camera, style, mfpMemory,
+                               [&] { return stop.load(); });
+          } else {
+            // process only stats
+            output.processData(mfpMemory, [&] { return stop.load(); });
+          }
+        });
+      } catch (...) {
+        processError = std::current_exception();
+      }
+      // lets the composition end in any case
+      processingOver.store(true);
+      if (!processError) {
+        std::lock_guard<std::mutex> coutGuard{coutMtx};
+        std::cout << "Data processing done.                               "
+                     "         \r"
+                  << std::endl;
+      }
+    }};
+
+    double const bufferFrames{saveVideo ? 0.
+                                        : output.getFramerate() *
+                                              targetBufferTime};
+    bool composedLast{false};  // only used by the compose node
+    tbb::flow::input_node<FrameBatch> composeNode{
+        *flow, [&](tbb::flow_control& fc) {
+          FrameBatch batch{};
+          if (composedLast || stop.load()) {
+            fc.stop();
+            return batch;
+          }
+          stopOnError([&] {
+            while (static_cast<double>(batch.frames.size()) <= bufferFrames &&
+                   !batch.last && !stop.load()) {
+              // read before composing, so that the last composition takes
+              // everything processing published
+              batch.last = processingOver.load();
+              if (!batch.last) {
+                output.waitForResults(std::chrono::milliseconds(100));
+              }
+              std::vector<sf::Texture> v{output.getVideo(
+                  videoOpt, {windowSize.x, windowSize.y}, placeHolder,
+                  *graphsList, true, fitLambda, drawLambdas)};
+              processedFrames.fetch_add(static_cast<int>(v.size()));
+              batch.frames.insert(batch.frames.end(),
+                                  std::make_move_iterator(v.begin()),
+                                  std::make_move_iterator(v.end()));
+            }
+          });
+          composedLast = batch.last;
+          ++pendingBatches;
+          return batch;
+        }};
+    // a token for the batch being played and one for the next
+    tbb::flow::limiter_node<FrameBatch> batchTokens{*flow, 2};
+    tbb::flow::function_node<FrameBatch, tbb::flow::continue_msg> sinkNode{
+        *flow, tbb::flow::serial, [&](FrameBatch batch) {
+          stopOnError([&] { playBatch(batch); });
+          return tbb::flow::continue_msg{};
+        }};
+    tbb::flow::make_edge(composeNode, batchTokens);
+    tbb::flow::make_edge(batchTokens, sinkNode);
+    tbb::flow::make_edge(sinkNode, batchTokens.decrementer());
+
+    {
+      std::lock_guard<std::mutex> coutGuard{coutMtx};
+      std::cout << "Starting simulation, processing and video composition."
+                << std::endl;
+    }
+    flowArena.execute([&] { composeNode.activate(); });
 
-      // buffering thread
+    if (window) {
       sf::Sprite bufferingWheel;
       bufferingWheel.setTexture(bufferingWheelT, true);
       bufferingWheel.setOrigin(
@@ -776,145 +1080,104 @@ int main(int argc, const char* argv[]) {
               static_cast<float>(windowSize.y) * 0.2f);
       progressText.setPosition(static_cast<float>(windowSize.y) * .05f,
                                static_cast<float>(windowSize.y) * .05f);
-      std::thread bufferingLoop{[&, frameTimems]() {
-        sf::Sprite auxS;
-        sf::Event e;
-        while (!bufferKillSignal.load()) {
-          if (!pauseBufferLoop) {
-            std::lock_guard<std::mutex> windowGuard{windowMtx};
-            auxS.setTexture(lastWindowTxtr, true);
-            while (window.isOpen() && !pauseBufferLoop.load() &&
-                   !bufferKillSignal.load()) {
-              while (window.pollEvent(e)) {
-                if (e.type == sf::Event::Closed) {
-                  stop.store(true);
-                  bufferKillSignal.store(true);
-                  pauseBufferLoop.store(true);
-                  window.close();
-                  break;
-                }
-              }
-              // avoid drawing an extra frame on window close
-              if (!window.isOpen()) {
-                break;
-              }
-              window.setActive();
-              window.draw(auxS);  // repaint last window texture
-                                  // 120 degrees per second
-              bufferingWheel.setRotation(
-                  bufferingWheel.getRotation() +
-                  120.f * static_cast<float>(frameTimems) / 1000.f);
-              window.draw(bufferingWheel);
-              window.draw(bufferingText);
-              progressText.setString(
-                  std::to_string(output.getRawDataSize()) +
-                  " iterations awaiting processing\n" +
-                  std::to_string(output.getNStats()) + " stats instances,\n" +
-                  std::to_string(output.getNRenders()) +
-                  " renders awaiting composition\n" +
-                  std::to_string(processedFrames.load()) + " processed frames");
-              window.draw(progressText);
-              window.display();
-            }
-            window.setActive(false);
-            if (!window.isOpen()) {
-              break;
-            }
-            if (bufferKillSignal.load()) {
-              break;
-            }
-          } else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(frameTimems));
-          }
+
+      // the main thread draws the buffering screen until the last batch is
+      // shown, the display call pacing it
+      sf::Sprite auxS;
+      sf::Event e;
+      while (true) {
+        std::unique_lock<std::mutex> windowLock{windowMtx};
+        // the timeout catches a stage failing while a batch is waiting
+        windowCv.wait_for(windowLock, std::chrono::milliseconds(frameTimems),
+                          [&] {
+                            return !pendingBatches.load() || shownLast ||
+                                   stop.load();
+                          });
+        if (shownLast || stop.load() || !window->isOpen()) {
+          break;
         }
-      }};
-      bool lastBatch{false};
-
-      // main thread composes video and sends batches through playthreads
-      while (!stop.load()) {
-        std::shared_ptr<std::vector<sf::Texture>> rendersPtr{
-            std::make_shared<std::vector<sf::Texture>>()};
-        rendersPtr->reserve(static_cast<size_t>(output.getFramerate()) * 10);
-        while (static_cast<double>(rendersPtr->size()) <=
-                   output.getFramerate() * targetBufferTime &&
-               !stop.load()) {
-          if (output.isDone() &&
-              output.getRawDataSize() < output.getStatSize() &&
-              !output.isProcessing()) {
-            lastBatch = true;
-          }
-          std::vector<sf::Texture> v = {output.getVideo(
-              videoOpt, {windowSize.x, windowSize.y}, placeHolder, *graphsList,
-              true, fitLambda, drawLambdas)};
-          processedFrames.fetch_add(static_cast<int>(v.size()));
-          rendersPtr->insert(rendersPtr->end(),
-                             std::make_move_iterator(v.begin()),
-                             std::make_move_iterator(v.end()));
-          if (lastBatch) {
-            break;
-          }
+        if (pendingBatches.load()) {
+          continue;
         }
-        if (!lastBatch) {
-          std::thread playThread{
-              [playLambda, rendersPtr, &launchedPlayThreadsN] {
-                launchedPlayThreadsN.fetch_add(1);
-                playLambda(rendersPtr, launchedPlayThreadsN);
-              }};
-          if (!stop.load()) {
-            playThread.detach();
-          } else {
-            playThread.join();
-            bufferKillSignal.store(true);
-            {
-              std::lock_guard<std::mutex> coutGuard{coutMtx};
-              std::cout
-                  << "Window close detected through stop signal. Aborting."
-                  << std::endl;
-            }
+        while (window->pollEvent(e)) {
+          if (e.type == sf::Event::Closed) {
+            stop.store(true);
+            window->close();
             break;
           }
-        } else {
-          std::thread playThread{
-              [playLambda, rendersPtr, &launchedPlayThreadsN] {
-                launchedPlayThreadsN.fetch_add(1);
-                playLambda(rendersPtr, launchedPlayThreadsN.load());
-              }};
-          playThread.join();
-          bufferKillSignal.store(true);
-          {
-            std::lock_guard<std::mutex> coutGuard{coutMtx};
-            std::cout << "Done displaying. Closing window." << std::endl;
-          }
+        }
+        // avoid drawing an extra frame on window close
+        if (!window->isOpen()) {
           break;
         }
-      }  // while (!stop.load())
-      pauseBufferLoop.store(true);
-      // likely redundant, but one can never be too sure
-      bufferKillSignal.store(true);
-      if (bufferingLoop.joinable()) {
-        bufferingLoop.join();
+        window->setActive();
+        auxS.setTexture(lastWindowTxtr, true);
+        window->draw(auxS);  // repaint last window texture
+                             // 120 degrees per second
+        bufferingWheel.setRotation(
+            bufferingWheel.getRotation() +
+            120.f * static_cast<float>(frameTimems) / 1000.f);
+        window->draw(bufferingWheel);
+        window->draw(bufferingText);
+        progressText.setString(
+            std::to_string(output.getRawDataSize()) +
+            " iterations awaiting processing\n" +
+            std::to_string(output.getNStats()) + " stats instances,\n" +
+            std::to_string(output.getNRenders()) +
+            " renders awaiting composition\n" +
+            std::to_string(processedFrames.load()) + " processed frames\n" +
+            std::to_string(static_cast<int>(
+                output.getQueueStatus(GS::PipelineQueue::rawData)
+                    .blockedTime)) +
+            " s the simulation waited for processing\n" +
+            memoryText(output.memoryUsage()));
+        window->draw(progressText);
+        window->display();
+        window->setActive(false);
+      }
+      if (stop.load()) {
+        std::lock_guard<std::mutex> coutGuard{coutMtx};
+        std::cout << "Window close detected through stop signal. Aborting."
+                  << std::endl;
       }
+    }
 
-      std::lock_guard<std::mutex> windowGuard{windowMtx};
-      if (window.isOpen()) {
-        window.close();
+    // a failure stops every stage, it's rethrown once they are all done
+    std::exception_ptr flowError{};
+    try {
+      flow->wait_for_all();
+    } catch (...) {
+      flowError = std::current_exception();
+    }
+    simulateThread.join();
+    processThread.join();
+    for (std::exception_ptr error : {simulateError, processError, flowError}) {
+      if (error) {
+        std::rethrow_exception(error);
       }
-      std::lock_guard<std::mutex> coutGuard{coutMtx};
-      std::cout << "Dropped frames: " << droppedFrames.load()
-                << ". Leftover data: " << output.getRawDataSize()
-                << " collisions." << std::endl;
     }
 
-    /* VIDEO COMPOSITION-OUTPUT PHASE */
+    /* VIDEO COMPOSITION-OUTPUT PHASE END */
 
     /* END PHASE */
 
-    if (simThread.joinable()) {
-      simThread.join();
-    }
-    if (processThread.joinable()) {
-      processThread.join();
+    if (window) {
+      {
+        std::lock_guard<std::mutex> windowGuard{windowMtx};
+        if (window->isOpen()) {
+          window->close();
+        }
+      }
+      std::lock_guard<std::mutex> coutGuard{coutMtx};
+      if (!stop.load()) {
+        std::cout << "Done displaying. Closing window." << std::endl;
+      }
+      std::cout << "Dropped frames: " << droppedFrames
+                << ". Leftover data: " << output.getRawDataSize()
+                << " collisions." << std::endl;
     }
+    // waits for the encoder to finish
+    ffmpeg.reset();
 
     // all threads should be done by now, but just to be safe
     std::lock_guard<std::mutex> coutGuard{coutMtx};
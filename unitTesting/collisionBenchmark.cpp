@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "PhysicsEngine/Gas.hpp"
+#include "PhysicsEngine/Particle.hpp"
+#include "PhysicsEngine/ParticleSoA.hpp"
+
+namespace GS {
+// implemented in Gas.cpp
+template <typename FP>
+double collisionTime(BasicParticle<FP> const& p1, BasicParticle<FP> const& p2);
+}  // namespace GS
+
+// earliest collision over all couples, AoS layout, one pair at a time
+std::pair<double, size_t> aosSearch(std::vector<GS::Particle> const& ps) {
+  std::pair<double, size_t> best{INFINITY, 0};
+  for (size_t i{0}; i < ps.size(); ++i) {
+    for (size_t j{i + 1}; j < ps.size(); ++j) {
+      if ((ps[i].position - ps[j].position) * (ps[i].speed - ps[j].speed) <=
+          0.) {
+        double t{GS::collisionTime(ps[i], ps[j])};
+        if (t < best.first) {
+          best = {t, i * ps.size() + j};
+        }
+      }
+    }
+  }
+  return best;
+}
+
+template <typename FP, typename Kernel>
+std::pair<double, size_t> soaSearch(GS::ParticleSoA<FP> const& soa,
+                                    double diameter2, Kernel kernel) {
+  std::pair<double, size_t> best{INFINITY, 0};
+  for (size_t i{0}; i < soa.size(); ++i) {
+    std::pair<double, size_t> c{kernel(soa, i, i + 1, soa.size(), diameter2)};
+    if (c.first < best.first) {
+      best = {c.first, i * soa.size() + c.second};
+    }
+  }
+  return best;
+}
+
+// firstCollision is overloaded on the precision
+template <typename FP>
+std::pair<double, size_t> simdKernel(GS::ParticleSoA<FP> const& soa, size_t i,
+                                     size_t first, size_t last,
+                                     double diameter2) {
+  return GS::firstCollision(soa, i, first, last, diameter2);
+}
+
+// average nanoseconds per couple check of search
+template <typename Search>
+double timeSearch(Search search, size_t nP, std::pair<double, size_t>& result) {
+  size_t reps{std::max<size_t>(20000000 / (nP * nP), 3)};
+  auto start{std::chrono::steady_clock::now()};
+  for (size_t r{0}; r < reps; ++r) {
+    result = search();
+  }
+  std::chrono::duration<double, std::nano> elapsed{
+      std::chrono::steady_clock::now() - start};
+  return elapsed.count() / static_cast<double>(reps * nP * (nP - 1) / 2);
+}
+
+template <typename FP>
+double totalEnergy(GS::BasicGas<FP> const& gas) {
+  return std::accumulate(
+      gas.getParticles().begin(), gas.getParticles().end(), 0.,
+      [](double acc, GS::BasicParticle<FP> const& p) {
+        return acc + GS::energy(p);
+      });
+}
+
+// average microseconds per event of iters events
+template <typename FP>
+double timeSimulate(GS::BasicGas<FP>& gas, size_t iters) {
+  auto start{std::chrono::steady_clock::now()};
+  gas.simulate(iters);
+  std::chrono::duration<double, std::micro> elapsed{
+      std::chrono::steady_clock::now() - start};
+  return elapsed.count() / static_cast<double>(iters);
+}
+
+int main() {
+  GS::Particle::setMass(1.);
+  GS::Particle::setRadius(1.);
+  double const r{GS::Particle::getRadius()};
+  double diameter2{4. * (r * r)};
+
+  std::cout << "Collision kernel picked for " << GS::collisionKernelISA()
+            << "\nns per couple check:\n"
+            << "particles | AoS collisionTime | SoA scalar | SoA simd | "
+               "SoA simd float\n";
+  for (size_t nP : {size_t{64}, size_t{256}, size_t{1024}, size_t{4096}}) {
+    GS::Gas gas{nP, 10., 20. * std::cbrt(static_cast<double>(nP) / 50.)};
+    std::vector<GS::Particle> const& ps{gas.getParticles()};
+    GS::ParticleSoA soa{ps};
+    GS::GasF gasF{nP, 10., 20. * std::cbrt(static_cast<double>(nP) / 50.)};
+    GS::ParticleSoA soaF{gasF.getParticles()};
+
+    std::pair<double, size_t> aosRes{};
+    std::pair<double, size_t> scalarRes{};
+    std::pair<double, size_t> simdRes{};
+    std::pair<double, size_t> floatRes{};
+    double aosT{timeSearch([&] { return aosSearch(ps); }, nP, aosRes)};
+    double scalarT{timeSearch(
+        [&] {
+          return soaSearch(soa, diameter2, GS::firstCollisionScalar<double>);
+        },
+        nP, scalarRes)};
+    double simdT{timeSearch(
+        [&] { return soaSearch(soa, diameter2, simdKernel<double>); }, nP,
+        simdRes)};
+    double floatT{timeSearch(
+        [&] { return soaSearch(soaF, diameter2, simdKernel<float>); }, nP,
+        floatRes)};
+
+    std::cout << nP << " | " << aosT << " | " << scalarT << " | " << simdT
+              << " | " << floatT << '\n';
+    if (aosRes != scalarRes || aosRes != simdRes) {
+      std::cout << "Benchmark error: searches found different collisions\n";
+      return 1;
+    }
+  }
+
+  std::cout << "\nus per brute force event:\nparticles | brute force\n";
+  for (size_t nP : {size_t{64}, size_t{256}, size_t{1024}}) {
+    GS::Gas gas{nP, 10., 20. * std::cbrt(static_cast<double>(nP) / 50.)};
+    gas.setCollSearch(GS::CollSearch::bruteForce);
+    size_t iters{std::max<size_t>(20000000 / (nP * nP), 3)};
+    auto start{std::chrono::steady_clock::now()};
+    gas.simulate(iters);
+    std::chrono::duration<double, std::micro> elapsed{
+        std::chrono::steady_clock::now() - start};
+    std::cout << nP << " | " << elapsed.count() / static_cast<double>(iters)
+              << '\n';
+  }
+
+  // same initial conditions in both precisions, compared after each chunk
+  std::cout << "\nsingle vs double precision, cell grid search, 4096 "
+               "particles:\nevents | us per event double | float | relative "
+               "energy drift double | float\n";
+  GS::Gas gasD{4096, 10., 20. * std::cbrt(4096. / 50.), 0., 1234};
+  GS::GasF gasF{4096, 10., 20. * std::cbrt(4096. / 50.), 0., 1234};
+  double const e0D{totalEnergy(gasD)};
+  double const e0F{totalEnergy(gasF)};
+  size_t const chunk{20000};
+  for (size_t events{chunk}; events <= 10 * chunk; events += chunk) {
+    double usD{timeSimulate(gasD, chunk)};
+    double usF{timeSimulate(gasF, chunk)};
+    std::cout << events << " | " << usD << " | " << usF << " | "
+              << std::abs(totalEnergy(gasD) - e0D) / e0D << " | "
+              << std::abs(totalEnergy(gasF) - e0F) / e0F << '\n';
+  }
+}
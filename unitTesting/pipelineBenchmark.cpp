@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <TH1.h>
+
+#include "DataProcessing/GasData.hpp"
+#include "DataProcessing/SimDataPipeline.hpp"
+#include "DataProcessing/TdStats.hpp"
+#include "PhysicsEngine/Gas.hpp"
+#include "PhysicsEngine/Particle.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// microseconds from the hand-off of each batch of statSize events to the
+// publication of its stat, a batch being added every period
+std::vector<double> statLatencies(size_t nP, size_t statSize, size_t nBatches,
+                                  std::chrono::microseconds period) {
+  GS::Gas gas{nP, 10., 20. * std::cbrt(static_cast<double>(nP) / 50.), 0.,
+              42};
+  std::vector<std::vector<GS::GasData>> batches{};
+  for (size_t b{0}; b < nBatches; ++b) {
+    batches.emplace_back(gas.rawDataSimulate(statSize));
+  }
+  TH1D speedsH{"speedsH", "speedsH", 20, 0., 10.};
+  GS::SimDataPipeline output{statSize, 60., speedsH};
+  output.setStatChunkSize(1);
+
+  std::vector<Clock::time_point> handOffs(nBatches);
+  std::thread producer{[&] {
+    Clock::time_point next{Clock::now()};
+    for (size_t b{0}; b < nBatches; ++b) {
+      std::this_thread::sleep_until(next);
+      next += period;
+      handOffs[b] = Clock::now();
+      output.addData(std::move(batches[b]));
+    }
+    output.setDone();
+  }};
+  std::thread consumer{[&] { output.processData(false); }};
+
+  std::vector<double> latencies{};
+  while (latencies.size() < nBatches) {
+    std::vector<GS::TdStats> stats{output.getStats(true)};
+    Clock::time_point now{Clock::now()};
+    if (stats.empty()) {
+      std::this_thread::yield();
+    }
+    for (size_t s{0}; s < stats.size(); ++s) {
+      std::chrono::duration<double, std::micro> latency{
+          now - handOffs[latencies.size()]};
+      latencies.push_back(latency.count());
+    }
+  }
+  producer.join();
+  consumer.join();
+  return latencies;
+}
+
+double percentile(std::vector<double> v, double p) {
+  std::sort(v.begin(), v.end());
+  return v[static_cast<size_t>(p * static_cast<double>(v.size() - 1))];
+}
+
+int main() {
+  GS::Particle::setMass(1.);
+  GS::Particle::setRadius(1.);
+
+  std::cout << "event to stat latency, us\n"
+            << "particles | stat size | period us | p50 | p99 | max\n";
+  for (size_t nP : {size_t{100}, size_t{1000}}) {
+    for (size_t statSize : {size_t{100}, size_t{1000}}) {
+      for (long period : {2000L, 10000L}) {
+        std::vector<double> l{statLatencies(nP, statSize, 200,
+                                            std::chrono::microseconds(period))};
+        std::cout << nP << " | " << statSize << " | " << period << " | "
+                  << percentile(l, 0.5) << " | " << percentile(l, 0.99)
+                  << " | " << percentile(l, 1.) << '\n';
+      }
+    }
+  }
+}
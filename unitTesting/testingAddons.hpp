@@ -9,9 +9,11 @@
 
 namespace GS {
 
-struct Particle;
+template <typename FP>
+struct BasicParticle;
 
-double collisionTime(Particle const& p1, Particle const& p2);
+template <typename FP>
+double collisionTime(BasicParticle<FP> const& p1, BasicParticle<FP> const& p2);
 
 struct randomThreadsMgr {
   randomThreadsMgr() { threads.reserve(1000); }
@@ -1,7 +1,17 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
 #include <numeric>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -9,19 +19,31 @@
 #include "doctest.h"
 
 #include <SFML/Graphics/Color.hpp>
+#include <SFML/Graphics/Image.hpp>
 #include <SFML/Graphics/Texture.hpp>
 
 #include <TH1.h>
 
+#include <tbb/global_control.h>
+#include <tbb/task_arena.h>
+
+#include "DataProcessing/Checkpoint.hpp"
+#include "DataProcessing/EventRing.hpp"
+#include "DataProcessing/FixedHistogram.hpp"
 #include "DataProcessing/GasData.hpp"
+#include "DataProcessing/GasEnsemble.hpp"
+#include "DataProcessing/GasState.hpp"
 #include "DataProcessing/SimDataPipeline.hpp"
 #include "DataProcessing/TdStats.hpp"
 #include "Graphics/Camera.hpp"
 #include "Graphics/RenderStyle.hpp"
+#include "Graphics/SoftCanvas.hpp"
 #include "PhysicsEngine/Collision.hpp"
 #include "PhysicsEngine/GSVector.hpp"
 #include "PhysicsEngine/Gas.hpp"
 #include "PhysicsEngine/Particle.hpp"
+#include "PhysicsEngine/ParticleSoA.hpp"
+#include "PhysicsEngine/WorkerPool.hpp"
 #include "testingAddons.hpp"
 
 // setting particle mass and radius
@@ -285,6 +307,27 @@ TEST_CASE("Testing Gas constructor") {
     }
     CHECK_NOTHROW(GS::Particle::setRadius(1.));
   }
+  SUBCASE("Radius and mass frozen at construction") {
+    GS::Gas g{8, 2., 10.};
+    CHECK(g.getRadius() == 1.);
+    CHECK(g.getMass() == 10.);
+    GS::Particle::setMass(5.);
+    // copies keep the mass of the original, new gases read the current one
+    GS::Gas copy{g};
+    CHECK(g.getMass() == 10.);
+    CHECK(copy.getMass() == 10.);
+    CHECK(GS::Gas{}.getMass() == 5.);
+    // records, states and the stats built on them carry the gas values
+    std::vector<GS::GasData> data{g.rawDataSimulate(5)};
+    CHECK(data[4].getMass() == 10.);
+    CHECK(data[4].getRadius() == 1.);
+    GS::GasState state{data[0]};
+    CHECK(state.getMass() == 10.);
+    TH1D emptyH{};
+    CHECK(GS::TdStats{state, emptyH}.getTemp() ==
+          doctest::Approx(state.getEnergy(10.) * 2. / 24.));
+    GS::Particle::setMass(10.);
+  }
   SUBCASE("Throwing behaviour") {
     // Negative and null box side
     CHECK_THROWS(GS::Gas(0, 1., -1.));
@@ -347,6 +390,45 @@ TEST_CASE("Testing Gas constructor") {
           10.);
     GS::Gas rndGas0{0, 0., 10.};
     CHECK(rndGas0.getParticles().size() == 0);
+
+    // seeded gases don't depend on the number of generating threads
+    GS::Gas seeded{1000, 10., 100., 0., 42};
+    {
+      tbb::global_control serial{
+          tbb::global_control::max_allowed_parallelism, 1};
+      GS::Gas serialSeeded{1000, 10., 100., 0., 42};
+      CHECK(serialSeeded.getParticles() == seeded.getParticles());
+    }
+    CHECK(GS::Gas(1000, 10., 100., 0., 43).getParticles() !=
+          seeded.getParticles());
+  }
+  SUBCASE("Grid overlap validation") {
+    GS::Gas lattice{1000, 10., 100., 0., 3};
+    std::vector<GS::Particle> ps{lattice.getParticles()};
+    CHECK_NOTHROW(GS::Gas(std::vector<GS::Particle>(ps), 100.));
+    // couples across a cell boundary, the cells are 10 wide here
+    ps[998].position = {9.2, 50.5, 50.5};
+    ps[999].position = {10.8, 50.5, 50.5};
+    CHECK_THROWS(GS::Gas(std::vector<GS::Particle>(ps), 100.));
+    ps[999].position = {11.3, 50.5, 50.5};
+    CHECK_NOTHROW(GS::Gas(std::vector<GS::Particle>(ps), 100.));
+    // couples in the same cell
+    ps[1].position = ps[0].position + GS::GSVectorD{0., 0., 1.99};
+    CHECK_THROWS(GS::Gas(std::vector<GS::Particle>(ps), 100.));
+  }
+  SUBCASE("Memory usage") {
+    GS::Gas gas{300, 10., 100., 0., 3};
+    GS::GasMemoryUsage estimate{GS::Gas::estimateMemory(300)};
+    CHECK(gas.memoryUsage().particles == 300 * sizeof(GS::Particle));
+    CHECK(gas.memoryUsage().calendar == 0);
+    gas.simulate(3000);
+    // local times included
+    CHECK(gas.memoryUsage().particles == estimate.particles);
+    CHECK(gas.memoryUsage().calendar > 0);
+    CHECK(gas.memoryUsage().calendar <= estimate.calendar);
+    CHECK(gas.memoryUsage().soa == 0);
+    CHECK(GS::Gas::estimateMemory(300, GS::CollSearch::bruteForce).soa ==
+          6 * 304 * sizeof(double));
   }
 }
 
@@ -557,6 +639,255 @@ TEST_CASE("Testing Gas::simulate method") {
   }
 }
 
+TEST_CASE("Testing the collision calendar against the brute force search") {
+  // rounding differences between the searches get amplified by the chaotic
+  // dynamics, so only a limited number of iterations is compared
+  GS::Gas bruteForceGas{30, 10., 20.};
+  CHECK(bruteForceGas.getCollSearch() == GS::CollSearch::cellGrid);
+  GS::Gas calendarGas{bruteForceGas};
+  GS::Gas gridGas{bruteForceGas};
+  bruteForceGas.setCollSearch(GS::CollSearch::bruteForce);
+  calendarGas.setCollSearch(GS::CollSearch::calendar);
+
+  std::vector<GS::GasData> bruteForceData{bruteForceGas.rawDataSimulate(100)};
+  std::vector<GS::GasData> calendarData{calendarGas.rawDataSimulate(100)};
+  std::vector<GS::GasData> gridData{gridGas.rawDataSimulate(100)};
+
+  for (std::vector<GS::GasData> const* data : {&calendarData, &gridData}) {
+    for (size_t i{0}; i < 100; ++i) {
+      GS::GasData const& d{(*data)[i]};
+      REQUIRE(d.getCollType() == bruteForceData[i].getCollType());
+      CHECK(d.getP1Index() == bruteForceData[i].getP1Index());
+      if (d.getCollType() == 'p') {
+        CHECK(d.getP2Index() == bruteForceData[i].getP2Index());
+      } else {
+        CHECK(d.getWall() == bruteForceData[i].getWall());
+      }
+      CHECK(d.getTime() ==
+            doctest::Approx(bruteForceData[i].getTime()).epsilon(1E-9));
+    }
+  }
+
+  // switching mode mid-simulation must not break the event sequence
+  calendarGas.setCollSearch(GS::CollSearch::cellGrid);
+  gridGas.setCollSearch(GS::CollSearch::bruteForce);
+  bruteForceGas.setCollSearch(GS::CollSearch::calendar);
+  CHECK_NOTHROW(calendarGas.simulate(10));
+  CHECK_NOTHROW(gridGas.simulate(10));
+  CHECK_NOTHROW(bruteForceGas.simulate(10));
+}
+
+TEST_CASE("Testing the delayed particle state") {
+  // seeded, rounding differences between both gases grow with the collisions
+  // and some random gases drift past the tolerance within 100 events
+  GS::Gas delayedGas{30, 10., 20., 0., 3};
+  CHECK(delayedGas.getDelayedState());
+  GS::Gas eagerGas{delayedGas};
+  eagerGas.setDelayedState(false);
+
+  std::vector<GS::GasData> delayedData{delayedGas.rawDataSimulate(50)};
+  std::vector<GS::GasData> eagerData{eagerGas.rawDataSimulate(50)};
+  CHECK(delayedData[0].isKeyframe());
+  CHECK_FALSE(delayedData[1].isKeyframe());
+  CHECK_THROWS_AS(delayedData[1].getParticles(), std::logic_error);
+  // rebuilt states must show every particle at the event time
+  GS::GasState delayedState{delayedData[0]};
+  GS::GasState eagerState{eagerData[0]};
+  for (size_t i{0}; i < 50; ++i) {
+    REQUIRE(delayedData[i].getP1Index() == eagerData[i].getP1Index());
+    delayedState.apply(delayedData[i]);
+    eagerState.apply(eagerData[i]);
+    for (size_t j{0}; j < 30; ++j) {
+      GS::GSVectorD delayedPos{delayedState.getParticles()[j].position};
+      GS::GSVectorD eagerPos{eagerState.getParticles()[j].position};
+      CHECK((delayedPos - eagerPos).norm() ==
+            doctest::Approx(0.).epsilon(1E-9));
+    }
+  }
+
+  delayedGas.simulate(50);
+  eagerGas.simulate(50);
+  CHECK(delayedGas.getTime() == doctest::Approx(eagerGas.getTime()));
+  for (size_t j{0}; j < 30; ++j) {
+    GS::Particle const& p{delayedGas.getParticles()[j]};
+    CHECK((p.position - eagerGas.getParticles()[j].position).norm() ==
+          doctest::Approx(0.).epsilon(1E-9));
+    // the last particle to hit a wall may be a rounding error past it
+    for (double x : {p.position.x, p.position.y, p.position.z}) {
+      CHECK(x > 1. - 1E-9);
+      CHECK(x < 19. + 1E-9);
+    }
+  }
+}
+
+TEST_CASE("Testing the SoA collision kernel") {
+  GS::Gas gas{37, 10., 15.};
+  std::vector<GS::Particle> const& ps{gas.getParticles()};
+  GS::ParticleSoA soa{ps};
+  CHECK(soa.size() == 37);
+  CHECK(soa.paddedSize() % GS::ParticleSoA<double>::simdWidth == 0);
+  CHECK(reinterpret_cast<std::uintptr_t>(soa.vz.data()) % 64 == 0);
+  CHECK(std::isnan(soa.x[37]));
+
+  double const r{GS::Particle::getRadius()};
+  // the kernels compute in the particles' precision, as collisionTime does
+  auto checkRows{[&](auto const& particles, auto const& arrays) {
+    for (size_t i{0}; i < 37; ++i) {
+      // full rows use the padding, partial ones the scalar tail
+      for (size_t last : {size_t{37}, size_t{30}}) {
+        std::pair<double, size_t> expected{INFINITY, last};
+        for (size_t j{i + 1}; j < last; ++j) {
+          if ((particles[i].position - particles[j].position) *
+                  (particles[i].speed - particles[j].speed) <=
+              0.) {
+            double t{GS::collisionTime(particles[i], particles[j])};
+            if (t < expected.first) {
+              expected = {t, j};
+            }
+          }
+        }
+        std::pair<double, size_t> simd{
+            GS::firstCollision(arrays, i, i + 1, last, 4. * (r * r))};
+        CHECK(simd == expected);
+        CHECK(GS::firstCollisionScalar(arrays, i, i + 1, last,
+                                       4. * (r * r)) == expected);
+      }
+    }
+  }};
+  checkRows(ps, soa);
+
+  GS::GasF gasF{37, 10., 15.};
+  GS::ParticleSoA soaF{gasF.getParticles()};
+  CHECK(soaF.paddedSize() % GS::ParticleSoA<float>::simdWidth == 0);
+  CHECK(std::isnan(soaF.vx[37]));
+  checkRows(gasF.getParticles(), soaF);
+
+  std::string isa{GS::collisionKernelISA()};
+  CHECK((isa == "avx512" || isa == "avx2" || isa == "scalar"));
+
+  SUBCASE("Updates") {
+    std::vector<GS::Particle> moved{ps};
+    for (GS::Particle& p : moved) {
+      p.position += p.speed * 0.3;
+    }
+    moved[5].speed = {1., -2., 3.};
+    soa.move(0.3);
+    soa.set(5, moved[5]);
+    for (size_t i{0}; i < 37; ++i) {
+      CHECK(soa.x[i] == moved[i].position.x);
+      CHECK(soa.y[i] == moved[i].position.y);
+      CHECK(soa.z[i] == moved[i].position.z);
+      CHECK(soa.vx[i] == moved[i].speed.x);
+    }
+    CHECK(std::isnan(soa.x[37]));
+    soa.clear();
+    CHECK(soa.size() == 0);
+    CHECK(soa.memoryUsage() == 0);
+  }
+}
+
+TEST_CASE("Testing the single precision gas") {
+  GS::GasF gas{30, 10., 20., 0., 42};
+  GS::Gas doubleGas{30, 10., 20., 0., 42};
+  CHECK(GS::Gas::gasInstances() >= 2);
+  // same initial conditions, rounded to float
+  for (size_t i{0}; i < 30; ++i) {
+    CHECK(gas.getParticles()[i].position ==
+          GS::GSVectorF{doubleGas.getParticles()[i].position});
+  }
+
+  auto gasEnergy{[](auto const& g) {
+    double e{0.};
+    for (auto const& p : g.getParticles()) {
+      e += GS::energy(p);
+    }
+    return e;
+  }};
+  double const e0{gasEnergy(gas)};
+  CHECK(e0 == doctest::Approx(30. * 3. / 2. * 10.).epsilon(1E-5));
+
+  for (GS::CollSearch search : {GS::CollSearch::cellGrid,
+                                GS::CollSearch::calendar,
+                                GS::CollSearch::bruteForce}) {
+    gas.setCollSearch(search);
+    double const t0{gas.getTime()};
+    std::vector<GS::GasData> data{gas.rawDataSimulate(200)};
+    REQUIRE(data.size() == 200);
+    CHECK(gas.getTime() > t0);
+    CHECK(data.back().getTime() == gas.getTime());
+    GS::GasState state{data[0]};
+    for (GS::GasData const& d : data) {
+      state.apply(d);
+    }
+    // rebuilt states are extrapolated in double precision, a particle that
+    // just hit a wall may be a rounding error past it
+    for (size_t i{0}; i < 30; ++i) {
+      GS::GSVectorF const& pos{gas.getParticles()[i].position};
+      CHECK((state.getParticles()[i].position - GS::GSVectorD{pos}).norm() ==
+            doctest::Approx(0.).epsilon(1E-4));
+      for (float x : {pos.x, pos.y, pos.z}) {
+        CHECK(x > 1.f - 1E-4f);
+        CHECK(x < 19.f + 1E-4f);
+      }
+    }
+    CHECK(gasEnergy(gas) == doctest::Approx(e0).epsilon(1E-5));
+  }
+}
+
+TEST_CASE("Testing the collision search worker pool") {
+  GS::Gas serialGas{30, 10., 20.};
+  serialGas.setCollSearch(GS::CollSearch::bruteForce);
+  GS::Gas parallelGas{serialGas};
+  parallelGas.setWorkerPool(std::make_shared<GS::WorkerPool>(4));
+  CHECK(parallelGas.getWorkerPool()->getThreadsN() == 4);
+  CHECK(serialGas.getWorkerPool() == nullptr);
+
+  size_t threshold{GS::Gas::getParallelThreshold()};
+  GS::Gas::setParallelThreshold(0);
+  std::vector<GS::GasData> parallelData{parallelGas.rawDataSimulate(100)};
+  GS::Gas::setParallelThreshold(SIZE_MAX);
+  std::vector<GS::GasData> serialData{serialGas.rawDataSimulate(100)};
+  GS::Gas::setParallelThreshold(threshold);
+
+  // both searches must pick the same collision on ties
+  for (size_t i{0}; i < 100; ++i) {
+    REQUIRE(parallelData[i].getCollType() == serialData[i].getCollType());
+    CHECK(parallelData[i].getP1Index() == serialData[i].getP1Index());
+    CHECK(parallelData[i].getTime() == serialData[i].getTime());
+  }
+
+  SUBCASE("Calendar build") {
+    for (GS::CollSearch search :
+         {GS::CollSearch::calendar, GS::CollSearch::cellGrid}) {
+      GS::Gas serialCal{serialGas};
+      serialCal.setCollSearch(search);
+      GS::Gas parallelCal{serialCal};
+      parallelCal.setWorkerPool(std::make_shared<GS::WorkerPool>(3));
+      GS::Gas::setParallelThreshold(0);
+      std::vector<GS::GasData> parallelEvents{parallelCal.rawDataSimulate(100)};
+      GS::Gas::setParallelThreshold(SIZE_MAX);
+      std::vector<GS::GasData> serialEvents{serialCal.rawDataSimulate(100)};
+      GS::Gas::setParallelThreshold(threshold);
+      for (size_t i{0}; i < 100; ++i) {
+        REQUIRE(parallelEvents[i].getCollType() ==
+                serialEvents[i].getCollType());
+        CHECK(parallelEvents[i].getP1Index() == serialEvents[i].getP1Index());
+        CHECK(parallelEvents[i].getTime() == serialEvents[i].getTime());
+      }
+    }
+  }
+
+  SUBCASE("Pool") {
+    GS::WorkerPool pool{3};
+    std::vector<size_t> calls(pool.getThreadsN(), 0);
+    for (int i{0}; i < 50; ++i) {
+      pool.run([&](size_t w) { ++calls[w]; });
+    }
+    CHECK(calls == std::vector<size_t>(3, 50));
+    CHECK(GS::WorkerPool{1}.getThreadsN() == 1);
+  }
+}
+
 // GRAPHICS TESTING
 
 TEST_CASE("Testing the RenderStyle class") {
@@ -583,6 +914,102 @@ TEST_CASE("Testing the RenderStyle class") {
   }
 }
 
+TEST_CASE("Testing the SoftCanvas class") {
+  GS::SoftCanvas canvas{100, 80};
+  CHECK(canvas.getSize() == sf::Vector2u{100, 80});
+  canvas.clear(sf::Color{10, 20, 30, 255});
+  // the exact sfml blending, without the alpha channel
+  auto blend{[](sf::Color src, sf::Color dst) {
+    auto channel{[&](unsigned s, unsigned d) {
+      return static_cast<sf::Uint8>(
+          std::lround((s * src.a + d * (255u - src.a)) / 255.));
+    }};
+    return sf::Color{channel(src.r, dst.r), channel(src.g, dst.g),
+                     channel(src.b, dst.b)};
+  }};
+  SUBCASE("Clearing and resizing") {
+    CHECK(canvas.getPixel(0, 0) == sf::Color{10, 20, 30, 255});
+    CHECK(canvas.getPixel(99, 79) == sf::Color{10, 20, 30, 255});
+    canvas.create(100, 80);
+    CHECK(canvas.getPixel(42, 42) == sf::Color{10, 20, 30, 255});
+    canvas.create(200, 150);
+    CHECK(canvas.getSize() == sf::Vector2u{200, 150});
+    CHECK(canvas.getPixel(199, 149) == sf::Color::Transparent);
+  }
+  SUBCASE("Blending pixels") {
+    std::vector<sf::Uint8> src{};
+    std::vector<sf::Uint8> dst{};
+    // not a multiple of the four pixels the simd kernels take
+    for (unsigned i{0}; i < 11; ++i) {
+      src.insert(src.end(), {static_cast<sf::Uint8>(23 * i),
+                             static_cast<sf::Uint8>(255 - 7 * i),
+                             static_cast<sf::Uint8>(40 * i),
+                             static_cast<sf::Uint8>(i == 5 ? 0 : 25 * i)});
+      dst.insert(dst.end(), {static_cast<sf::Uint8>(200 - 9 * i), 0, 255,
+                             static_cast<sf::Uint8>(255 - 20 * i)});
+    }
+    std::vector<sf::Uint8> blended{dst};
+    GS::blendPixels(blended.data(), src.data(), 11);
+    for (size_t i{0}; i < 11; ++i) {
+      sf::Uint8 const* s{&src[i * 4]};
+      sf::Uint8 const* d{&dst[i * 4]};
+      sf::Color expected{blend({s[0], s[1], s[2], s[3]}, {d[0], d[1], d[2]})};
+      CHECK(blended[i * 4] == expected.r);
+      CHECK(blended[i * 4 + 1] == expected.g);
+      CHECK(blended[i * 4 + 2] == expected.b);
+      CHECK(blended[i * 4 + 3] ==
+            std::lround((s[3] * 255 + d[3] * (255 - s[3])) / 255.));
+    }
+    CHECK(std::string{GS::blendKernelISA()}.size());
+  }
+  SUBCASE("Filling polygons") {
+    std::vector<sf::Vector2f> square{{2.f, 2.f}, {6.f, 2.f}, {6.f, 6.f},
+                                     {2.f, 6.f}};
+    canvas.fillPolygon(square, sf::Color::Red);
+    CHECK(canvas.getPixel(2, 2) == sf::Color::Red);
+    CHECK(canvas.getPixel(5, 5) == sf::Color::Red);
+    CHECK(canvas.getPixel(6, 5) == sf::Color{10, 20, 30, 255});
+    CHECK(canvas.getPixel(1, 1) == sf::Color{10, 20, 30, 255});
+    canvas.fillPolygon(square, sf::Color{0, 0, 255, 128}, sf::Color::Green,
+                       1.f);
+    CHECK(canvas.getPixel(3, 4) == blend({0, 0, 255, 128}, sf::Color::Red));
+    CHECK(canvas.getPixel(1, 4) == sf::Color::Green);
+    CHECK(canvas.getPixel(6, 4) == sf::Color::Green);
+    // mitered corners
+    CHECK(canvas.getPixel(1, 1) == sf::Color::Green);
+    CHECK(canvas.getPixel(6, 6) == sf::Color::Green);
+    CHECK(canvas.getPixel(7, 7) == sf::Color{10, 20, 30, 255});
+    // across tiles, clipped at the borders
+    canvas.fillPolygon({{-10.f, 60.f}, {90.f, 60.f}, {40.f, 120.f}},
+                       sf::Color::Yellow);
+    CHECK(canvas.getPixel(0, 60) == sf::Color::Yellow);
+    CHECK(canvas.getPixel(64, 64) == sf::Color::Yellow);
+    CHECK(canvas.getPixel(40, 79) == sf::Color::Yellow);
+    CHECK(canvas.getPixel(95, 70) == sf::Color{10, 20, 30, 255});
+    CHECK_NOTHROW(canvas.fillPolygon({{0.f, 0.f}, {1.f, 1.f}}, sf::Color::Red));
+  }
+  SUBCASE("Drawing sprites") {
+    sf::Image sprite{};
+    sprite.create(2, 2, sf::Color::Transparent);
+    sprite.setPixel(0, 0, sf::Color::Red);
+    sprite.setPixel(1, 0, sf::Color{0, 255, 0, 128});
+    sprite.setPixel(0, 1, sf::Color{0, 0, 255, 64});
+    // a quad on the corner of four tiles, and a smaller one next to it
+    canvas.drawSprites(sprite, {{64.f, 64.f, 10.f}, {80.f, 64.f, 2.f}});
+    sf::Color const bg{10, 20, 30, 255};
+    CHECK(canvas.getPixel(54, 54) == sf::Color::Red);
+    CHECK(canvas.getPixel(63, 63) == sf::Color::Red);
+    CHECK(canvas.getPixel(64, 54) == blend({0, 255, 0, 128}, bg));
+    CHECK(canvas.getPixel(73, 63) == blend({0, 255, 0, 128}, bg));
+    CHECK(canvas.getPixel(54, 73) == blend({0, 0, 255, 64}, bg));
+    CHECK(canvas.getPixel(70, 70) == bg);
+    CHECK(canvas.getPixel(53, 54) == bg);
+    CHECK(canvas.getPixel(74, 54) == bg);
+    CHECK(canvas.getPixel(78, 62) == sf::Color::Red);
+    CHECK(canvas.getPixel(80, 62) == blend({0, 255, 0, 128}, bg));
+  }
+}
+
 TEST_CASE("Testing the camera class") {
   GS::GSVectorF focus{0., 0., 0.};
   GS::GSVectorF sightVector{1., 0., 0.};
@@ -707,12 +1134,14 @@ TEST_CASE("Testing the GasData class and TdStats constructor throws") {
       1. / 3., const_cast<GS::Particle *>(gas.getParticles().data()),
       GS::Wall::Front};
   GS::GasData data{gas, &collision};
+  GS::GasState state{data};
 
   moreGas.simulate(1);
   GS::PPCollision moreCollision{
       1., const_cast<GS::Particle *>(&moreGas.getParticles()[1]),
       const_cast<GS::Particle *>(&moreGas.getParticles()[2])};
   GS::GasData moreData{moreGas, &moreCollision};
+  GS::GasState moreState{moreData};
 
   TH1D goodH{};
   TH1D badH{"badH", "badH", 1, 0., 1.};
@@ -745,31 +1174,32 @@ TEST_CASE("Testing the GasData class and TdStats constructor throws") {
   }
 
   SUBCASE("Verifying no-throw with good data") {
-    CHECK_THROWS(GS::TdStats{{gas, &collision}, badH});
-    GS::TdStats stats{data, goodH};
-    GS::TdStats moreStats{moreData, goodH};
+    CHECK_THROWS(GS::TdStats{state, badH});
+    GS::TdStats stats{state, goodH};
+    GS::TdStats moreStats{moreState, goodH};
     gas.simulate(1);
     GS::PWCollision secondCollision{
         1. / 6., const_cast<GS::Particle *>(gas.getParticles().data()),
         GS::Wall::Right};
     GS::GasData secondData{gas, &secondCollision};
-    SUBCASE("addData") { CHECK_NOTHROW(stats.addData(secondData)); }
+    GS::GasState secondState{secondData};
+    SUBCASE("addData") { CHECK_NOTHROW(stats.addData(secondState)); }
     SUBCASE("memory constructor") {
-      CHECK_NOTHROW(GS::TdStats(secondData, GS::TdStats(stats)));
+      CHECK_NOTHROW(GS::TdStats(secondState, GS::TdStats(stats)));
     }
     SUBCASE("memory constructor with new TH1D") {
-      CHECK_NOTHROW(GS::TdStats(secondData, GS::TdStats(stats), goodH));
+      CHECK_NOTHROW(GS::TdStats(secondState, GS::TdStats(stats), goodH));
     }
   }
 
   SUBCASE("Testing TdStats addData/memory constructors throws") {
-    CHECK_THROWS(GS::TdStats{{gas, &collision}, badH});
-    GS::TdStats stats{data, goodH};
-    GS::TdStats moreStats{moreData, goodH};
-    CHECK_THROWS(stats.addData(data));
-    CHECK_THROWS(stats.addData(moreData));
-    CHECK_THROWS(moreStats.addData(moreData));
-    CHECK_THROWS(moreStats.addData(data));
+    CHECK_THROWS(GS::TdStats{state, badH});
+    GS::TdStats stats{state, goodH};
+    GS::TdStats moreStats{moreState, goodH};
+    CHECK_THROWS(stats.addData(state));
+    CHECK_THROWS(stats.addData(moreState));
+    CHECK_THROWS(moreStats.addData(moreState));
+    CHECK_THROWS(moreStats.addData(state));
 
     GS::Gas biggerBoxGas{std::vector<GS::Particle>(particles),
                          gas.getBoxSide() * 1.5, gas.getTime()};
@@ -778,9 +1208,10 @@ TEST_CASE("Testing the GasData class and TdStats constructor throws") {
         7. / 6., const_cast<GS::Particle *>(biggerBoxGas.getParticles().data()),
         GS::Wall::Right};
     GS::GasData biggerBoxData{biggerBoxGas, &biggerBoxCollision};
-    CHECK_THROWS(stats.addData(biggerBoxData));
-    CHECK_THROWS(GS::TdStats(biggerBoxData, GS::TdStats(stats)));
-    CHECK_THROWS(GS::TdStats(biggerBoxData, GS::TdStats(stats), goodH));
+    GS::GasState biggerBoxState{biggerBoxData};
+    CHECK_THROWS(stats.addData(biggerBoxState));
+    CHECK_THROWS(GS::TdStats(biggerBoxState, GS::TdStats(stats)));
+    CHECK_THROWS(GS::TdStats(biggerBoxState, GS::TdStats(stats), goodH));
 
     GS::Gas biggerTimeGas{std::vector<GS::Particle>(particles),
                           gas.getBoxSide(), 1.};
@@ -790,9 +1221,10 @@ TEST_CASE("Testing the GasData class and TdStats constructor throws") {
         const_cast<GS::Particle *>(biggerTimeGas.getParticles().data()),
         GS::Wall::Right};
     GS::GasData biggerTimeData{biggerTimeGas, &biggerTimeCollision};
-    CHECK_THROWS(stats.addData(biggerTimeData));
-    CHECK_THROWS(GS::TdStats(biggerTimeData, GS::TdStats(stats)));
-    CHECK_THROWS(GS::TdStats(biggerTimeData, GS::TdStats(stats), goodH));
+    GS::GasState biggerTimeState{biggerTimeData};
+    CHECK_THROWS(stats.addData(biggerTimeState));
+    CHECK_THROWS(GS::TdStats(biggerTimeState, GS::TdStats(stats)));
+    CHECK_THROWS(GS::TdStats(biggerTimeState, GS::TdStats(stats), goodH));
 
     GS::Gas biggerTempGas{{GS::Particle{particles.front().position,
                                         particles.front().speed * 10}},
@@ -804,9 +1236,10 @@ TEST_CASE("Testing the GasData class and TdStats constructor throws") {
         const_cast<GS::Particle *>(biggerTempGas.getParticles().data()),
         GS::Wall::Right};
     GS::GasData biggerTempData{biggerTempGas, &biggerTempCollision};
-    CHECK_THROWS(stats.addData(biggerTempData));
-    CHECK_THROWS(GS::TdStats(biggerTempData, GS::TdStats(stats)));
-    CHECK_THROWS(GS::TdStats(biggerTempData, GS::TdStats(stats), goodH));
+    GS::GasState biggerTempState{biggerTempData};
+    CHECK_THROWS(stats.addData(biggerTempState));
+    CHECK_THROWS(GS::TdStats(biggerTempState, GS::TdStats(stats)));
+    CHECK_THROWS(GS::TdStats(biggerTempState, GS::TdStats(stats), goodH));
   }
 }
 
@@ -824,6 +1257,12 @@ TEST_CASE(
 
   gas.simulate(5, output);
   output.processData();
+  // a bigger gas, whose events the stats are built from step by step
+  GS::Gas bigGas{30, 10., 20., 0., 11};
+  std::vector<GS::GasData> data{bigGas.rawDataSimulate(300)};
+  GS::GasState state{data[0]};
+  // some speeds end up in the overflow bin
+  TH1D speedsT{"speedsT", "speedsT", 10, 0., 2.5};
   SUBCASE("Testing throws") {}
   SUBCASE("Testing the constructor") {
     GS::TdStats stats{output.getStats()[0]};
@@ -860,6 +1299,251 @@ TEST_CASE(
     CHECK(moreStats.getMeanFreePath() == 2.5);
     CHECK_THROWS(moreStats.getPressure(GS::Wall::VOID));
   }
+  SUBCASE("Incremental energy") {
+    double const mass{bigGas.getMass()};
+    size_t const interval{GS::TdStats::getEnergyCheckInterval()};
+    GS::TdStats::setEnergyCheckInterval(0);
+    GS::TdStats uncheckedStats{state, defaultH};
+    GS::TdStats::setEnergyCheckInterval(7);
+    GS::TdStats checkedStats{state, defaultH};
+    for (size_t i{1}; i < data.size(); ++i) {
+      state.apply(data[i]);
+      double e{0.};
+      for (GS::Particle const& p : state.getParticles()) {
+        e += GS::energy(p, mass);
+      }
+      CHECK(state.getEnergy(mass) == doctest::Approx(e).epsilon(1E-12));
+      CHECK_NOTHROW(uncheckedStats.addData(state));
+      CHECK_NOTHROW(checkedStats.addData(state));
+    }
+    GS::TdStats::setEnergyCheckInterval(interval);
+    CHECK(checkedStats.getTemp() == uncheckedStats.getTemp());
+    CHECK(checkedStats.getTemp() == doctest::Approx(10.).epsilon(1E-6));
+  }
+  SUBCASE("Incremental speeds histogram") {
+    std::optional<GS::TdStats> stats{};
+    TH1D filled{speedsT};
+    auto checkH{[&] {
+      TH1D h{stats->getSpeedH()};
+      CHECK(h.GetEntries() == filled.GetEntries());
+      for (int b{0}; b <= 11; ++b) {
+        CHECK(h.GetBinContent(b) == filled.GetBinContent(b));
+      }
+      CHECK(h.GetMean() == doctest::Approx(filled.GetMean()).epsilon(1E-12));
+    }};
+    for (size_t i{0}; i < data.size(); ++i) {
+      state.apply(data[i]);
+      if (i % 100 == 0) {
+        if (i) {
+          checkH();
+        }
+        stats = i ? GS::TdStats{state, std::move(*stats)}
+                  : GS::TdStats{state, speedsT};
+        filled.Reset();
+      } else {
+        stats->addData(state);
+      }
+      for (GS::Particle const& p : state.getParticles()) {
+        filled.Fill(p.speed.norm());
+      }
+    }
+    checkH();
+    CHECK(filled.GetBinContent(11) > 0.);
+  }
+  SUBCASE("Shared collision tracker") {
+    std::vector<GS::GSVectorD> lastPositions(30, {0., 0., 0.});
+    double sum{0.};
+    size_t n{0};
+    auto collide{[&](size_t i, GS::GSVectorD const& position) {
+      if (lastPositions[i] != GS::GSVectorD{0., 0., 0.}) {
+        sum += (position - lastPositions[i]).norm();
+        ++n;
+      }
+      lastPositions[i] = position;
+    }};
+    std::vector<GS::TdStats> stats{};
+    for (size_t i{0}; i < data.size(); ++i) {
+      state.apply(data[i]);
+      if (i % 100 == 0) {
+        if (i) {
+          stats.emplace_back(state, GS::TdStats(stats.back()));
+        } else {
+          stats.emplace_back(state, defaultH);
+        }
+      } else {
+        stats.back().addData(state);
+      }
+      collide(state.getP1Index(), state.getP1().position);
+      if (state.getCollType() == 'p') {
+        collide(state.getP2Index(), state.getP2().position);
+      }
+      if (i % 100 == 99) {
+        REQUIRE(stats.back().getNFreePaths() == n);
+        CHECK(stats.back().getMeanFreePath() ==
+              doctest::Approx(sum / static_cast<double>(n)));
+        CHECK(stats.back().getMemory().lastCollPositions == lastPositions);
+        sum = 0.;
+        n = 0;
+      }
+    }
+    // older stats keep their results, while the memory is the shared one
+    CHECK(stats[0].getNFreePaths() > 0);
+    CHECK(stats[0].getMemory().lastCollPositions == lastPositions);
+  }
+  SUBCASE("Merging stats") {
+    GS::TdStats whole{state, speedsT};
+    std::vector<GS::TdStats> windows{{state, speedsT}};
+    for (size_t i{1}; i < data.size(); ++i) {
+      state.apply(data[i]);
+      whole.addData(state);
+      if (i % 30 == 0) {
+        windows.emplace_back(state, GS::TdStats(windows.back()));
+      } else {
+        windows.back().addData(state);
+      }
+    }
+    REQUIRE(windows.size() == 10);
+    CHECK_THROWS_AS(GS::merge(windows[0], windows[2]), std::invalid_argument);
+    CHECK_THROWS_AS(GS::merge(windows[1], windows[0]), std::invalid_argument);
+
+    GS::TdStats merged{windows[0]};
+    for (size_t i{1}; i < windows.size(); ++i) {
+      merged = GS::merge(merged, windows[i]);
+    }
+    CHECK(merged.getTime0() == whole.getTime0());
+    CHECK(merged.getTime() == whole.getTime());
+    CHECK(merged.getPressure() == doctest::Approx(whole.getPressure()));
+    CHECK(merged.getNFreePaths() == whole.getNFreePaths());
+    CHECK(merged.getMeanFreePath() == doctest::Approx(whole.getMeanFreePath()));
+    TH1D mergedH{merged.getSpeedH()};
+    TH1D wholeH{whole.getSpeedH()};
+    CHECK(mergedH.GetEntries() == wholeH.GetEntries());
+    for (int b{0}; b <= 11; ++b) {
+      CHECK(mergedH.GetBinContent(b) == wholeH.GetBinContent(b));
+    }
+
+    // associativity, up to rounding
+    GS::TdStats left{GS::merge(GS::merge(windows[0], windows[1]), windows[2])};
+    GS::TdStats right{GS::merge(windows[0], GS::merge(windows[1], windows[2]))};
+    CHECK(left.getTime0() == right.getTime0());
+    CHECK(left.getTime() == right.getTime());
+    CHECK(left.getPressure() == doctest::Approx(right.getPressure()));
+    CHECK(left.getMeanFreePath() == doctest::Approx(right.getMeanFreePath()));
+    CHECK(left.getSpeedH().GetEntries() == right.getSpeedH().GetEntries());
+
+    // merged stats can be continued
+    std::vector<GS::GasData> moreData{bigGas.rawDataSimulate(10)};
+    GS::GasState moreState{state};
+    moreState.apply(moreData[0]);
+    CHECK_NOTHROW(GS::TdStats(moreState, GS::TdStats(merged)));
+  }
+}
+
+TEST_CASE("Testing the FixedHistogram class") {
+  TH1D binning{"binning", "binning", 8, -1., 3.};
+  GS::FixedHistogram h{binning};
+  for (double x : {-2., -1., -0.5, 0., 0.49, 0.5, 2.99, 3., 7.}) {
+    CHECK(h.findBin(x) == static_cast<size_t>(binning.FindBin(x)));
+  }
+  GS::FixedHistogram other{TH1D{"other", "other", 8, -1., 4.}};
+  CHECK_FALSE(h.sameBinning(other));
+  CHECK(h.sameBinning(GS::FixedHistogram{binning}));
+
+  std::vector<double> values{-2., 0.2, 0.3, 1.7, 5.};
+  h.setValues(values);
+  TH1D filled{binning};
+  auto fill{[&] {
+    h.fill();
+    for (double v : values) {
+      filled.Fill(v);
+    }
+  }};
+  fill();
+  fill();
+  h.moveValue(0.3, 2.6);
+  values[2] = 2.6;
+  fill();
+  h.moveValue(-2., 1.8);
+  values[0] = 1.8;
+  fill();
+  TH1D written{binning};
+  h.writeTo(written);
+  CHECK(written.GetEntries() == filled.GetEntries());
+  for (int b{0}; b <= 9; ++b) {
+    CHECK(written.GetBinContent(b) == filled.GetBinContent(b));
+  }
+  CHECK(written.GetMean() == doctest::Approx(filled.GetMean()));
+
+  h.clearFills();
+  TH1D empty{binning};
+  h.writeTo(empty);
+  CHECK(empty.GetEntries() == 0.);
+  h.fill();
+  h.writeTo(empty);
+  CHECK(empty.GetEntries() == 5.);
+  CHECK(empty.GetBinContent(9) == 1.);
+}
+
+TEST_CASE("Testing the EventRing class") {
+  CHECK_THROWS_AS(GS::EventRing{0}, std::invalid_argument);
+  GS::Gas gas{30, 10., 20., 0., 17};
+  std::vector<GS::GasData> data{gas.rawDataSimulate(1000)};
+  GS::EventRing ring{5};
+  CHECK(ring.capacity() == 8);
+  CHECK(ring.size() == 0);
+  SUBCASE("Wrapping around") {
+    std::vector<GS::GasData> in(data.begin(), data.begin() + 10);
+    std::vector<GS::GasData> out{};
+    CHECK(ring.push(in) == 8);
+    CHECK(ring.size() == 8);
+    CHECK(ring.push(in, 8) == 0);
+    CHECK(ring.pop(out, 3) == 3);
+    CHECK(ring.push(in, 8) == 2);
+    CHECK(ring.pop(out, 20) == 7);
+    CHECK(ring.size() == 0);
+    CHECK(ring.pop(out, 1) == 0);
+    REQUIRE(out.size() == 10);
+    for (size_t i{0}; i < 10; ++i) {
+      CHECK(out[i] == data[i]);
+    }
+    // keyframes keep their particles
+    CHECK(out[0].isKeyframe());
+  }
+  SUBCASE("Two threads") {
+    std::vector<GS::GasData> in(data);
+    std::thread producer{[&] {
+      size_t pushed{0};
+      while (pushed < in.size()) {
+        pushed += ring.push(in, pushed);
+        ring.waitForSpace(1, std::chrono::milliseconds(100));
+      }
+    }};
+    std::vector<GS::GasData> out{};
+    while (out.size() < data.size()) {
+      ring.waitForData(3, std::chrono::milliseconds(100));
+      ring.pop(out, 3);
+      // the last record comes alone
+      if (out.size() == 999) {
+        ring.waitForData(1, std::chrono::milliseconds(100));
+        ring.pop(out, 1);
+      }
+    }
+    producer.join();
+    CHECK(out == data);
+  }
+  SUBCASE("Waking a waiting side") {
+    std::atomic<bool> stop{false};
+    auto start{std::chrono::steady_clock::now()};
+    std::thread consumer{[&] {
+      ring.waitForData(1, std::chrono::seconds(10),
+                       [&] { return stop.load(); });
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    stop.store(true);
+    ring.wake();
+    consumer.join();
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+  }
 }
 
 TEST_CASE("Testing part of the SimDataPipeline class") {
@@ -880,6 +1564,13 @@ TEST_CASE("Testing part of the SimDataPipeline class") {
     CHECK_THROWS(output.setFramerate(0.));
     CHECK_THROWS(output.setFramerate(-15.));
     CHECK_THROWS(output.setStatSize(0));
+    // Stat size beyond the raw data ring, ring smaller than the stat size
+    CHECK(output.getRingCapacity() == 4096);
+    CHECK_THROWS_AS(output.setStatSize(5000), std::invalid_argument);
+    CHECK_NOTHROW(output.setRingCapacity(5000));
+    CHECK(output.getRingCapacity() == 8192);
+    CHECK_NOTHROW(output.setStatSize(5000));
+    CHECK_THROWS_AS(output.setRingCapacity(100), std::invalid_argument);
     // Empty font
     sf::Font f{};
     CHECK_THROWS(output.setFont(f));
@@ -932,5 +1623,451 @@ TEST_CASE("Testing part of the SimDataPipeline class") {
       CHECK_NOTHROW(moreOutputCopy.addData(std::move(moreData)));
       CHECK_THROWS(moreOutputCopy.addData(std::move(data)));
     }
+    SUBCASE("Missing keyframe") {
+      CHECK_THROWS_AS(output.addData({data.begin() + 1, data.end()}),
+                      std::invalid_argument);
+      CHECK_NOTHROW(output.addData(std::vector<GS::GasData>{data[0]}));
+      CHECK_NOTHROW(output.addData({data.begin() + 1, data.end()}));
+    }
+  }
+  SUBCASE("Frame snapshots") {
+    GS::Gas gas{30, 10., 20., 0., 7};
+    GS::Gas sameGas{gas};
+    GS::SimDataPipeline output{10, 2., defaultH};
+    GS::SimDataPipeline frameOutput{10, 2., defaultH};
+    CHECK_FALSE(frameOutput.getFrameSnapshots());
+    frameOutput.setFrameSnapshots(true);
+    CHECK(frameOutput.getFrameSnapshots());
+    gas.simulate(200, output);
+    sameGas.simulate(200, frameOutput);
+    output.processData(true);
+    frameOutput.processData(true);
+    // only where the full snapshots are taken changes, along with the
+    // rounding of the particles brought to their time
+    std::vector<GS::TdStats> stats{output.getStats()};
+    std::vector<GS::TdStats> frameStats{frameOutput.getStats()};
+    REQUIRE(stats.size() == 20);
+    REQUIRE(frameStats.size() == 20);
+    for (size_t i{0}; i < 20; ++i) {
+      CHECK(frameStats[i].getTime() ==
+            doctest::Approx(stats[i].getTime()).epsilon(1E-6));
+      CHECK(frameStats[i].getPressure() ==
+            doctest::Approx(stats[i].getPressure()).epsilon(1E-6));
+      CHECK(frameStats[i].getTemp() ==
+            doctest::Approx(stats[i].getTemp()).epsilon(1E-6));
+      CHECK(frameStats[i].getMeanFreePath() ==
+            doctest::Approx(stats[i].getMeanFreePath()).epsilon(1E-6));
+    }
+  }
+  SUBCASE("Many frames per event") {
+    // a sparse gas, with frames much closer than its events
+    GS::Gas gas{3, 10., 50., 0., 5};
+    GS::Gas sameGas{gas};
+    double const meanEventTime{sameGas.rawDataSimulate(60).back().getTime() /
+                               60.};
+    sf::Texture particleT;
+    particleT.loadFromFile("assets/lightBall.png");
+    GS::RenderStyle style{particleT};
+    GS::Camera camera{{-30., 25., 25.}, {1., 0., 0.}, 1., 90., 40, 30};
+    for (GS::RenderBackend backend :
+         {GS::RenderBackend::sfml, GS::RenderBackend::cpu}) {
+      GS::Gas framedGas{gas};
+      GS::SimDataPipeline output{10, 20. / meanEventTime, defaultH};
+      output.setRenderBackend(backend);
+      CHECK(output.getRenderBackend() == backend);
+      framedGas.simulate(60, output);
+      output.processData(camera, style);
+      // frames every 1 / framerate from the first event
+      double const frameTime{1. / output.getFramerate()};
+      double t{-frameTime};
+      size_t nFrames{0};
+      while (t + frameTime <= framedGas.getTime()) {
+        t += frameTime;
+        ++nFrames;
+      }
+      CHECK(nFrames > 600);
+      CHECK(output.getNRenders() == nFrames);
+      REQUIRE(output.getGTime().has_value());
+      CHECK(*output.getGTime() == t);
+      // the cpu frames reach the queue as pixels, uploaded when shown
+      std::vector<GS::Render> renders{output.getRenders(true)};
+      REQUIRE(renders.size() == nFrames);
+      CHECK(output.getNRenders() == 0);
+      if (backend == GS::RenderBackend::cpu) {
+        for (GS::Render const& render : renders) {
+          CHECK_FALSE(render.isUploaded());
+          CHECK(render.getSize() == sf::Vector2u{40, 30});
+          CHECK(render.getImage().getPixelsPtr() != nullptr);
+        }
+        CHECK_NOTHROW(renders.front().getTexture());
+        CHECK(renders.front().isUploaded());
+        CHECK(renders.front().getImage().getSize() == sf::Vector2u{0, 0});
+      } else {
+        CHECK(renders.front().isUploaded());
+      }
+    }
+  }
+  SUBCASE("Parallel frames") {
+    // many more frames than threads, every render worker drawing them in
+    // parallel, compared to the frames drawn one at a time
+    GS::Gas gas{30, 10., 20., 0., 13};
+    std::vector<GS::GasData> data{gas.rawDataSimulate(200)};
+    sf::Texture particleT;
+    particleT.loadFromFile("assets/lightBall.png");
+    GS::RenderStyle style{particleT};
+    GS::Camera camera{{-30., 10., 10.}, {1., 0., 0.}, 1., 90., 40, 30};
+    auto draw{[&](size_t renderWorkers) {
+      GS::SimDataPipeline output{10, 300. / gas.getTime(), defaultH};
+      output.setRenderBackend(GS::RenderBackend::cpu);
+      output.setWorkers(1, renderWorkers);
+      output.addData(std::vector<GS::GasData>{data});
+      output.setDone();
+      output.processData(camera, style);
+      return output.getRenders(true);
+    }};
+    std::vector<GS::Render> renders{draw(4)};
+    std::vector<GS::Render> serialRenders{};
+    {
+      tbb::global_control serial{
+          tbb::global_control::max_allowed_parallelism, 1};
+      serialRenders = draw(1);
+    }
+    REQUIRE(renders.size() >
+            8 * static_cast<size_t>(tbb::this_task_arena::max_concurrency()));
+    REQUIRE(renders.size() == serialRenders.size());
+    for (size_t i{0}; i < renders.size(); ++i) {
+      REQUIRE(renders[i].getSize() == sf::Vector2u{40, 30});
+      REQUIRE(serialRenders[i].getSize() == sf::Vector2u{40, 30});
+      sf::Uint8 const* pixels{renders[i].getImage().getPixelsPtr()};
+      CHECK(std::equal(pixels, pixels + 40 * 30 * 4,
+                       serialRenders[i].getImage().getPixelsPtr()));
+    }
+  }
+  SUBCASE("Parallel stats") {
+    GS::Gas gas{30, 10., 20., 0., 11};
+    std::vector<GS::GasData> data{gas.rawDataSimulate(200)};
+    TH1D speedsT{"speedsT", "speedsT", 10, 0., 2.5};
+    for (bool mfpMemory : {true, false}) {
+      GS::SimDataPipeline output{10, 2., speedsT};
+      output.setStatChunkSize(6);  // stats chained across batches too
+      output.addData(std::vector<GS::GasData>{data});
+      output.setDone();
+      output.processData(mfpMemory);
+      std::vector<GS::TdStats> stats{output.getStats()};
+      REQUIRE(stats.size() == 20);
+      // same stats chained one after the other
+      GS::GasState state{data[0]};
+      std::vector<GS::TdStats> sequential{};
+      std::vector<std::vector<GS::GSVectorD>> endPositions{};
+      for (size_t i{0}; i < data.size(); ++i) {
+        state.apply(data[i]);
+        if (i % 10) {
+          sequential.back().addData(state);
+        } else if (i && mfpMemory) {
+          sequential.emplace_back(state, GS::TdStats(sequential.back()));
+        } else {
+          sequential.emplace_back(state, speedsT);
+        }
+        if (i % 10 == 9) {
+          endPositions.push_back(
+              sequential.back().getMemory().lastCollPositions);
+        }
+      }
+      for (size_t i{0}; i < 20; ++i) {
+        CHECK(stats[i] == sequential[i]);
+        CHECK(stats[i].getNParticles() == 30);
+        // published stats don't share the tracker the chain goes on with
+        CHECK(stats[i].getMemory().lastCollPositions == endPositions[i]);
+        TH1D h{stats[i].getSpeedH()};
+        TH1D sequentialH{sequential[i].getSpeedH()};
+        CHECK(h.GetEntries() == sequentialH.GetEntries());
+        CHECK(h.GetMean() == sequentialH.GetMean());
+        CHECK(h.GetRMS() == sequentialH.GetRMS());
+        for (int b{0}; b <= 11; ++b) {
+          CHECK(h.GetBinContent(b) == sequentialH.GetBinContent(b));
+        }
+      }
+    }
+  }
+  SUBCASE("Parallel workers") {
+    GS::Gas gas{30, 10., 20., 0., 11};
+    std::vector<GS::GasData> data{gas.rawDataSimulate(400)};
+    GS::SimDataPipeline output{10, 2., defaultH};
+    CHECK(output.getStatsWorkers() == 1);
+    CHECK(output.getRenderWorkers() == 1);
+    CHECK_THROWS_AS(output.setWorkers(0, 1), std::invalid_argument);
+    CHECK_THROWS_AS(output.setWorkers(1, 0), std::invalid_argument);
+    for (bool mfpMemory : {true, false}) {
+      GS::SimDataPipeline oneWorker{10, 2., defaultH};
+      GS::SimDataPipeline workers{10, 2., defaultH};
+      workers.setWorkers(4, 1);
+      CHECK(workers.getStatsWorkers() == 4);
+      for (GS::SimDataPipeline* o : {&oneWorker, &workers}) {
+        o->setStatChunkSize(1);  // a batch for each stat
+        o->addData(std::vector<GS::GasData>{data});
+        o->setDone();
+        o->processData(mfpMemory);
+      }
+      std::vector<GS::TdStats> stats{workers.getStats()};
+      std::vector<GS::TdStats> oneWorkerStats{oneWorker.getStats()};
+      REQUIRE(stats.size() == 40);
+      REQUIRE(oneWorkerStats.size() == 40);
+      // published in order, whichever worker completes first
+      for (size_t i{0}; i < 40; ++i) {
+        CHECK(stats[i] == oneWorkerStats[i]);
+      }
+      CHECK(stats.back().getTime() == doctest::Approx(gas.getTime()));
+      CHECK(stats.back().getMemory().lastCollPositions ==
+            oneWorkerStats.back().getMemory().lastCollPositions);
+    }
+  }
+  SUBCASE("Waiting for results") {
+    GS::Gas gas{30, 10., 20., 0., 12};
+    GS::SimDataPipeline output{10, 2., defaultH};
+    CHECK_FALSE(output.waitForResults(std::chrono::milliseconds(1)));
+    std::thread consumer{[&] { output.processData(false); }};
+    output.addData(gas.rawDataSimulate(10));
+    CHECK(output.waitForResults(std::chrono::seconds(10)));
+    CHECK(output.getNStats() == 1);
+    output.setDone();
+    consumer.join();
+    // nothing new, but processing is over, so no waiting
+    CHECK_FALSE(output.waitForResults(std::chrono::seconds(10)));
+  }
+  SUBCASE("Queue limits") {
+    GS::Gas gas{30, 10., 20., 0., 13};
+    GS::SimDataPipeline output{10, 2., defaultH};
+    CHECK_THROWS_AS(output.setQueueLimits(GS::PipelineQueue::stats, {3, 5}),
+                    std::invalid_argument);
+    CHECK_THROWS_AS(
+        output.setQueueLimits(GS::PipelineQueue::rawData,
+                              {30, 10, false, GS::QueuePolicy::dropOldest}),
+        std::invalid_argument);
+    SUBCASE("Drop oldest") {
+      output.setQueueLimits(GS::PipelineQueue::stats,
+                            {5, 3, false, GS::QueuePolicy::dropOldest});
+      output.setStatChunkSize(4);
+      gas.simulate(200, output);
+      output.processData(true);
+      GS::QueueStatus status{
+          output.getQueueStatus(GS::PipelineQueue::stats)};
+      CHECK(status.items <= 5);
+      CHECK(status.items + status.dropped == 20);
+      CHECK(status.bytes == status.items * output.getStats()[0].memoryUsage());
+      // the kept stats are the newest ones
+      CHECK(output.getStats().back().getTime() ==
+            doctest::Approx(gas.getTime()));
+    }
+    SUBCASE("Blocking producer") {
+      output.setQueueLimits(GS::PipelineQueue::rawData, {30, 10});
+      std::thread simThread{[&] { gas.simulate(200, output); }};
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      // the simulation waits for the processing to start
+      CHECK(output.getRawDataSize() <= 40);
+      output.processData(true);
+      simThread.join();
+      GS::QueueStatus status{
+          output.getQueueStatus(GS::PipelineQueue::rawData)};
+      CHECK(status.blockedTime >= 0.1);
+      CHECK(status.items == 0);
+      CHECK(status.bytes == 0);
+      CHECK(output.getNStats() == 20);
+    }
+    SUBCASE("Blocking outputs") {
+      output.setQueueLimits(GS::PipelineQueue::stats, {4, 2});
+      output.setStatChunkSize(2);
+      gas.simulate(200, output);
+      std::thread processThread{[&] { output.processData(true); }};
+      std::vector<GS::TdStats> stats{};
+      while (stats.size() < 20) {
+        CHECK(output.getNStats() <= 6);
+        std::vector<GS::TdStats> newStats{output.getStats(true)};
+        stats.insert(stats.end(), newStats.begin(), newStats.end());
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      }
+      processThread.join();
+      CHECK(stats.size() == 20);
+      CHECK(output.getQueueStatus(GS::PipelineQueue::stats).dropped == 0);
+    }
+  }
+  SUBCASE("Memory usage") {
+    GS::Gas gas{30, 10., 20., 0., 13};
+    TH1D speedsT{"speedsT", "speedsT", 10, 0., 2.5};
+    GS::SimDataPipeline output{10, 2., speedsT};
+    output.setStatChunkSize(4);
+    GS::PipelineMemoryUsage estimate{
+        output.estimateMemory(30, 200, 100., {}, false)};
+    // the raw data ring is allocated upfront
+    size_t ringBytes{output.memoryUsage().rawData};
+    CHECK(ringBytes >= 4096 * sizeof(GS::GasData));
+    CHECK(output.memoryUsage().total() == ringBytes);
+    gas.simulate(200, output);
+    // a keyframe at the start of each batch
+    CHECK(output.memoryUsage().rawData == estimate.rawData);
+    CHECK(output.memoryUsage().rawData ==
+          ringBytes + 20 * 30 * sizeof(GS::Particle));
+    CHECK(output.getQueueStatus(GS::PipelineQueue::rawData).bytes ==
+          200 * sizeof(GS::GasData) + 20 * 30 * sizeof(GS::Particle));
+    CHECK(output.memoryUsage().states == estimate.states);
+    output.processData(true);
+    CHECK(output.memoryUsage().rawData == ringBytes);
+    CHECK(output.memoryUsage().stats == estimate.stats);
+    CHECK(output.memoryUsage().renders == 0);
+    // bounded by the watermarks, plus a batch
+    output.setQueueLimits(GS::PipelineQueue::stats, {5, 2});
+    CHECK(output.estimateMemory(30, 200, 100., {}, false).stats ==
+          9 * output.getStats()[0].memoryUsage());
+    output.setQueueLimits(GS::PipelineQueue::rawData, {1000, 500, true});
+    CHECK(output.estimateMemory(30, 200, 100., {}, false).rawData <
+          estimate.rawData);
+    CHECK(output.estimateMemory(30, 200, 100., {100, 100}, true).renders >
+          100 * 100 * 4);
+    CHECK_THROWS_AS(output.estimateMemory(30, 200, 0., {}, false),
+                    std::invalid_argument);
+  }
+}
+
+TEST_CASE("Testing checkpoints") {
+  std::string const path{"checkpointTest.gsc"};
+  GS::Gas gas{30, 10., 20., 0., 7};
+  GS::SimDataPipeline output{10, 1., defaultH};
+  CHECK_THROWS(output.setCheckpoints("", 1.));
+  CHECK_THROWS(output.setCheckpoints(path, -1.));
+  output.setCheckpoints(path, 0.);
+  gas.simulate(100, output);
+  // the last processed stat is always checkpointed before returning
+  output.processData(true);
+  REQUIRE(output.getNStats() == 10);
+
+  GS::Checkpoint c{GS::readCheckpoint(path)};
+  CHECK(c.events == 100);
+  CHECK(c.time == gas.getTime());
+  CHECK(c.boxSide == gas.getBoxSide());
+  CHECK(c.radius == GS::Particle::getRadius());
+  CHECK(c.mass == GS::Particle::getMass());
+  CHECK(c.particles == gas.getParticles());
+  REQUIRE(c.lastStat.has_value());
+  CHECK(c.lastStat->time == c.time);
+  CHECK(c.lastStat->lastCollPositions ==
+        output.getStats().back().getMemory().lastCollPositions);
+  CHECK_FALSE(c.gTime.has_value());
+
+  GS::Gas resumed{c};
+  CHECK(resumed.getParticles() == gas.getParticles());
+  CHECK(resumed.getTime() == gas.getTime());
+  GS::Checkpoint otherMass{c};
+  otherMass.mass *= 2.;
+  CHECK_THROWS(GS::Gas{otherMass});
+  // rounding errors past the walls are accepted, particles out of the box or
+  // overlapping aren't
+  GS::Checkpoint rounded{c};
+  rounded.particles[0].position.x = GS::Particle::getRadius() - 1E-12;
+  CHECK_NOTHROW(GS::Gas{rounded});
+  GS::Checkpoint outside{c};
+  outside.particles[0].position.x = -1.;
+  CHECK_THROWS(GS::Gas{outside});
+  GS::Checkpoint overlapping{c};
+  overlapping.particles[1].position = overlapping.particles[0].position;
+  CHECK_THROWS(GS::Gas{overlapping});
+
+  // the resumed pipeline accepts the data following the checkpoint and keeps
+  // the free paths memory
+  GS::SimDataPipeline resumedOutput{10, 1., defaultH};
+  resumedOutput.resume(c);
+  CHECK_THROWS(resumedOutput.resume(c));
+  CHECK_FALSE(resumedOutput.getGTime().has_value());
+  // the frame snapshots of a resumed run follow the frames it left off at
+  GS::Checkpoint rendered{c};
+  rendered.gTime = c.time - 0.3;
+  rendered.fTime = *rendered.gTime - 2.;
+  GS::SimDataPipeline renderedOutput{10, 1., defaultH};
+  renderedOutput.resume(rendered);
+  CHECK(renderedOutput.getGTime() == rendered.gTime);
+  // the frames shown are the ones of the checkpoint until a video is taken
+  std::string const renderedPath{"renderedCheckpointTest.gsc"};
+  renderedOutput.setCheckpoints(renderedPath, 0.);
+  GS::Gas{c}.simulate(20, renderedOutput);
+  renderedOutput.processData(true);
+  GS::Checkpoint renderedNext{GS::readCheckpoint(renderedPath)};
+  CHECK(renderedNext.gTime == rendered.gTime);
+  CHECK(renderedNext.fTime == rendered.fTime);
+  std::filesystem::remove(renderedPath);
+  // with frame snapshots the first resumed event is off the frame grid, yet
+  // it must start the pipeline state
+  GS::SimDataPipeline snapshotOutput{10, 1., defaultH};
+  snapshotOutput.setFrameSnapshots(true);
+  snapshotOutput.resume(rendered);
+  GS::Gas snapshotGas{c};
+  REQUIRE_NOTHROW(snapshotGas.simulate(20, snapshotOutput));
+  CHECK_NOTHROW(snapshotOutput.processData(true));
+  CHECK(snapshotOutput.getNStats() == 2);
+  resumedOutput.setCheckpoints(path, 0.);
+  CHECK_NOTHROW(resumed.simulate(50, resumedOutput));
+  resumedOutput.processData(true);
+  std::vector<GS::TdStats> stats{resumedOutput.getStats()};
+  REQUIRE(stats.size() == 5);
+  CHECK(stats[0].getTime0() == doctest::Approx(c.time));
+  CHECK(stats[0].getMeanFreePath() > 0.);
+  CHECK(GS::readCheckpoint(path).events == 150);
+
+  // the resumed gas follows the original trajectory
+  gas.simulate(70);
+  resumed.simulate(20);
+  for (size_t i{0}; i < 30; ++i) {
+    CHECK((resumed.getParticles()[i].position - gas.getParticles()[i].position)
+              .norm() == doctest::Approx(0.).epsilon(1E-9));
+  }
+
+  {
+    std::ofstream bad{path, std::ios::binary | std::ios::trunc};
+    bad << "not a checkpoint, but long enough to hold a header: "
+        << std::string(200, 'x');
+  }
+  CHECK_THROWS(GS::readCheckpoint(path));
+  std::filesystem::resize_file(path, 10);
+  CHECK_THROWS(GS::readCheckpoint(path));
+  std::filesystem::remove(path);
+  CHECK_THROWS(GS::readCheckpoint(path));
+}
+
+TEST_CASE("Testing the GasEnsemble class") {
+  GS::GasEnsemble ensemble{4, 20, 10., 15., 42};
+  GS::GasEnsemble sameSeed{4, 20, 10., 15., 42};
+  CHECK(ensemble.getNReplicas() == 4);
+  CHECK(ensemble.getReplica(0).getParticles() ==
+        sameSeed.getReplica(0).getParticles());
+  CHECK(!(ensemble.getReplica(0).getParticles() ==
+          ensemble.getReplica(1).getParticles()));
+  CHECK_THROWS(GS::GasEnsemble{0, 20, 10., 15., 42});
+
+  std::atomic<size_t> nCalls{0};
+  std::vector<GS::EnsembleStats> stats{
+      ensemble.run(3, 50, defaultH, true, [&](size_t r, GS::TdStats const&) {
+        CHECK(r < 4);
+        ++nCalls;
+      })};
+  REQUIRE(stats.size() == 3);
+  CHECK(nCalls.load() == 12);
+  for (GS::EnsembleStats const& s : stats) {
+    CHECK(s.pressure.n == 4);
+    CHECK(s.pressure.mean > 0.);
+    CHECK(s.pressure.variance > 0.);
+    // every replica is built at exactly the target temperature
+    CHECK(s.temperature.mean == doctest::Approx(10.));
+    CHECK(s.temperature.variance == doctest::Approx(0.).epsilon(1E-9));
   }
+  CHECK(stats[2].time.mean > stats[0].time.mean);
+  CHECK(stats[2].meanFreePath.n == 4);
+
+  // results don't depend on how the replicas got scheduled
+  std::vector<GS::EnsembleStats> sameStats{sameSeed.run(3, 50, defaultH)};
+  CHECK(sameStats[2].pressure.mean == stats[2].pressure.mean);
+  CHECK(sameStats[2].meanFreePath.variance == stats[2].meanFreePath.variance);
+
+  // radius changes are already refused while gases are alive, mass ones not
+  CHECK_THROWS(GS::Particle::setRadius(GS::Particle::getRadius() / 2.));
+  double mass{GS::Particle::getMass()};
+  GS::Particle::setMass(mass * 2.);
+  CHECK_THROWS_AS(ensemble.run(1, 50, defaultH), std::runtime_error);
+  GS::Particle::setMass(mass);
 }